@@ -27,6 +27,9 @@ if(USE_FMT)
 
     FetchContent_MakeAvailable(fmt)
 
+    # Linked into the loadable SQLite extension too.
+    set_target_properties(fmt PROPERTIES POSITION_INDEPENDENT_CODE ON)
+
     add_compile_definitions(USING_FMT)
 endif()
 
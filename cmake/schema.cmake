@@ -0,0 +1,25 @@
+# SPDX-License-Identifier: MIT
+# Copyright (c) 2022 Gustavo Ribeiro Croscato
+
+# Writes the SQL schema in `input` to `output` through `template`, with its
+# CREATE INDEX statements apart from the rest (@SCHEMA_INDEXES@ and
+# @SCHEMA_TABLES@) so they can run after a bulk load. Editing `input`
+# configures the project again.
+function(generate_schema input template output)
+    file(READ ${input} SCHEMA_TABLES)
+
+    set(SCHEMA_INDEXES "")
+
+    string(REGEX MATCH "CREATE INDEX[^;]*;" statement "${SCHEMA_TABLES}")
+
+    while(NOT statement STREQUAL "")
+        string(REPLACE "${statement}" "" SCHEMA_TABLES "${SCHEMA_TABLES}")
+        string(APPEND SCHEMA_INDEXES "${statement}\n")
+
+        string(REGEX MATCH "CREATE INDEX[^;]*;" statement "${SCHEMA_TABLES}")
+    endwhile()
+
+    configure_file(${template} ${output} @ONLY)
+
+    set_property(DIRECTORY APPEND PROPERTY CMAKE_CONFIGURE_DEPENDS ${input})
+endfunction()
@@ -46,3 +46,15 @@ CREATE TABLE IF NOT EXISTS tbl_keyword_list (
     , CONSTRAINT fk_keyword_list_keyword FOREIGN KEY (context_id) REFERENCES tbl_keyword (context_id)
     , CONSTRAINT fk_keyword_list_context FOREIGN KEY (keyword_context) REFERENCES tbl_context (context_id)
 );
+
+-- Full-text search over the plain text of every topic (rowid = context_id).
+-- text_terms holds the parts of C/Pascal identifiers (GetMaxX -> get max x,
+-- str_len -> str len) so both the whole identifier and its parts match.
+CREATE VIRTUAL TABLE IF NOT EXISTS tbl_text_search USING fts5 (
+      index_keys
+    , text_plain
+    , text_terms
+    , tokenize = "unicode61 tokenchars '_'"
+);
+
+INSERT INTO tbl_text_search (tbl_text_search, rank) VALUES ('rank', 'bm25(10.0, 1.0, 0.5)');
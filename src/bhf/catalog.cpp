@@ -0,0 +1,220 @@
+// SPDX-License-Identifier: MIT
+// Copyright (c) 2022 Gustavo Ribeiro Croscato
+
+#include <algorithm>
+#include <queue>
+
+#include "catalog.hpp"
+
+namespace BHF {
+
+struct CatalogData {
+    std::vector<std::unique_ptr<File>> files;
+    std::vector<std::string> filepaths;
+    std::vector<u8> upper_case_keys;
+    bool has_upper_case_keys = false;
+
+    Catalog::EntryContainer index;
+
+    std::string last_error;
+};
+
+// Entries of one file, in key order.
+struct CatalogRun {
+    std::vector<Catalog::Entry> sorted;
+    const Catalog::Entry *position = nullptr;
+    const Catalog::Entry *end = nullptr;
+};
+
+static std::string
+Catalog_ToUpper(std::string_view text) noexcept
+{
+    std::string result(text);
+
+    for (char &c : result) {
+        if (c >= 'a' && c <= 'z') {
+            c = static_cast<char>(c - 'a' + 'A');
+        }
+    }
+
+    return result;
+}
+
+Catalog::Catalog() noexcept
+    : d{std::make_unique<CatalogData>()}
+{}
+
+Catalog::~Catalog() noexcept = default;
+
+bool
+Catalog::open(const std::vector<std::string_view> &filepaths) noexcept
+{
+    d = std::make_unique<CatalogData>();
+
+    std::vector<CatalogRun> runs(filepaths.size());
+
+    usize total = 0;
+
+    for (usize i = 0; i < filepaths.size(); ++i) {
+        auto file = std::make_unique<File>();
+
+        if (!file->open(filepaths[i])) {
+            d->last_error = fmt::format("{}: {}", filepaths[i], file->lastError());
+
+            return false;
+        }
+
+        bool upper = (file->fileHeader().options & OF_CaseSense) == 0;
+
+        std::vector<Entry> &sorted = runs[i].sorted;
+
+        sorted.reserve(file->index().size());
+
+        for (const File::IndexType &index : file->index()) {
+            sorted.push_back({index.index, static_cast<u32>(i), index.context});
+        }
+
+        // Help compilers write the index sorted, the sort is only a fallback.
+        auto key_less = [](const Entry &a, const Entry &b) { return a.key < b.key; };
+
+        if (!std::is_sorted(sorted.begin(), sorted.end(), key_less)) {
+            std::stable_sort(sorted.begin(), sorted.end(), key_less);
+        }
+
+        runs[i].position = sorted.data();
+        runs[i].end = sorted.data() + sorted.size();
+
+        total += sorted.size();
+
+        d->files.push_back(std::move(file));
+        d->filepaths.emplace_back(filepaths[i]);
+        d->upper_case_keys.push_back(upper ? 1 : 0);
+        d->has_upper_case_keys = d->has_upper_case_keys || upper;
+    }
+
+    // k-way merge, ties go to the file opened first.
+    auto greater = [&runs](usize a, usize b) {
+        const Entry &left = *runs[a].position;
+        const Entry &right = *runs[b].position;
+
+        return left.key != right.key ? left.key > right.key : a > b;
+    };
+
+    std::priority_queue<usize, std::vector<usize>, decltype(greater)> heads(greater);
+
+    for (usize i = 0; i < runs.size(); ++i) {
+        if (runs[i].position != runs[i].end) {
+            heads.push(i);
+        }
+    }
+
+    d->index.reserve(total);
+
+    while (!heads.empty()) {
+        usize run = heads.top();
+        heads.pop();
+
+        d->index.push_back(*runs[run].position++);
+
+        if (runs[run].position != runs[run].end) {
+            heads.push(run);
+        }
+    }
+
+    return true;
+}
+
+usize
+Catalog::fileCount() const noexcept
+{
+    return d->files.size();
+}
+
+const File &
+Catalog::file(usize file) const noexcept
+{
+    return *d->files[file];
+}
+
+const std::string &
+Catalog::filepath(usize file) const noexcept
+{
+    return d->filepaths[file];
+}
+
+const Catalog::EntryContainer &
+Catalog::index() const noexcept
+{
+    return d->index;
+}
+
+Catalog::EntryContainer
+Catalog::find(std::string_view key) const noexcept
+{
+    EntryContainer result;
+
+    auto search = [&](std::string_view value, u8 upper) -> void {
+        auto [first, last] = std::equal_range(d->index.begin(), d->index.end(), Entry{value, 0, 0}, [](const Entry &a, const Entry &b) {
+            return a.key < b.key;
+        });
+
+        for (auto it = first; it != last; ++it) {
+            if (d->upper_case_keys[it->file] == upper) {
+                result.push_back(*it);
+            }
+        }
+    };
+
+    search(key, 0);
+
+    if (d->has_upper_case_keys) {
+        search(Catalog_ToUpper(key), 1);
+    }
+
+    std::stable_sort(result.begin(), result.end(), [](const Entry &a, const Entry &b) { return a.file < b.file; });
+
+    return result;
+}
+
+Catalog::EntryContainer
+Catalog::findPrefix(std::string_view prefix) const noexcept
+{
+    EntryContainer result;
+
+    auto search = [&](std::string_view value, u8 upper) -> void {
+        auto first = std::partition_point(d->index.begin(), d->index.end(), [&value](const Entry &entry) {
+            return entry.key < value;
+        });
+
+        for (auto it = first; it != d->index.end() && it->key.substr(0, value.size()) == value; ++it) {
+            if (d->upper_case_keys[it->file] == upper) {
+                result.push_back(*it);
+            }
+        }
+    };
+
+    search(prefix, 0);
+
+    if (d->has_upper_case_keys) {
+        std::string upper = Catalog_ToUpper(prefix);
+
+        search(upper, 1);
+
+        // Both searches are in key order, keep the result that way.
+        std::inplace_merge(result.begin(), std::find_if(result.begin(), result.end(), [this](const Entry &entry) {
+            return d->upper_case_keys[entry.file] != 0;
+        }), result.end(), [](const Entry &a, const Entry &b) {
+            return a.key != b.key ? a.key < b.key : a.file < b.file;
+        });
+    }
+
+    return result;
+}
+
+const std::string &
+Catalog::lastError() const noexcept
+{
+    return d->last_error;
+}
+
+} // namespace BHF
@@ -0,0 +1,53 @@
+// SPDX-License-Identifier: MIT
+// Copyright (c) 2022 Gustavo Ribeiro Croscato
+
+#ifndef BHFCONVERTER_SRC_BHF_CATALOG_HPP
+#define BHFCONVERTER_SRC_BHF_CATALOG_HPP 1
+
+#include "file.hpp"
+
+namespace BHF {
+
+struct CatalogData;
+
+// Several help files searched as one, through a single sorted index. The
+// keys are views into the index of each file, nothing is copied.
+class Catalog
+{
+public:
+    struct Entry {
+        std::string_view key;
+        u32 file;
+        File::ContextType context;
+    };
+
+    using EntryContainer = std::vector<Entry>;
+
+    Catalog() noexcept;
+    ~Catalog() noexcept;
+
+    // Opens every file and merges their indexes. Fails on the first file
+    // that can't be opened, lastError() names it.
+    bool open(const std::vector<std::string_view> &filepaths) noexcept;
+
+    usize fileCount() const noexcept;
+    const File &file(usize file) const noexcept;
+    const std::string &filepath(usize file) const noexcept;
+
+    // Every key of every file, in key order and then file order.
+    const EntryContainer &index() const noexcept;
+
+    // Keys equal to / starting with `key`. Files whose keys are not case
+    // sensitive are searched with `key` in upper case.
+    EntryContainer find(std::string_view key) const noexcept;
+    EntryContainer findPrefix(std::string_view prefix) const noexcept;
+
+    const std::string &lastError() const noexcept;
+
+private:
+    std::unique_ptr<CatalogData> d;
+};
+
+} // namespace BHF
+
+#endif // BHFCONVERTER_SRC_BHF_CATALOG_HPP
@@ -0,0 +1,493 @@
+// SPDX-License-Identifier: MIT
+// Copyright (c) 2022 Gustavo Ribeiro Croscato
+
+#ifndef BHFCONVERTER_SRC_BHF_DECODER_HPP
+#define BHFCONVERTER_SRC_BHF_DECODER_HPP 1
+
+#include <algorithm>
+#include <cstring>
+
+#include "types.hpp"
+
+namespace BHF {
+
+struct ControlCode {
+    enum : u8 {
+        NewLine = 0x00,
+        DocumentEnd = 0x01,
+        KeywordMark = 0x02,
+        SourceCode = 0x05,
+        CharRaw = 0x0f,
+        CharCount = 0x0e,
+    };
+
+    static bool isValid(u8 code)
+    {
+        return code == NewLine
+            || code == DocumentEnd
+            || code == KeywordMark
+            || code == SourceCode
+            || code == CharRaw
+            || code == CharCount;
+    }
+};
+
+inline constexpr u8 kAsciiSpace = 0x20;
+
+// Bounds checked cursor over a help file held in memory.
+struct ByteStream {
+    ByteStream(const u8 *_data, usize _size) noexcept
+        : data{_data}
+        , size{_size}
+    {}
+
+    template<typename T>
+    T read() noexcept
+    {
+        T result{};
+
+        if (size - position < sizeof(T)) {
+            position = size;
+            short_read = true;
+
+            return result;
+        }
+
+        std::memcpy(&result, data + position, sizeof(T));
+        position += sizeof(T);
+
+        return result;
+    }
+
+    // Reads a null terminated string, the terminator is consumed but not returned.
+    std::string_view readString() noexcept
+    {
+        const u8 *start = data + position;
+        const void *terminator = std::memchr(start, 0, size - position);
+
+        if (!terminator) {
+            position = size;
+            short_read = true;
+
+            return {};
+        }
+
+        usize length = static_cast<usize>(static_cast<const u8 *>(terminator) - start);
+
+        position += length + 1;
+
+        return {reinterpret_cast<const char *>(start), length};
+    }
+
+    const u8 *skip(usize count) noexcept
+    {
+        if (size - position < count) {
+            position = size;
+            short_read = true;
+
+            return nullptr;
+        }
+
+        const u8 *result = data + position;
+        position += count;
+
+        return result;
+    }
+
+    bool seek(usize offset) noexcept
+    {
+        if (offset > size) {
+            return false;
+        }
+
+        position = offset;
+
+        return true;
+    }
+
+    bool isEmpty() const noexcept
+    {
+        return position >= size;
+    }
+
+    const u8 *data = nullptr;
+    usize size = 0;
+    usize position = 0;
+    bool short_read = false;
+};
+
+struct NibbleStream {
+    NibbleStream(const u8 *_data, usize _size) noexcept
+        : data{_data}
+        , end{_data + _size}
+        , length{static_cast<isize>(_size * 2)}
+    {}
+
+    u8 next() noexcept
+    {
+        --length;
+
+        if (++index & 0x01) {
+            nibble = data < end ? *data++ : 0;
+
+            return nibble & 0x0f;
+        }
+
+        return (nibble >> 4u) & 0x0f;
+    }
+
+    bool isEmpty() const noexcept
+    {
+        return length <= 0;
+    }
+
+    const u8 *data = nullptr;
+    const u8 *end = nullptr;
+    isize length = 0;
+    u8 nibble = 0;
+    u8 index = 0;
+};
+
+// Layout differences between help file generations. Every format gets its
+// own traits so the parser never has to look at the version again.
+struct FormatTraitsCommon {
+    using FileHeaderRecord = FileHeader;
+
+    static constexpr bool kHasIndexTags = false;
+
+    static FileHeader fileHeader(const FileHeaderRecord &record) noexcept
+    {
+        return record;
+    }
+
+    static FileHeaderRecord fileHeaderRecord(const FileHeader &header) noexcept
+    {
+        return header;
+    }
+};
+
+template<Version::Format F>
+struct FormatTraits;
+
+template<>
+struct FormatTraits<Version::TP2> : FormatTraitsCommon {
+    using FileHeaderRecord = FileHeaderTP2;
+
+    static FileHeader fileHeader(const FileHeaderRecord &record) noexcept
+    {
+        return {record.options, 0, 0, record.height, record.width, record.left_margin};
+    }
+
+    static FileHeaderRecord fileHeaderRecord(const FileHeader &header) noexcept
+    {
+        return {header.options, header.height, header.width, header.left_margin};
+    }
+};
+
+template<>
+struct FormatTraits<Version::TP4> : FormatTraitsCommon {};
+
+template<>
+struct FormatTraits<Version::TP6> : FormatTraitsCommon {};
+
+template<>
+struct FormatTraits<Version::BP7> : FormatTraitsCommon {
+    static constexpr bool kHasIndexTags = true;
+};
+
+template<Compression::Type C>
+struct Codec;
+
+template<>
+struct Codec<Compression::Nibble> {
+    // CharCount repeats the next character 2 to 17 times.
+    static constexpr usize kMaximumRun = 17;
+
+    // Nibbles taken by `count` copies of a character, `width` is 1 for a
+    // table entry and 3 for a CharRaw.
+    static constexpr usize runCost(usize count, usize width) noexcept
+    {
+        return count > 1 && 2 + width < count * width ? 2 + width : count * width;
+    }
+
+    // Expands a Text record and reflows the lines wider than the help window.
+    // A CharCount run is reflowed one character at a time, like the same
+    // characters stored one by one.
+    static void uncompress(const u8 *data, usize size, const FileHeader &file_header, const Compression &compression, std::string &result) noexcept
+    {
+        result.clear();
+        result.reserve(size * 2);
+
+        NibbleStream stream(data, size);
+
+        bool break_on_width = false;
+        bool in_keyword = false;
+
+        const std::string::size_type margin_width = static_cast<std::string::size_type>(file_header.left_margin);
+        const std::string::size_type maximum_width = file_header.width - margin_width;
+        std::string::size_type width = margin_width;
+        std::string::size_type count = 1;
+        std::string::size_type last_space = 0;
+
+        u8 last_value = kAsciiSpace;
+
+        while (!stream.isEmpty()) {
+            u8 nibble = stream.next();
+            u8 character = 0;
+
+            if (nibble == ControlCode::CharRaw) {
+                u8 n1 = stream.next();
+                u8 n2 = stream.next();
+
+                character = static_cast<u8>((n2 << 4) | n1);
+            } else if (nibble == ControlCode::CharCount) {
+                count = static_cast<std::string::size_type>(stream.next() + 2);
+
+                continue;
+            } else {
+                character = compression.table[nibble];
+            }
+
+            for (; count > 0; --count) {
+                u8 value = character;
+
+                if (value == ControlCode::KeywordMark) {
+                    in_keyword = !in_keyword;
+                }
+
+                if (width == margin_width && value != kAsciiSpace && value != ControlCode::NewLine) {
+                    break_on_width = true;
+                }
+
+                if (break_on_width && last_value == ControlCode::NewLine && (value == ControlCode::NewLine || value == kAsciiSpace)) {
+                    break_on_width = false;
+
+                    result += static_cast<char>(ControlCode::NewLine);
+                }
+
+                if (break_on_width && value == ControlCode::NewLine) {
+                    if (width > maximum_width && last_space > 0) {
+                        result[last_space - 1] = static_cast<char>(ControlCode::NewLine);
+                        width = result.size() - last_space;
+                    }
+
+                    last_value = value;
+
+                    value = kAsciiSpace;
+                } else {
+                    last_value = value;
+                }
+
+                if (!ControlCode::isValid(value)) {
+                    width += 1;
+                }
+
+                result += static_cast<char>(value);
+
+                if (value == ControlCode::NewLine) {
+                    width = margin_width;
+                    last_space = 0;
+                    break_on_width = false;
+                } else if (value == kAsciiSpace && width < maximum_width && !in_keyword) {
+                    last_space = result.size();
+                }
+            }
+
+            count = 1;
+        }
+    }
+
+    // Expands a Text record as stored, without the reflow, so compress()
+    // gives back an equivalent record. The padding nibble of an odd record
+    // is the NUL every reader sees at its end.
+    static void expand(const u8 *data, usize size, const Compression &compression, std::string &result) noexcept
+    {
+        result.clear();
+        result.reserve(size * 2);
+
+        NibbleStream stream(data, size);
+
+        std::string::size_type count = 1;
+
+        while (!stream.isEmpty()) {
+            u8 nibble = stream.next();
+            u8 value = 0;
+
+            if (nibble == ControlCode::CharRaw) {
+                u8 n1 = stream.next();
+                u8 n2 = stream.next();
+
+                value = static_cast<u8>((n2 << 4) | n1);
+            } else if (nibble == ControlCode::CharCount) {
+                count = static_cast<std::string::size_type>(stream.next() + 2);
+
+                continue;
+            } else {
+                value = compression.table[nibble];
+            }
+
+            result.append(count, static_cast<char>(value));
+            count = 1;
+        }
+    }
+
+    // Compresses text as returned by expand(). Characters missing from the
+    // table are stored as CharRaw and runs as CharCount when shorter.
+    static void compress(std::string_view text, const Compression &compression, std::vector<u8> &result) noexcept
+    {
+        std::array<u8, 256> slot;
+        slot.fill(ControlCode::CharRaw);
+
+        for (u8 i = sizeof(compression.table); i-- > 0;) {
+            slot[compression.table[i]] = i;
+        }
+
+        result.clear();
+        result.reserve(text.size() / 2 + 1);
+
+        bool high = false;
+
+        auto put = [&result, &high](u8 nibble) -> void {
+            if (high) {
+                result.back() = static_cast<u8>(result.back() | (nibble << 4));
+            } else {
+                result.push_back(nibble);
+            }
+
+            high = !high;
+        };
+
+        auto putCharacter = [&put, &slot](u8 value) -> void {
+            if (slot[value] != ControlCode::CharRaw) {
+                put(slot[value]);
+            } else {
+                put(ControlCode::CharRaw);
+                put(value & 0x0f);
+                put(static_cast<u8>(value >> 4));
+            }
+        };
+
+        // Runs of the text cut in the pieces a CharCount can hold.
+        auto forEachChunk = [&text, &slot](auto &&work) -> void {
+            for (usize i = 0; i < text.size();) {
+                u8 value = static_cast<u8>(text[i]);
+                usize run = 1;
+
+                while (i + run < text.size() && text[i + run] == text[i]) {
+                    ++run;
+                }
+
+                i += run;
+
+                usize width = slot[value] != ControlCode::CharRaw ? 1 : 3;
+
+                for (usize chunk = 0; run > 0; run -= chunk) {
+                    chunk = std::min(run, kMaximumRun);
+
+                    work(value, chunk, width);
+                }
+            }
+        };
+
+        // An odd count of nibbles is padded with a nibble that reads as one
+        // more NUL. Storing a chunk of a run the other way costs a nibble
+        // too and keeps the text as it is, the cheapest one is taken.
+        usize nibbles = 0;
+        usize chunks = 0;
+        usize flip = 0;
+        usize flip_cost = 4;
+
+        forEachChunk([&nibbles, &chunks, &flip, &flip_cost](u8, usize chunk, usize width) {
+            nibbles += runCost(chunk, width);
+            ++chunks;
+
+            usize cost = chunk == 2 || width == 1 ? 1 : 3;
+
+            if (chunk > 1 && cost < flip_cost) {
+                flip = chunks;
+                flip_cost = cost;
+            }
+        });
+
+        if (nibbles % 2 == 0) {
+            flip = 0;
+        }
+
+        chunks = 0;
+
+        forEachChunk([&put, &putCharacter, &chunks, flip](u8 value, usize chunk, usize width) {
+            bool counted = runCost(chunk, width) < chunk * width;
+
+            // Two characters swap between CharCount and one by one, longer
+            // chunks give their first character away.
+            if (++chunks == flip) {
+                if (chunk == 2) {
+                    counted = !counted;
+                } else {
+                    putCharacter(value);
+
+                    --chunk;
+                    counted = true;
+                }
+            }
+
+            if (counted) {
+                put(ControlCode::CharCount);
+                put(static_cast<u8>(chunk - 2));
+                putCharacter(value);
+            } else {
+                for (usize n = 0; n < chunk; ++n) {
+                    putCharacter(value);
+                }
+            }
+        });
+
+        // Without a run to change, the unused last nibble is 0 like the help
+        // linker leaves it.
+        if (high) {
+            put(0);
+        }
+    }
+};
+
+using UncompressFunction = void (*)(const u8 *data, usize size, const FileHeader &file_header, const Compression &compression, std::string &result) noexcept;
+
+// Entry point of the Text record decoding for a given format and compression.
+// Specialize it to give a format its own decoding rules.
+template<Version::Format F, Compression::Type C>
+struct Decoder {
+    static void uncompress(const u8 *data, usize size, const FileHeader &file_header, const Compression &compression, std::string &result) noexcept
+    {
+        Codec<C>::uncompress(data, size, file_header, compression, result);
+    }
+};
+
+template<Version::Format F>
+UncompressFunction
+selectDecoder(Compression::Type type) noexcept
+{
+    switch (type) {
+        case Compression::Nibble  : return &Decoder<F, Compression::Nibble>::uncompress;
+        case Compression::Invalid : break;
+    }
+
+    return nullptr;
+}
+
+inline UncompressFunction
+selectDecoder(Version::Format format, Compression::Type type) noexcept
+{
+    switch (format) {
+        case Version::TP2     : return selectDecoder<Version::TP2>(type);
+        case Version::TP4     : return selectDecoder<Version::TP4>(type);
+        case Version::TP6     : return selectDecoder<Version::TP6>(type);
+        case Version::BP7     : return selectDecoder<Version::BP7>(type);
+        case Version::Invalid : break;
+    }
+
+    return nullptr;
+}
+
+} // namespace BHF
+
+#endif // BHFCONVERTER_SRC_BHF_DECODER_HPP
@@ -9,6 +9,7 @@
 namespace BHF {
 
 struct FileData;
+struct ByteStream;
 
 class File
 {
@@ -16,6 +17,8 @@ public:
     enum TextFormat {
           PlainText
         , HTML
+        , Markdown
+        , Raw
     };
 
     using ContextType = int;
@@ -24,12 +27,36 @@ public:
     using IndexType = struct {ContextType context; std::string index; };
     using IndexContainer = std::vector<IndexType>;
 
+    using IndexTagType = struct {u16 index; std::string tag; };
+    using IndexTagContainer = std::vector<IndexTagType>;
+
+    struct KeywordType {
+        ContextType up;
+        ContextType down;
+        ContextContainer contexts;
+    };
+
+    // Contexts in a table owned by the File, usable in a range for.
+    struct ContextRange {
+        const ContextType *first;
+        const ContextType *last;
+
+        const ContextType *begin() const noexcept { return first; }
+        const ContextType *end() const noexcept { return last; }
+        bool empty() const noexcept { return first == last; }
+        usize size() const noexcept { return static_cast<usize>(last - first); }
+    };
+
     File() noexcept;
     File(std::string_view filepath) noexcept;
     ~File() noexcept;
 
     bool open(std::string_view filepath) noexcept;
 
+    // Takes a help file already in memory, or its beginning up to the
+    // first topic as read by a RecordStream.
+    bool open(std::vector<u8> &&buffer) noexcept;
+
     const std::string &stamp() const noexcept;
     const std::string &signature() const noexcept;
     const Version &version() const noexcept;
@@ -37,28 +64,47 @@ public:
     const Compression &compression() const noexcept;
     const ContextContainer &context() const noexcept;
     const IndexContainer &index() const noexcept;
-    std::string text(ContextType offset, TextFormat format = PlainText) noexcept;
+    const IndexTagContainer &indexTags() const noexcept;
+
+    // The way back from context()[context] to the offset, from tables built
+    // at open: the contexts pointing to the topic at `offset` in context
+    // order, empty when none does, and the first of them, -1 when none.
+    // Binary search.
+    ContextRange contextsOf(ContextType offset) const noexcept;
+    ContextType contextOf(ContextType offset) const noexcept;
+
+    // True when a lower numbered context points to the same topic, the help
+    // compiler writes one context per alias of a topic.
+    bool isAlias(ContextType context) const noexcept;
+    std::string text(ContextType offset, TextFormat format = PlainText) const noexcept;
+    KeywordType keywords(ContextType offset) const noexcept;
+    std::string_view topicData(ContextType offset) const noexcept;
+
+    // Same as text() and keywords(), for the records of a topic as returned
+    // by topicData() or read by a RecordStream.
+    std::string formatTopic(std::string_view records, TextFormat format = PlainText) const noexcept;
+    KeywordType topicKeywords(std::string_view records) const noexcept;
+
+    // Same as text() and formatTopic(), into `result`, with `scratch` for the
+    // uncompressed text. Both keep their capacity between calls, for threads
+    // decoding many topics. False when there is no Text record at `offset`
+    // or in `records`, or, for HTML and Markdown, the Keyword record after it
+    // is damaged; `result` is then empty. The versions returning the text
+    // return an empty one.
+    bool text(ContextType offset, TextFormat format, std::string &result, std::string &scratch) const noexcept;
+    bool formatTopic(std::string_view records, TextFormat format, std::string &result, std::string &scratch) const noexcept;
+
+    // Same as keywords() and topicKeywords(), false on the same damaged
+    // records, which the versions returning the links take as no links.
+    bool keywords(ContextType offset, KeywordType &result) const noexcept;
+    bool topicKeywords(std::string_view records, KeywordType &result) const noexcept;
 
     const std::string &lastError() const noexcept;
 
 private:
-    struct KeywordData {
-        ContextType up;
-        ContextType down;
-        ContextContainer contexts;
-    };
-
-    std::string BHF_FormatAsText(const std::string &text) const;
-    std::string BHF_FormatAsHTML(const std::string &text);
-
-    std::string uncompress(const RecordHeader &record);
-    void readString(std::string &str) noexcept;
-    KeywordData readKeywords() noexcept;
-
-    template<typename T>
-    T readType() noexcept;
+    bool readKeywords(ByteStream &stream, KeywordType &result) const noexcept;
 
-    void parse() noexcept;
+    bool parse() noexcept;
 
     std::unique_ptr<FileData> d;
 };
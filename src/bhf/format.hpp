@@ -0,0 +1,544 @@
+// SPDX-License-Identifier: MIT
+// Copyright (c) 2022 Gustavo Ribeiro Croscato
+
+#ifndef BHFCONVERTER_SRC_BHF_FORMAT_HPP
+#define BHFCONVERTER_SRC_BHF_FORMAT_HPP 1
+
+#include <charconv>
+
+#include "decoder.hpp"
+#include "file.hpp"
+
+namespace BHF {
+
+// reference: https://en.wikipedia.org/wiki/Code_page_437
+inline constexpr std::array<std::string_view, 256> kCP437toUTF8 = {
+    "[0]", "\u263a", "\u263b", "\u2665", "\u2666", "\u2663", "\u2660", "\u2022",
+    "\u25d8", "\u25cb", "\u25d9", "\u2642", "\u2640", "\u266a", "\u266b", "\u263c",
+    "\u25ba", "\u25c4", "\u2195", "\u203c", "\u00b6", "\u00a7", "\u25ac", "\u21a8",
+    "\u2191", "\u2193", "\u2192", "\u2190", "\u221f", "\u2194", "\u25b2", "\u25bc",
+    " ", "!", "\"", "#", "$", "%", "&", "'",
+    "(", ")", "*", "+", ",", "-", ".", "/",
+    "0", "1", "2", "3", "4", "5", "6", "7",
+    "8", "9", ":", ";", "<", "=", ">", "?",
+    "@", "A", "B", "C", "D", "E", "F", "G",
+    "H", "I", "J", "K", "L", "M", "N", "O",
+    "P", "Q", "R", "S", "T", "U", "V", "W",
+    "X", "Y", "Z", "[", "\\", "]", "^", "_",
+    "`", "a", "b", "c", "d", "e", "f", "g",
+    "h", "i", "j", "k", "l", "m", "n", "o",
+    "p", "q", "r", "s", "t", "u", "v", "w",
+    "x", "y", "z", "{", "|", "}", "~", "\u2302",
+    "\u00c7", "\u00fc", "\u00e9", "\u00e2", "\u00e4", "\u00e0", "\u00e5", "\u00e7",
+    "\u00ea", "\u00eb", "\u00e8", "\u00ef", "\u00ee", "\u00ec", "\u00c4", "\u00c5",
+    "\u00c9", "\u00e6", "\u00c6", "\u00f4", "\u00f6", "\u00f2", "\u00fb", "\u00f9",
+    "\u00ff", "\u00d6", "\u00dc", "\u00a2", "\u00a3", "\u00a5", "\u20a7", "\u0192",
+    "\u00e1", "\u00ed", "\u00f3", "\u00fa", "\u00f1", "\u00d1", "\u00aa", "\u00ba",
+    "\u00bf", "\u2310", "\u00ac", "\u00bd", "\u00bc", "\u00a1", "\u00ab", "\u00bb",
+    "\u2591", "\u2592", "\u2593", "\u2502", "\u2524", "\u2561", "\u2562", "\u2556",
+    "\u2555", "\u2563", "\u2551", "\u2557", "\u255d", "\u255c", "\u255b", "\u2510",
+    "\u2514", "\u2534", "\u252c", "\u251c", "\u2500", "\u253c", "\u255e", "\u255f",
+    "\u255a", "\u2554", "\u2569", "\u2566", "\u2560", "\u2550", "\u256c", "\u2567",
+    "\u2568", "\u2564", "\u2565", "\u2559", "\u2558", "\u2552", "\u2553", "\u256b",
+    "\u256a", "\u2518", "\u250c", "\u2588", "\u2584", "\u258c", "\u2590", "\u2580",
+    "\u03b1", "\u00df", "\u0393", "\u03c0", "\u03a3", "\u03c3", "\u00b5", "\u03c4",
+    "\u03a6", "\u0398", "\u03a9", "\u03b4", "\u221e", "\u03c6", "\u03b5", "\u2229",
+    "\u2261", "\u00b1", "\u2265", "\u2264", "\u2320", "\u2321", "\u00f7", "\u2248",
+    "\u00b0", "\u2219", "\u00b7", "\u221a", "\u207f", "\u00b2", "\u25a0", "\u00a0",
+};
+
+// kCP437toUTF8 as UTF-16 for frontends that keep text that way, such as Qt.
+// Every character is a single code unit, so text laid out as a grid of cells
+// stays one. That is why NUL differs: its "[0]" placeholder is three
+// characters wide, here it is a blank.
+inline constexpr std::array<char16_t, 256> kCP437toUTF16 = {
+    u' ', u'\u263a', u'\u263b', u'\u2665', u'\u2666', u'\u2663', u'\u2660', u'\u2022',
+    u'\u25d8', u'\u25cb', u'\u25d9', u'\u2642', u'\u2640', u'\u266a', u'\u266b', u'\u263c',
+    u'\u25ba', u'\u25c4', u'\u2195', u'\u203c', u'\u00b6', u'\u00a7', u'\u25ac', u'\u21a8',
+    u'\u2191', u'\u2193', u'\u2192', u'\u2190', u'\u221f', u'\u2194', u'\u25b2', u'\u25bc',
+    u' ', u'!', u'"', u'#', u'$', u'%', u'&', u'\'',
+    u'(', u')', u'*', u'+', u',', u'-', u'.', u'/',
+    u'0', u'1', u'2', u'3', u'4', u'5', u'6', u'7',
+    u'8', u'9', u':', u';', u'<', u'=', u'>', u'?',
+    u'@', u'A', u'B', u'C', u'D', u'E', u'F', u'G',
+    u'H', u'I', u'J', u'K', u'L', u'M', u'N', u'O',
+    u'P', u'Q', u'R', u'S', u'T', u'U', u'V', u'W',
+    u'X', u'Y', u'Z', u'[', u'\\', u']', u'^', u'_',
+    u'`', u'a', u'b', u'c', u'd', u'e', u'f', u'g',
+    u'h', u'i', u'j', u'k', u'l', u'm', u'n', u'o',
+    u'p', u'q', u'r', u's', u't', u'u', u'v', u'w',
+    u'x', u'y', u'z', u'{', u'|', u'}', u'~', u'\u2302',
+    u'\u00c7', u'\u00fc', u'\u00e9', u'\u00e2', u'\u00e4', u'\u00e0', u'\u00e5', u'\u00e7',
+    u'\u00ea', u'\u00eb', u'\u00e8', u'\u00ef', u'\u00ee', u'\u00ec', u'\u00c4', u'\u00c5',
+    u'\u00c9', u'\u00e6', u'\u00c6', u'\u00f4', u'\u00f6', u'\u00f2', u'\u00fb', u'\u00f9',
+    u'\u00ff', u'\u00d6', u'\u00dc', u'\u00a2', u'\u00a3', u'\u00a5', u'\u20a7', u'\u0192',
+    u'\u00e1', u'\u00ed', u'\u00f3', u'\u00fa', u'\u00f1', u'\u00d1', u'\u00aa', u'\u00ba',
+    u'\u00bf', u'\u2310', u'\u00ac', u'\u00bd', u'\u00bc', u'\u00a1', u'\u00ab', u'\u00bb',
+    u'\u2591', u'\u2592', u'\u2593', u'\u2502', u'\u2524', u'\u2561', u'\u2562', u'\u2556',
+    u'\u2555', u'\u2563', u'\u2551', u'\u2557', u'\u255d', u'\u255c', u'\u255b', u'\u2510',
+    u'\u2514', u'\u2534', u'\u252c', u'\u251c', u'\u2500', u'\u253c', u'\u255e', u'\u255f',
+    u'\u255a', u'\u2554', u'\u2569', u'\u2566', u'\u2560', u'\u2550', u'\u256c', u'\u2567',
+    u'\u2568', u'\u2564', u'\u2565', u'\u2559', u'\u2558', u'\u2552', u'\u2553', u'\u256b',
+    u'\u256a', u'\u2518', u'\u250c', u'\u2588', u'\u2584', u'\u258c', u'\u2590', u'\u2580',
+    u'\u03b1', u'\u00df', u'\u0393', u'\u03c0', u'\u03a3', u'\u03c3', u'\u00b5', u'\u03c4',
+    u'\u03a6', u'\u0398', u'\u03a9', u'\u03b4', u'\u221e', u'\u03c6', u'\u03b5', u'\u2229',
+    u'\u2261', u'\u00b1', u'\u2265', u'\u2264', u'\u2320', u'\u2321', u'\u00f7', u'\u2248',
+    u'\u00b0', u'\u2219', u'\u00b7', u'\u221a', u'\u207f', u'\u00b2', u'\u25a0', u'\u00a0',
+};
+
+// Writes CP437 text as UTF-16 to `out`, which has room for text.size() code
+// units, and returns the end of what was written. Lets frontends fill their
+// own string type, such as QString, in place.
+inline char16_t *
+convertUTF16(std::string_view text, char16_t *out) noexcept
+{
+    for (char c : text) {
+        *out++ = kCP437toUTF16[static_cast<u8>(c)];
+    }
+
+    return out;
+}
+
+// Appends CP437 text as UTF-8, runs of plain ASCII are copied at once.
+inline void
+appendUTF8(std::string &out, std::string_view text) noexcept
+{
+    std::string_view::size_type i = 0;
+
+    while (i < text.size()) {
+        std::string_view::size_type start = i;
+
+        while (i < text.size() && static_cast<u8>(text[i]) >= 0x20 && static_cast<u8>(text[i]) < 0x7f) {
+            ++i;
+        }
+
+        if (i > start) {
+            out.append(text, start, i - start);
+        }
+
+        if (i < text.size()) {
+            out += kCP437toUTF8[static_cast<u8>(text[i++])];
+        }
+    }
+}
+
+// Walks an uncompressed Text record and reports its structure to an
+// emitter, which only ever appends to its output:
+//
+//   begin() / end()
+//   text(run)              CP437 characters, no control codes
+//   newLine()
+//   keywordBegin(context)  keywordEnd()
+//   codeBegin()            codeEnd()
+//
+// Spaces around a keyword are kept outside of it, so the link covers only
+// the visible word(s).
+template<typename Emitter>
+void
+formatText(std::string_view text, const File::KeywordType &keywords, Emitter &emitter) noexcept
+{
+    std::array<u8, 64> pending{};
+    usize pending_count = 0;
+
+    File::ContextContainer::size_type keyword = 0;
+    File::ContextType target = -1;
+
+    bool in_keyword = false;
+    bool keyword_open = false;
+    bool in_code = false;
+
+    auto flush = [&]() -> void {
+        for (usize p = 0; p < pending_count; ++p) {
+            if (pending[p] == ControlCode::NewLine) {
+                emitter.newLine();
+            } else {
+                emitter.text(" ");
+            }
+        }
+
+        pending_count = 0;
+    };
+
+    auto hold = [&](u8 value) -> void {
+        if (pending_count == pending.size()) {
+            flush();
+        }
+
+        pending[pending_count++] = value;
+    };
+
+    emitter.begin();
+
+    std::string_view::size_type i = 0;
+
+    while (i < text.size()) {
+        u8 value = static_cast<u8>(text[i]);
+
+        if (ControlCode::isValid(value)) {
+            ++i;
+
+            if (value == ControlCode::NewLine) {
+                if (keyword_open) {
+                    hold(value);
+                } else {
+                    emitter.newLine();
+                }
+            } else if (value == ControlCode::KeywordMark) {
+                in_keyword = !in_keyword;
+
+                if (in_keyword) {
+                    target = keyword < keywords.contexts.size() ? keywords.contexts[keyword] : -1;
+                    ++keyword;
+                } else if (keyword_open) {
+                    emitter.keywordEnd();
+                    keyword_open = false;
+
+                    flush();
+                }
+            } else if (value == ControlCode::SourceCode) {
+                flush();
+
+                in_code = !in_code;
+
+                if (in_code) {
+                    emitter.codeBegin();
+                } else {
+                    emitter.codeEnd();
+                }
+            } else if (value == ControlCode::DocumentEnd) {
+                break;
+            }
+
+            continue;
+        }
+
+        if (in_keyword) {
+            if (value == kAsciiSpace) {
+                if (keyword_open) {
+                    hold(value);
+                } else {
+                    emitter.text(text.substr(i, 1));
+                }
+
+                ++i;
+
+                continue;
+            }
+
+            if (!keyword_open && target >= 0) {
+                emitter.keywordBegin(target);
+                keyword_open = true;
+            }
+
+            flush();
+        }
+
+        std::string_view::size_type end = i + 1;
+
+        while (end < text.size() && !ControlCode::isValid(static_cast<u8>(text[end])) && !(in_keyword && text[end] == ' ')) {
+            ++end;
+        }
+
+        emitter.text(text.substr(i, end - i));
+
+        i = end;
+    }
+
+    if (keyword_open) {
+        emitter.keywordEnd();
+    }
+
+    flush();
+
+    if (in_code) {
+        emitter.codeEnd();
+    }
+
+    emitter.end();
+}
+
+struct PlainTextEmitter {
+    void begin() noexcept {}
+    void end() noexcept {}
+
+    void text(std::string_view run) noexcept
+    {
+        appendUTF8(out, run);
+    }
+
+    void newLine() noexcept
+    {
+        out += '\n';
+    }
+
+    void keywordBegin(File::ContextType context) noexcept
+    {
+        UNUSED(context);
+    }
+
+    void keywordEnd() noexcept {}
+    void codeBegin() noexcept {}
+    void codeEnd() noexcept {}
+
+    std::string &out;
+};
+
+// Default link of the HTML and Markdown emitters: the context number, as
+// used by the GUI.
+struct ContextNumberLink {
+    void operator()(std::string &out, File::ContextType context) const noexcept
+    {
+        std::array<char, 16> buffer{};
+
+        auto [end, error] = std::to_chars(buffer.data(), buffer.data() + buffer.size(), context);
+
+        UNUSED(error);
+
+        out.append(buffer.data(), end);
+    }
+};
+
+template<typename Link = ContextNumberLink>
+struct HTMLEmitter {
+    void begin() noexcept
+    {
+        out += "<pre>";
+    }
+
+    void end() noexcept
+    {
+        out += "</pre>";
+    }
+
+    void text(std::string_view run) noexcept
+    {
+        for (char c : run) {
+            switch (static_cast<u8>(c)) {
+                case 0x20: out += "&nbsp;"; break;
+                case 0x22: out += "&quot;"; break;
+                case 0x26: out += "&amp;"; break;
+                case 0x27: out += "&#39;"; break;
+                case 0x2f: out += "&#47;"; break;
+                case 0x3c: out += "&lt;"; break;
+                case 0x3e: out += "&gt;"; break;
+                default: out += kCP437toUTF8[static_cast<u8>(c)]; break;
+            }
+        }
+    }
+
+    void newLine() noexcept
+    {
+        out += "<br>";
+    }
+
+    void keywordBegin(File::ContextType context) noexcept
+    {
+        out += "<a href=\"";
+        link(out, context);
+        out += "\">";
+    }
+
+    void keywordEnd() noexcept
+    {
+        out += "</a>";
+    }
+
+    void codeBegin() noexcept
+    {
+        out += "<code>";
+    }
+
+    void codeEnd() noexcept
+    {
+        out += "</code>";
+    }
+
+    std::string &out;
+    Link link{};
+};
+
+// CommonMark output. Line breaks of the topic are kept as hard breaks and
+// blank lines as paragraph breaks; both are written only once the next
+// content shows which one it is. Leading spaces become &nbsp; so indented
+// lines are not taken as code blocks, and characters that would open a
+// block at the start of a line (headings, lists, setext underlines) are
+// escaped. Keywords inside source code are written as plain text since a
+// fenced block does not render links.
+template<typename Link = ContextNumberLink>
+struct MarkdownEmitter {
+    void begin() noexcept {}
+
+    void end() noexcept
+    {
+        if (!out.empty() && out.back() != '\n') {
+            out += '\n';
+        }
+    }
+
+    void text(std::string_view run) noexcept
+    {
+        if (in_code) {
+            appendUTF8(out, run);
+
+            return;
+        }
+
+        flushBreaks();
+
+        for (char c : run) {
+            u8 value = static_cast<u8>(c);
+
+            if (value == kAsciiSpace && line_start) {
+                out += "&nbsp;";
+
+                continue;
+            }
+
+            // A run of digits opening the line followed by '.' or ')' is an
+            // ordered list marker.
+            bool number = digits > 0;
+
+            digits = (value >= '0' && value <= '9' && (line_start || number)) ? digits + 1 : 0;
+
+            switch (value) {
+                case '\\':
+                case '`':
+                case '*':
+                case '_':
+                case '~':
+                case '&':
+                case '[':
+                case ']':
+                case '<':
+                case '>':
+                case '#':
+                case '|':
+                    out += '\\';
+                    out += c;
+                    break;
+
+                case '-':
+                case '+':
+                case '=':
+                    if (line_start) {
+                        out += '\\';
+                    }
+
+                    out += c;
+                    break;
+
+                case '.':
+                case ')':
+                    if (number) {
+                        out += '\\';
+                    }
+
+                    out += c;
+                    break;
+
+                default:
+                    out += kCP437toUTF8[value];
+                    break;
+            }
+
+            line_start = false;
+        }
+    }
+
+    void newLine() noexcept
+    {
+        if (in_code) {
+            out += '\n';
+        } else {
+            ++breaks;
+            line_start = true;
+            digits = 0;
+        }
+    }
+
+    void keywordBegin(File::ContextType context) noexcept
+    {
+        linked = !in_code;
+
+        if (!linked) {
+            return;
+        }
+
+        flushBreaks();
+
+        // "![" would open an image instead of a link
+        if (!out.empty() && out.back() == '!') {
+            out.insert(out.size() - 1, 1, '\\');
+        }
+
+        out += '[';
+
+        target = context;
+        line_start = false;
+        digits = 0;
+    }
+
+    void keywordEnd() noexcept
+    {
+        if (!linked) {
+            return;
+        }
+
+        out += "](";
+        link(out, target);
+        out += ')';
+
+        linked = false;
+    }
+
+    void codeBegin() noexcept
+    {
+        if (!out.empty() && out.back() != '\n') {
+            out += '\n';
+        }
+
+        breaks = 0;
+
+        out += "```\n";
+
+        in_code = true;
+    }
+
+    void codeEnd() noexcept
+    {
+        if (out.back() != '\n') {
+            out += '\n';
+        }
+
+        out += "```\n";
+
+        in_code = false;
+        line_start = true;
+        digits = 0;
+    }
+
+    void flushBreaks() noexcept
+    {
+        if (breaks == 1) {
+            out += "\\\n";
+        } else if (breaks > 1) {
+            out += "\n\n";
+        }
+
+        breaks = 0;
+    }
+
+    std::string &out;
+    Link link{};
+
+    File::ContextType target = 0;
+    usize breaks = 0;
+    usize digits = 0;
+    bool line_start = true;
+    bool in_code = false;
+    bool linked = false;
+};
+
+} // namespace BHF
+
+#endif // BHFCONVERTER_SRC_BHF_FORMAT_HPP
@@ -0,0 +1,354 @@
+// SPDX-License-Identifier: MIT
+// Copyright (c) 2022 Gustavo Ribeiro Croscato
+
+#include <atomic>
+#include <thread>
+
+#include "graph.hpp"
+
+namespace BHF {
+
+// Contexts read by a thread at a time.
+static constexpr usize kContextsPerChunk = 256;
+
+struct LinkGraphData {
+    // Keyword links of context c are targets[first[c]] .. targets[first[c + 1] - 1].
+    std::vector<u32> first;
+    File::ContextContainer targets;
+
+    File::ContextContainer up;
+    File::ContextContainer down;
+
+    // Lowest context of the topic of every context, itself when it has none.
+    File::ContextContainer primary;
+
+    std::vector<u32> in_degree;
+    std::vector<u32> browse_in;
+    std::vector<u8> has_topic;
+};
+
+struct GraphChunk {
+    File::ContextContainer targets;
+};
+
+static File::ContextType
+LinkGraph_Primary(const LinkGraphData &data, File::ContextType context) noexcept
+{
+    return context >= 0 && static_cast<usize>(context) < data.primary.size() ? data.primary[static_cast<usize>(context)] : context;
+}
+
+LinkGraph::LinkGraph() noexcept
+    : d{std::make_unique<LinkGraphData>()}
+{
+    d->first.push_back(0);
+}
+
+LinkGraph::LinkGraph(const File &file, unsigned jobs) noexcept
+    : LinkGraph()
+{
+    build(file, jobs);
+}
+
+LinkGraph::~LinkGraph() noexcept = default;
+
+void
+LinkGraph::build(const File &file, unsigned jobs) noexcept
+{
+    d = std::make_unique<LinkGraphData>();
+
+    const File::ContextContainer &contexts = file.context();
+
+    usize count = contexts.size();
+    usize chunk_count = (count + kContextsPerChunk - 1) / kContextsPerChunk;
+
+    d->first.assign(count + 1, 0);
+    d->up.assign(count, 0);
+    d->down.assign(count, 0);
+    d->in_degree.assign(count, 0);
+    d->browse_in.assign(count, 0);
+    d->has_topic.assign(count, 0);
+    d->primary.resize(count);
+
+    for (usize c = 0; c < count; ++c) {
+        ContextType context = static_cast<ContextType>(c);
+
+        d->primary[c] = file.isAlias(context) ? file.contextOf(contexts[c]) : context;
+    }
+
+    std::vector<GraphChunk> chunks(chunk_count);
+    std::atomic<usize> next = 0;
+
+    // Every chunk writes its own contexts only, the links are appended to
+    // the chunk and the out degrees go to first[c + 1] for the prefix sum.
+    // Aliases are skipped, their topic is read at the primary.
+    auto worker = [&]() -> void {
+        for (usize chunk = next++; chunk < chunk_count; chunk = next++) {
+            usize begin = chunk * kContextsPerChunk;
+            usize end = std::min(begin + kContextsPerChunk, count);
+
+            for (usize c = begin; c < end; ++c) {
+                if (contexts[c] < 0 || d->primary[c] != static_cast<ContextType>(c)) {
+                    continue;
+                }
+
+                File::KeywordType keywords = file.keywords(contexts[c]);
+
+                d->has_topic[c] = 1;
+                d->up[c] = LinkGraph_Primary(*d, keywords.up);
+                d->down[c] = LinkGraph_Primary(*d, keywords.down);
+                d->first[c + 1] = static_cast<u32>(keywords.contexts.size());
+
+                for (ContextType target : keywords.contexts) {
+                    chunks[chunk].targets.push_back(LinkGraph_Primary(*d, target));
+                }
+            }
+        }
+    };
+
+    std::vector<std::thread> threads;
+
+    for (unsigned i = 1; i < jobs && i < chunk_count; ++i) {
+        threads.emplace_back(worker);
+    }
+
+    worker();
+
+    for (std::thread &thread : threads) {
+        thread.join();
+    }
+
+    for (usize c = 0; c < count; ++c) {
+        d->first[c + 1] += d->first[c];
+    }
+
+    d->targets.reserve(d->first[count]);
+
+    for (GraphChunk &chunk : chunks) {
+        d->targets.insert(d->targets.end(), chunk.targets.begin(), chunk.targets.end());
+    }
+
+    for (ContextType target : d->targets) {
+        if (hasTopic(target)) {
+            ++d->in_degree[static_cast<usize>(target)];
+        }
+    }
+
+    for (usize c = 0; c < count; ++c) {
+        ContextType context = static_cast<ContextType>(c);
+
+        if (d->up[c] != context && hasTopic(d->up[c]) && d->up[c] > 0) {
+            ++d->browse_in[static_cast<usize>(d->up[c])];
+        }
+
+        if (d->down[c] != context && hasTopic(d->down[c]) && d->down[c] > 0) {
+            ++d->browse_in[static_cast<usize>(d->down[c])];
+        }
+    }
+}
+
+usize
+LinkGraph::size() const noexcept
+{
+    return d->has_topic.size();
+}
+
+usize
+LinkGraph::linkCount() const noexcept
+{
+    return d->targets.size();
+}
+
+bool
+LinkGraph::hasTopic(ContextType context) const noexcept
+{
+    return context >= 0 && static_cast<usize>(context) < d->has_topic.size() && d->has_topic[static_cast<usize>(context)];
+}
+
+LinkGraph::ContextType
+LinkGraph::primary(ContextType context) const noexcept
+{
+    return LinkGraph_Primary(*d, context);
+}
+
+LinkGraph::Targets
+LinkGraph::targets(ContextType context) const noexcept
+{
+    context = primary(context);
+
+    if (context < 0 || static_cast<usize>(context) >= size()) {
+        return {nullptr, nullptr};
+    }
+
+    const ContextType *data = d->targets.data();
+
+    return {data + d->first[static_cast<usize>(context)], data + d->first[static_cast<usize>(context) + 1]};
+}
+
+LinkGraph::ContextType
+LinkGraph::up(ContextType context) const noexcept
+{
+    context = primary(context);
+
+    return hasTopic(context) ? d->up[static_cast<usize>(context)] : 0;
+}
+
+LinkGraph::ContextType
+LinkGraph::down(ContextType context) const noexcept
+{
+    context = primary(context);
+
+    return hasTopic(context) ? d->down[static_cast<usize>(context)] : 0;
+}
+
+u32
+LinkGraph::outDegree(ContextType context) const noexcept
+{
+    return static_cast<u32>(targets(context).size());
+}
+
+u32
+LinkGraph::inDegree(ContextType context) const noexcept
+{
+    context = primary(context);
+
+    return hasTopic(context) ? d->in_degree[static_cast<usize>(context)] : 0;
+}
+
+LinkGraph::ContextContainer
+LinkGraph::orphans() const noexcept
+{
+    ContextContainer result;
+
+    for (usize c = 0; c < size(); ++c) {
+        if (d->has_topic[c] && d->in_degree[c] == 0 && d->browse_in[c] == 0) {
+            result.push_back(static_cast<ContextType>(c));
+        }
+    }
+
+    return result;
+}
+
+LinkGraph::ContextContainer
+LinkGraph::unreachable(ContextType root) const noexcept
+{
+    std::vector<u8> visited(size(), 0);
+    ContextContainer pending;
+
+    auto visit = [&](ContextType context) -> void {
+        if (hasTopic(context) && !visited[static_cast<usize>(context)]) {
+            visited[static_cast<usize>(context)] = 1;
+            pending.push_back(context);
+        }
+    };
+
+    visit(primary(root));
+
+    while (!pending.empty()) {
+        ContextType context = pending.back();
+        pending.pop_back();
+
+        for (ContextType target : targets(context)) {
+            visit(target);
+        }
+
+        if (up(context) > 0) {
+            visit(up(context));
+        }
+
+        if (down(context) > 0) {
+            visit(down(context));
+        }
+    }
+
+    ContextContainer result;
+
+    for (usize c = 0; c < size(); ++c) {
+        if (d->has_topic[c] && !visited[c]) {
+            result.push_back(static_cast<ContextType>(c));
+        }
+    }
+
+    return result;
+}
+
+LinkGraph::LinkContainer
+LinkGraph::dangling() const noexcept
+{
+    LinkContainer result;
+
+    for (usize c = 0; c < size(); ++c) {
+        ContextType source = static_cast<ContextType>(c);
+
+        for (ContextType target : targets(source)) {
+            if (!hasTopic(target)) {
+                result.push_back({source, target});
+            }
+        }
+
+        if (d->up[c] > 0 && !hasTopic(d->up[c])) {
+            result.push_back({source, d->up[c]});
+        }
+
+        if (d->down[c] > 0 && !hasTopic(d->down[c])) {
+            result.push_back({source, d->down[c]});
+        }
+    }
+
+    return result;
+}
+
+LinkGraph::ChainContainer
+LinkGraph::chains() const noexcept
+{
+    // Topics some other topic browses down to are not the start of a chain.
+    std::vector<u8> has_previous(size(), 0);
+
+    for (usize c = 0; c < size(); ++c) {
+        ContextType next = d->down[c];
+
+        if (next > 0 && hasTopic(next) && static_cast<usize>(next) != c) {
+            has_previous[static_cast<usize>(next)] = 1;
+        }
+    }
+
+    ChainContainer result;
+    std::vector<u8> visited(size(), 0);
+
+    for (usize c = 0; c < size(); ++c) {
+        if (!d->has_topic[c] || has_previous[c] || !hasTopic(d->down[c]) || d->down[c] <= 0) {
+            continue;
+        }
+
+        ContextContainer chain;
+
+        for (ContextType context = static_cast<ContextType>(c); hasTopic(context) && context > 0 && !visited[static_cast<usize>(context)]; context = d->down[static_cast<usize>(context)]) {
+            visited[static_cast<usize>(context)] = 1;
+            chain.push_back(context);
+        }
+
+        if (chain.size() > 1) {
+            result.push_back(std::move(chain));
+        }
+    }
+
+    return result;
+}
+
+LinkGraph::LinkContainer
+LinkGraph::brokenChains() const noexcept
+{
+    LinkContainer result;
+
+    for (usize c = 0; c < size(); ++c) {
+        ContextType source = static_cast<ContextType>(c);
+        ContextType next = d->down[c];
+
+        if (next > 0 && hasTopic(next) && up(next) != source) {
+            result.push_back({source, next});
+        }
+    }
+
+    return result;
+}
+
+} // namespace BHF
@@ -0,0 +1,86 @@
+// SPDX-License-Identifier: MIT
+// Copyright (c) 2022 Gustavo Ribeiro Croscato
+
+#ifndef BHFCONVERTER_SRC_BHF_GRAPH_HPP
+#define BHFCONVERTER_SRC_BHF_GRAPH_HPP 1
+
+#include "file.hpp"
+
+namespace BHF {
+
+struct LinkGraphData;
+
+// Links between the topics of a help file: keyword links, stored as
+// compressed sparse rows in keyword order, and the up/down browse links.
+// Contexts are the vertices, a context without a topic has no links. An
+// alias is folded onto the lowest context of its topic, its primary: links
+// to it go to the primary, and queries about it answer for the primary.
+class LinkGraph
+{
+public:
+    using ContextType = File::ContextType;
+    using ContextContainer = File::ContextContainer;
+
+    struct Link {
+        ContextType source;
+        ContextType target;
+    };
+
+    using LinkContainer = std::vector<Link>;
+    using ChainContainer = std::vector<ContextContainer>;
+
+    struct Targets {
+        const ContextType *begin() const noexcept { return first; }
+        const ContextType *end() const noexcept { return last; }
+        usize size() const noexcept { return static_cast<usize>(last - first); }
+
+        const ContextType *first;
+        const ContextType *last;
+    };
+
+    LinkGraph() noexcept;
+    LinkGraph(const File &file, unsigned jobs = 1) noexcept;
+    ~LinkGraph() noexcept;
+
+    // Reads the Keyword record of every topic of `file` once, `jobs` threads
+    // at a time.
+    void build(const File &file, unsigned jobs = 1) noexcept;
+
+    usize size() const noexcept;
+    usize linkCount() const noexcept;
+
+    // False for aliases, the topic is counted at their primary.
+    bool hasTopic(ContextType context) const noexcept;
+    ContextType primary(ContextType context) const noexcept;
+
+    Targets targets(ContextType context) const noexcept;
+    ContextType up(ContextType context) const noexcept;
+    ContextType down(ContextType context) const noexcept;
+
+    // Keyword links only, a topic linking twice to the same target counts twice.
+    u32 outDegree(ContextType context) const noexcept;
+    u32 inDegree(ContextType context) const noexcept;
+
+    // Topics no keyword or browse link of another topic leads to.
+    ContextContainer orphans() const noexcept;
+
+    // Topics that can't be reached from `root` following keyword and browse links.
+    ContextContainer unreachable(ContextType root) const noexcept;
+
+    // Keyword and browse links to contexts without a topic.
+    LinkContainer dangling() const noexcept;
+
+    // Browse sequences: from a topic nothing browses down to, follow the down
+    // links until they end or loop. Only sequences of two or more topics.
+    ChainContainer chains() const noexcept;
+
+    // Down links whose target does not browse back up to the source.
+    LinkContainer brokenChains() const noexcept;
+
+private:
+    std::unique_ptr<LinkGraphData> d;
+};
+
+} // namespace BHF
+
+#endif // BHFCONVERTER_SRC_BHF_GRAPH_HPP
@@ -0,0 +1,69 @@
+// SPDX-License-Identifier: MIT
+// Copyright (c) 2022 Gustavo Ribeiro Croscato
+
+#ifndef BHFCONVERTER_SRC_BHF_HASH_HPP
+#define BHFCONVERTER_SRC_BHF_HASH_HPP 1
+
+#include <cstring>
+
+#include "types.hpp"
+
+namespace BHF {
+
+// splitmix64 finalizer.
+inline u64
+hashMix(u64 value) noexcept
+{
+    value ^= value >> 30;
+    value *= 0xbf58476d1ce4e5b9ull;
+    value ^= value >> 27;
+    value *= 0x94d049bb133111ebull;
+    value ^= value >> 31;
+
+    return value;
+}
+
+// Non cryptographic 64 bit hash, eight bytes per step. Good enough to tell
+// whether a record changed between two versions of a help file, the value
+// depends on the host byte order.
+inline u64
+hash64(const void *data, usize size, u64 seed = 0) noexcept
+{
+    const u8 *bytes = static_cast<const u8 *>(data);
+    const u64 length = size;
+
+    u64 result = hashMix(seed ^ (length * 0x9e3779b97f4a7c15ull));
+
+    while (size >= sizeof(u64)) {
+        u64 word = 0;
+
+        std::memcpy(&word, bytes, sizeof(u64));
+
+        result = hashMix(result ^ word);
+
+        bytes += sizeof(u64);
+        size -= sizeof(u64);
+    }
+
+    if (size > 0) {
+        u64 word = 0;
+
+        std::memcpy(&word, bytes, size);
+
+        const u64 tail = size;
+
+        result = hashMix(result ^ word ^ (tail << 56));
+    }
+
+    return result;
+}
+
+inline u64
+hash64(std::string_view data, u64 seed = 0) noexcept
+{
+    return hash64(data.data(), data.size(), seed);
+}
+
+} // namespace BHF
+
+#endif // BHFCONVERTER_SRC_BHF_HASH_HPP
@@ -0,0 +1,215 @@
+// SPDX-License-Identifier: MIT
+// Copyright (c) 2022 Gustavo Ribeiro Croscato
+
+#include <cstring>
+
+#include "stream.hpp"
+
+namespace BHF {
+
+static constexpr usize kReadSize = 256 * 1024;
+
+struct RecordStreamData {
+    std::FILE *input = nullptr;
+
+    // Bytes [begin, end) of `buffer` are read but not consumed, `consumed`
+    // counts the bytes before `begin` since the start of the input.
+    std::vector<u8> buffer;
+    usize begin = 0;
+    usize end = 0;
+    usize consumed = 0;
+    bool eof = false;
+
+    bool opened = false;
+    File header;
+
+    std::string last_error;
+};
+
+// Makes `count` unconsumed bytes available, moving the unconsumed bytes to
+// the front of the buffer first. False when the input ends before.
+static bool
+RecordStream_Fill(RecordStreamData &data, usize count) noexcept
+{
+    if (data.end - data.begin >= count) {
+        return true;
+    }
+
+    if (data.begin > 0) {
+        std::memmove(data.buffer.data(), data.buffer.data() + data.begin, data.end - data.begin);
+
+        data.consumed += data.begin;
+        data.end -= data.begin;
+        data.begin = 0;
+    }
+
+    if (data.buffer.size() < count + kReadSize) {
+        data.buffer.resize(count + kReadSize);
+    }
+
+    while (data.end < count && !data.eof) {
+        usize bytes_read = std::fread(data.buffer.data() + data.end, 1, data.buffer.size() - data.end, data.input);
+
+        data.end += bytes_read;
+        data.eof = bytes_read == 0;
+    }
+
+    return data.end - data.begin >= count;
+}
+
+static RecordHeader
+RecordStream_PeekHeader(const RecordStreamData &data, usize position) noexcept
+{
+    RecordHeader header;
+
+    std::memcpy(&header, data.buffer.data() + data.begin + position, sizeof(header));
+
+    return header;
+}
+
+// Position after the next null terminated string starting at `position`.
+static bool
+RecordStream_SkipString(RecordStreamData &data, usize &position) noexcept
+{
+    for (;;) {
+        if (!RecordStream_Fill(data, position + 1)) {
+            return false;
+        }
+
+        const u8 *start = data.buffer.data() + data.begin + position;
+        const void *terminator = std::memchr(start, 0, data.end - data.begin - position);
+
+        if (terminator) {
+            position += static_cast<usize>(static_cast<const u8 *>(terminator) - start) + 1;
+
+            return true;
+        }
+
+        position = data.end - data.begin;
+    }
+}
+
+RecordStream::RecordStream(std::FILE *input) noexcept
+    : d{std::make_unique<RecordStreamData>()}
+{
+    d->input = input;
+}
+
+RecordStream::~RecordStream() noexcept = default;
+
+bool
+RecordStream::open() noexcept
+{
+    if (d->opened) {
+        return d->last_error.empty();
+    }
+
+    d->opened = true;
+
+    // [Stamp] 0x1a [Signature] [Version]
+    usize position = 0;
+
+    bool result = RecordStream_SkipString(*d, position)
+        && RecordStream_Fill(*d, position + 1)
+        && RecordStream_SkipString(*d, ++position)
+        && RecordStream_Fill(*d, position + sizeof(Version));
+
+    position += sizeof(Version);
+
+    // Records until the first Text record.
+    while (result) {
+        result = RecordStream_Fill(*d, position + sizeof(RecordHeader));
+
+        if (!result || RecordStream_PeekHeader(*d, position).type == RecordHeader::Text) {
+            break;
+        }
+
+        position += sizeof(RecordHeader) + RecordStream_PeekHeader(*d, position).length;
+    }
+
+    if (!result) {
+        d->last_error = "Unexpected end of file.";
+
+        return false;
+    }
+
+    std::vector<u8> header(d->buffer.begin() + static_cast<isize>(d->begin), d->buffer.begin() + static_cast<isize>(d->begin + position));
+
+    d->begin += position;
+
+    if (!d->header.open(std::move(header))) {
+        d->last_error = d->header.lastError();
+
+        return false;
+    }
+
+    return true;
+}
+
+const File &
+RecordStream::header() const noexcept
+{
+    return d->header;
+}
+
+bool
+RecordStream::next(Topic &topic) noexcept
+{
+    if (!open()) {
+        return false;
+    }
+
+    for (;;) {
+        if (!RecordStream_Fill(*d, sizeof(RecordHeader))) {
+            if (d->end != d->begin) {
+                d->last_error = "Unexpected end of file.";
+            }
+
+            return false;
+        }
+
+        RecordHeader record = RecordStream_PeekHeader(*d, 0);
+
+        usize size = sizeof(RecordHeader) + record.length;
+
+        if (!RecordStream_Fill(*d, size)) {
+            d->last_error = "Unexpected end of file.";
+
+            return false;
+        }
+
+        if (record.type != RecordHeader::Text) {
+            d->begin += size;
+
+            continue;
+        }
+
+        // The Keyword record follows its Text record.
+        if (RecordStream_Fill(*d, size + sizeof(RecordHeader)) && RecordStream_PeekHeader(*d, size).type == RecordHeader::Keyword) {
+            usize keyword_size = sizeof(RecordHeader) + RecordStream_PeekHeader(*d, size).length;
+
+            if (!RecordStream_Fill(*d, size + keyword_size)) {
+                d->last_error = "Unexpected end of file.";
+
+                return false;
+            }
+
+            size += keyword_size;
+        }
+
+        topic.offset = static_cast<File::ContextType>(d->consumed + d->begin);
+        topic.records = {reinterpret_cast<const char *>(d->buffer.data() + d->begin), size};
+
+        d->begin += size;
+
+        return true;
+    }
+}
+
+const std::string &
+RecordStream::lastError() const noexcept
+{
+    return d->last_error;
+}
+
+} // namespace BHF
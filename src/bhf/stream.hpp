@@ -0,0 +1,57 @@
+// SPDX-License-Identifier: MIT
+// Copyright (c) 2022 Gustavo Ribeiro Croscato
+
+#ifndef BHFCONVERTER_SRC_BHF_STREAM_HPP
+#define BHFCONVERTER_SRC_BHF_STREAM_HPP 1
+
+#include "file.hpp"
+
+namespace BHF {
+
+struct RecordStreamData;
+
+// Reads a help file front to back from a FILE* that can't seek, a pipe or
+// stdin. Everything before the first topic (headers, context table, index)
+// is parsed into header(); topics then come one at a time, in file order.
+//
+//   BHF::RecordStream stream(stdin);
+//   BHF::RecordStream::Topic topic;
+//
+//   while (stream.next(topic)) {
+//       std::string text = stream.header().formatTopic(topic.records);
+//   }
+//
+// Only the current topic and a read buffer are held in memory.
+class RecordStream
+{
+public:
+    struct Topic {
+        // Offset of the Text record, what the context table points to.
+        File::ContextType offset;
+
+        // Text and Keyword records, headers included, as File::topicData()
+        // returns them. Valid until the next call to next().
+        std::string_view records;
+    };
+
+    explicit RecordStream(std::FILE *input) noexcept;
+    ~RecordStream() noexcept;
+
+    // Reads and parses everything up to the first topic, next() calls it
+    // when needed.
+    bool open() noexcept;
+
+    const File &header() const noexcept;
+
+    // False at the end of the input or on error, lastError() tells which.
+    bool next(Topic &topic) noexcept;
+
+    const std::string &lastError() const noexcept;
+
+private:
+    std::unique_ptr<RecordStreamData> d;
+};
+
+} // namespace BHF
+
+#endif // BHFCONVERTER_SRC_BHF_STREAM_HPP
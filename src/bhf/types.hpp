@@ -21,6 +21,10 @@ struct Version {
     u8 text;
 };
 
+// FileHeader::options flag: index keys are mixed case and searches are case
+// sensitive. Without it the keys are stored in upper case.
+static constexpr u16 OF_CaseSense = 0x0004;
+
 struct FileHeader {
     u16 options;
     u16 main_index;
@@ -30,6 +34,13 @@ struct FileHeader {
     u8 left_margin;
 };
 
+struct FileHeaderTP2 {
+    u16 options;
+    u8 height;
+    u8 width;
+    u8 left_margin;
+};
+
 struct RecordHeader {
     enum Type : u8 {
           FileHeader
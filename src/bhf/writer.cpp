@@ -0,0 +1,632 @@
+// SPDX-License-Identifier: MIT
+// Copyright (c) 2022 Gustavo Ribeiro Croscato
+
+#include <atomic>
+#include <limits>
+#include <numeric>
+#include <thread>
+#include <unordered_map>
+
+#include "decoder.hpp"
+#include "format.hpp"
+#include "writer.hpp"
+
+namespace BHF {
+
+using NibbleCodec = Codec<Compression::Nibble>;
+
+// Topics handed to a thread at a time.
+static constexpr usize kTopicsPerChunk = 64;
+
+// Context offsets are stored in 24 bits, signed.
+static constexpr usize kMaximumOffset = 0x7fffff;
+
+struct WriterData {
+    std::string stamp;
+    std::string signature;
+    Version version{Version::Invalid, 0};
+    FileHeader file_header{0, 0, 0, 0, 0, 0};
+    File::ContextContainer context;
+    Writer::TopicContainer topics;
+    File::IndexContainer index;
+    File::IndexTagContainer index_tags;
+
+    Compression reference{Compression::Invalid, {0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0}};
+    Compression compression{Compression::Invalid, {0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0}};
+    std::vector<std::vector<u8>> compressed;
+    Writer::Statistics statistics{0, 0, 0, 0};
+
+    std::string last_error;
+};
+
+template<Version::Format F>
+struct Builder {
+    using Traits = FormatTraits<F>;
+
+    static bool build(WriterData &data, std::vector<u8> &buffer) noexcept;
+};
+
+// Runs work(worker, topic) for every topic, `jobs` threads taking chunks of
+// topics as they finish; worker is the thread number, below jobs.
+template<typename Function>
+static void
+Writer_ForEachTopic(usize count, unsigned jobs, Function work) noexcept
+{
+    usize chunk_count = (count + kTopicsPerChunk - 1) / kTopicsPerChunk;
+    std::atomic<usize> next = 0;
+
+    auto worker = [&](unsigned id) -> void {
+        for (usize chunk = next++; chunk < chunk_count; chunk = next++) {
+            usize end = std::min((chunk + 1) * kTopicsPerChunk, count);
+
+            for (usize topic = chunk * kTopicsPerChunk; topic < end; ++topic) {
+                work(id, topic);
+            }
+        }
+    };
+
+    std::vector<std::thread> threads;
+
+    for (unsigned i = 1; i < jobs && i < chunk_count; ++i) {
+        threads.emplace_back(worker, i);
+    }
+
+    worker(0);
+
+    for (std::thread &thread : threads) {
+        thread.join();
+    }
+}
+
+// Adds to gains[c] the nibbles saved in `text` by having c in the table.
+// Runs are split the way Codec<Nibble>::compress() splits them, so the
+// gains are exact and the best table is the 13 largest after NUL.
+static void
+Writer_CountGains(std::string_view text, std::array<u64, 256> &gains) noexcept
+{
+    for (usize i = 0; i < text.size();) {
+        usize run = 1;
+
+        while (i + run < text.size() && text[i + run] == text[i]) {
+            ++run;
+        }
+
+        u8 value = static_cast<u8>(text[i]);
+
+        i += run;
+
+        for (; run > 0; run -= std::min(run, NibbleCodec::kMaximumRun)) {
+            usize chunk = std::min(run, NibbleCodec::kMaximumRun);
+
+            gains[value] += NibbleCodec::runCost(chunk, 3) - NibbleCodec::runCost(chunk, 1);
+        }
+    }
+}
+
+// Converts UTF-8 as File returns index keys back to code page 437.
+static bool
+Writer_EncodeCP437(std::string_view text, std::string &result) noexcept
+{
+    static const std::unordered_map<std::string_view, u8> kUTF8toCP437 = [] {
+        std::unordered_map<std::string_view, u8> table;
+
+        // 0 is not a character, its entry is a placeholder.
+        for (usize i = 1; i < kCP437toUTF8.size(); ++i) {
+            table.emplace(kCP437toUTF8[i], static_cast<u8>(i));
+        }
+
+        return table;
+    }();
+
+    result.clear();
+
+    for (usize i = 0; i < text.size();) {
+        u8 lead = static_cast<u8>(text[i]);
+        usize length = lead < 0x80 ? 1 : lead < 0xe0 ? 2 : lead < 0xf0 ? 3 : 4;
+
+        auto found = kUTF8toCP437.find(text.substr(i, length));
+
+        if (found == kUTF8toCP437.end()) {
+            return false;
+        }
+
+        result += static_cast<char>(found->second);
+        i += length;
+    }
+
+    return true;
+}
+
+template<typename T>
+static void
+Writer_Append(std::vector<u8> &buffer, const T &value) noexcept
+{
+    const u8 *bytes = reinterpret_cast<const u8 *>(&value);
+
+    buffer.insert(buffer.end(), bytes, bytes + sizeof(T));
+}
+
+static void
+Writer_AppendString(std::vector<u8> &buffer, std::string_view text) noexcept
+{
+    buffer.insert(buffer.end(), text.begin(), text.end());
+    buffer.push_back(0);
+}
+
+// Appends a record header, EndRecord() fills its length.
+static usize
+Writer_BeginRecord(std::vector<u8> &buffer, RecordHeader::Type type) noexcept
+{
+    usize position = buffer.size();
+
+    Writer_Append(buffer, RecordHeader{type, 0});
+
+    return position;
+}
+
+static bool
+Writer_EndRecord(std::vector<u8> &buffer, usize position) noexcept
+{
+    usize length = buffer.size() - position - sizeof(RecordHeader);
+
+    if (length > 0xffff) {
+        return false;
+    }
+
+    u16 value = static_cast<u16>(length);
+
+    std::memcpy(buffer.data() + position + offsetof(RecordHeader, length), &value, sizeof(value));
+
+    return true;
+}
+
+Writer::Writer() noexcept
+    : d{std::make_unique<WriterData>()}
+{}
+
+Writer::~Writer() noexcept = default;
+
+bool
+Writer::load(const File &file) noexcept
+{
+    d = std::make_unique<WriterData>();
+
+    if (file.compression().type != Compression::Nibble) {
+        d->last_error = fmt::format("Unsupported compression type {}.", static_cast<u32>(file.compression().type));
+
+        return false;
+    }
+
+    d->stamp = file.stamp();
+    d->signature = file.signature();
+    d->version = file.version();
+    d->file_header = file.fileHeader();
+    d->index = file.index();
+    d->index_tags = file.indexTags();
+    d->reference = file.compression();
+
+    const File::ContextContainer &contexts = file.context();
+
+    File::ContextContainer offsets;
+    offsets.reserve(contexts.size());
+
+    // One topic per offset, aliases point to a topic already taken.
+    for (usize c = 0; c < contexts.size(); ++c) {
+        if (contexts[c] >= 0 && !file.isAlias(static_cast<File::ContextType>(c))) {
+            offsets.push_back(contexts[c]);
+        }
+    }
+
+    std::sort(offsets.begin(), offsets.end());
+
+    d->topics.resize(offsets.size());
+
+    for (usize t = 0; t < offsets.size(); ++t) {
+        std::string_view records = file.topicData(offsets[t]);
+
+        if (records.empty()) {
+            d->last_error = fmt::format("No topic at offset {}.", offsets[t]);
+
+            return false;
+        }
+
+        ByteStream stream(reinterpret_cast<const u8 *>(records.data()), records.size());
+
+        RecordHeader record = stream.read<RecordHeader>();
+        const u8 *compressed = stream.skip(record.length);
+
+        NibbleCodec::expand(compressed, record.length, d->reference, d->topics[t].text);
+
+        if (!file.topicKeywords(records, d->topics[t].keywords)) {
+            d->last_error = fmt::format("Damaged links of the topic at offset {}.", offsets[t]);
+
+            return false;
+        }
+    }
+
+    d->context.reserve(contexts.size());
+
+    for (File::ContextType offset : contexts) {
+        if (offset < 0) {
+            d->context.push_back(offset);
+        } else {
+            auto topic = std::lower_bound(offsets.begin(), offsets.end(), offset);
+
+            d->context.push_back(static_cast<File::ContextType>(topic - offsets.begin()));
+        }
+    }
+
+    return true;
+}
+
+std::string &
+Writer::stamp() noexcept
+{
+    return d->stamp;
+}
+
+std::string &
+Writer::signature() noexcept
+{
+    return d->signature;
+}
+
+Version &
+Writer::version() noexcept
+{
+    return d->version;
+}
+
+FileHeader &
+Writer::fileHeader() noexcept
+{
+    return d->file_header;
+}
+
+File::ContextContainer &
+Writer::context() noexcept
+{
+    return d->context;
+}
+
+Writer::TopicContainer &
+Writer::topics() noexcept
+{
+    return d->topics;
+}
+
+File::IndexContainer &
+Writer::index() noexcept
+{
+    return d->index;
+}
+
+File::IndexTagContainer &
+Writer::indexTags() noexcept
+{
+    return d->index_tags;
+}
+
+bool
+Writer::write(std::vector<u8> &buffer, unsigned jobs) noexcept
+{
+    d->last_error.clear();
+
+    jobs = std::max(jobs, 1u);
+
+    const usize count = d->topics.size();
+
+    // [Table] entry 0 is always NUL (doc/borland_help_file_format.txt, 4.f),
+    // the others are the characters saving the most nibbles.
+    std::vector<std::array<u64, 256>> gains(jobs);
+
+    for (std::array<u64, 256> &worker_gains : gains) {
+        worker_gains.fill(0);
+    }
+
+    Writer_ForEachTopic(count, jobs, [this, &gains](unsigned worker, usize topic) {
+        Writer_CountGains(d->topics[topic].text, gains[worker]);
+    });
+
+    for (unsigned worker = 1; worker < jobs; ++worker) {
+        for (usize c = 0; c < 256; ++c) {
+            gains[0][c] += gains[worker][c];
+        }
+    }
+
+    gains[0][0] = std::numeric_limits<u64>::max();
+
+    std::array<u8, 256> order;
+    std::iota(order.begin(), order.end(), u8{0});
+
+    std::stable_sort(order.begin(), order.end(), [&gains](u8 a, u8 b) {
+        return gains[0][a] > gains[0][b];
+    });
+
+    d->compression.type = Compression::Nibble;
+    std::copy_n(order.begin(), sizeof(d->compression.table), d->compression.table);
+
+    // [Compression]
+    const bool has_reference = d->reference.type == Compression::Nibble;
+
+    std::vector<std::vector<u8>> scratch(has_reference ? jobs : 0);
+    std::vector<usize> reference_sizes(has_reference ? count : 0);
+
+    d->compressed.resize(count);
+
+    Writer_ForEachTopic(count, jobs, [this, has_reference, &scratch, &reference_sizes](unsigned worker, usize topic) {
+        NibbleCodec::compress(d->topics[topic].text, d->compression, d->compressed[topic]);
+
+        if (has_reference) {
+            NibbleCodec::compress(d->topics[topic].text, d->reference, scratch[worker]);
+
+            reference_sizes[topic] = scratch[worker].size();
+        }
+    });
+
+    d->statistics = {0, 0, 0, 0};
+
+    for (usize t = 0; t < count; ++t) {
+        d->statistics.text_size += d->topics[t].text.size();
+        d->statistics.compressed_size += d->compressed[t].size();
+    }
+
+    d->statistics.reference_size = std::accumulate(reference_sizes.begin(), reference_sizes.end(), usize{0});
+
+    bool built = false;
+
+    switch (d->version.format) {
+        case Version::TP2     : built = Builder<Version::TP2>::build(*d, buffer); break;
+        case Version::TP4     : built = Builder<Version::TP4>::build(*d, buffer); break;
+        case Version::TP6     : built = Builder<Version::TP6>::build(*d, buffer); break;
+        case Version::BP7     : built = Builder<Version::BP7>::build(*d, buffer); break;
+        case Version::Invalid : break;
+    }
+
+    if (!built && d->last_error.empty()) {
+        d->last_error = fmt::format("Unsupported format version {:#04x}.", static_cast<u32>(d->version.format));
+    }
+
+    d->compressed.clear();
+    d->statistics.file_size = built ? buffer.size() : 0;
+
+    return built;
+}
+
+bool
+Writer::write(std::string_view filepath, unsigned jobs) noexcept
+{
+    std::vector<u8> buffer;
+
+    if (!write(buffer, jobs)) {
+        return false;
+    }
+
+    FILE *file = fopen(std::string(filepath).c_str(), "wb");
+
+    if (!file) {
+        d->last_error = fmt::format("Can't open file '{}'.", filepath);
+
+        return false;
+    }
+
+    bool written = fwrite(buffer.data(), 1, buffer.size(), file) == buffer.size();
+
+    written = fclose(file) == 0 && written;
+
+    if (!written) {
+        d->last_error = fmt::format("Error writing file '{}'.", filepath);
+    }
+
+    return written;
+}
+
+const Compression &
+Writer::compression() const noexcept
+{
+    return d->compression;
+}
+
+const Writer::Statistics &
+Writer::statistics() const noexcept
+{
+    return d->statistics;
+}
+
+const std::string &
+Writer::lastError() const noexcept
+{
+    return d->last_error;
+}
+
+template<Version::Format F>
+bool
+Builder<F>::build(WriterData &data, std::vector<u8> &buffer) noexcept
+{
+    buffer.clear();
+
+    // [Stamp]
+    Writer_AppendString(buffer, data.stamp);
+    buffer.push_back(0x1a);
+
+    // [Signature]
+    Writer_AppendString(buffer, data.signature);
+
+    // [Version]
+    Writer_Append(buffer, data.version);
+
+    // [File header] the IDE sizes its text buffer with largest_record, the
+    // uncompressed size is the safe bound.
+    FileHeader file_header = data.file_header;
+    usize largest_record = 0;
+
+    for (const Writer::Topic &topic : data.topics) {
+        largest_record = std::max(largest_record, topic.text.size());
+    }
+
+    file_header.largest_record = static_cast<u16>(std::min<usize>(largest_record, 0xffff));
+
+    usize record = Writer_BeginRecord(buffer, RecordHeader::FileHeader);
+    Writer_Append(buffer, Traits::fileHeaderRecord(file_header));
+    Writer_EndRecord(buffer, record);
+
+    // [Compression]
+    record = Writer_BeginRecord(buffer, RecordHeader::Compression);
+    Writer_Append(buffer, data.compression);
+    Writer_EndRecord(buffer, record);
+
+    // [Context] the offsets are filled once the topics are placed.
+    record = Writer_BeginRecord(buffer, RecordHeader::Context);
+    Writer_Append(buffer, static_cast<u16>(data.context.size()));
+
+    usize context_table = buffer.size();
+
+    buffer.resize(buffer.size() + data.context.size() * 3);
+
+    if (data.context.size() > 0xffff || !Writer_EndRecord(buffer, record)) {
+        data.last_error = fmt::format("Too many contexts, {}.", data.context.size());
+
+        return false;
+    }
+
+    // [Index] keys share their first characters with the previous key. File
+    // counts them in UTF-8 bytes, so only ASCII is shared.
+    if (data.index.size() > 0xffff) {
+        data.last_error = fmt::format("Too many index keys, {}.", data.index.size());
+
+        return false;
+    }
+
+    record = Writer_BeginRecord(buffer, RecordHeader::Index);
+    Writer_Append(buffer, static_cast<u16>(data.index.size()));
+
+    std::string previous_key;
+    std::string key;
+
+    for (const File::IndexType &index : data.index) {
+        if (!Writer_EncodeCP437(index.index, key)) {
+            data.last_error = fmt::format("Index key '{}' is not in code page 437.", index.index);
+
+            return false;
+        }
+
+        usize carry = 0;
+
+        while (carry < 7 && carry < key.size() && carry < previous_key.size()
+            && key[carry] == previous_key[carry] && static_cast<u8>(key[carry]) < 0x80) {
+            ++carry;
+        }
+
+        usize length = key.size() - carry;
+
+        if (length > 0x1f) {
+            data.last_error = fmt::format("Index key '{}' is too long.", index.index);
+
+            return false;
+        }
+
+        buffer.push_back(static_cast<u8>((carry << 5u) | length));
+        buffer.insert(buffer.end(), key.begin() + static_cast<std::string::difference_type>(carry), key.end());
+        Writer_Append(buffer, static_cast<u16>(index.context));
+
+        previous_key = key;
+    }
+
+    if (!Writer_EndRecord(buffer, record)) {
+        data.last_error = "Index record too large.";
+
+        return false;
+    }
+
+    // [Index tags]
+    if (!data.index_tags.empty()) {
+        if constexpr (Traits::kHasIndexTags) {
+            record = Writer_BeginRecord(buffer, RecordHeader::IndexTags);
+
+            for (const File::IndexTagType &tag : data.index_tags) {
+                if (!Writer_EncodeCP437(tag.tag, key) || key.size() > 0xff) {
+                    data.last_error = fmt::format("Invalid index tag '{}'.", tag.tag);
+
+                    return false;
+                }
+
+                Writer_Append(buffer, tag.index);
+                buffer.push_back(static_cast<u8>(key.size()));
+                Writer_AppendString(buffer, key);
+            }
+
+            if (!Writer_EndRecord(buffer, record)) {
+                data.last_error = "Index tags record too large.";
+
+                return false;
+            }
+        } else {
+            data.last_error = "Index tags are not supported by this format version.";
+
+            return false;
+        }
+    }
+
+    // [Topics]
+    std::vector<usize> offsets(data.topics.size());
+
+    for (usize t = 0; t < data.topics.size(); ++t) {
+        offsets[t] = buffer.size();
+
+        if (offsets[t] > kMaximumOffset) {
+            data.last_error = "Help file too large, topics past 8 MiB can't be addressed.";
+
+            return false;
+        }
+
+        record = Writer_BeginRecord(buffer, RecordHeader::Text);
+        buffer.insert(buffer.end(), data.compressed[t].begin(), data.compressed[t].end());
+
+        if (!Writer_EndRecord(buffer, record)) {
+            data.last_error = fmt::format("Topic {} too large, {} bytes compressed.", t, data.compressed[t].size());
+
+            return false;
+        }
+
+        const File::KeywordType &keywords = data.topics[t].keywords;
+
+        record = Writer_BeginRecord(buffer, RecordHeader::Keyword);
+        Writer_Append(buffer, Keyword{static_cast<u16>(keywords.up), static_cast<u16>(keywords.down), static_cast<u16>(keywords.contexts.size())});
+
+        for (File::ContextType context : keywords.contexts) {
+            Writer_Append(buffer, static_cast<u16>(context));
+        }
+
+        if (keywords.contexts.size() > 0xffff || !Writer_EndRecord(buffer, record)) {
+            data.last_error = fmt::format("Topic {} has too many keywords.", t);
+
+            return false;
+        }
+    }
+
+    // [Context] 24 bits signed integers.
+    for (usize c = 0; c < data.context.size(); ++c) {
+        File::ContextType topic = data.context[c];
+        i32 offset = topic;
+
+        if (topic >= 0) {
+            if (static_cast<usize>(topic) >= offsets.size()) {
+                data.last_error = fmt::format("Context {} points to topic {}, there are {}.", c, topic, offsets.size());
+
+                return false;
+            }
+
+            offset = static_cast<i32>(offsets[static_cast<usize>(topic)]);
+        }
+
+        u8 *bytes = buffer.data() + context_table + c * 3;
+
+        bytes[0] = static_cast<u8>(offset & 0xff);
+        bytes[1] = static_cast<u8>((offset >> 8) & 0xff);
+        bytes[2] = static_cast<u8>((offset >> 16) & 0xff);
+    }
+
+    return true;
+}
+
+} // namespace BHF
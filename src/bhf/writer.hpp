@@ -0,0 +1,85 @@
+// SPDX-License-Identifier: MIT
+// Copyright (c) 2022 Gustavo Ribeiro Croscato
+
+#ifndef BHFCONVERTER_SRC_BHF_WRITER_HPP
+#define BHFCONVERTER_SRC_BHF_WRITER_HPP 1
+
+#include "file.hpp"
+
+namespace BHF {
+
+struct WriterData;
+
+// Builds a help file from its topics, index and keywords, usually after
+// load() from an existing one:
+//
+//   BHF::Writer writer;
+//
+//   writer.load(file);
+//   writer.topics()[0].text += "See also the manual.";
+//   writer.write("patched.tch", jobs);
+//
+// The compression table is chosen from the characters of all topics to
+// store as few of them as possible as CharRaw, entry 0 is always NUL.
+class Writer
+{
+public:
+    struct Topic {
+        // Text as stored in the file, CP437 with control codes and without
+        // the reflow of File::text(), what Codec<Nibble>::expand() returns.
+        std::string text;
+        File::KeywordType keywords;
+    };
+
+    using TopicContainer = std::vector<Topic>;
+
+    // Sizes in bytes of the last write().
+    struct Statistics {
+        // Topics before compression.
+        usize text_size;
+
+        // Text records with the chosen table.
+        usize compressed_size;
+
+        // Text records with the table of the loaded file, 0 without one.
+        usize reference_size;
+
+        usize file_size;
+    };
+
+    Writer() noexcept;
+    ~Writer() noexcept;
+
+    // Takes everything from `file`, one topic per distinct context offset in
+    // file order. The table of `file` becomes the statistics reference.
+    bool load(const File &file) noexcept;
+
+    std::string &stamp() noexcept;
+    std::string &signature() noexcept;
+    Version &version() noexcept;
+    FileHeader &fileHeader() noexcept;
+
+    // Topic number of every context, negative values are written as they
+    // are. Keywords link to contexts, not to topics.
+    File::ContextContainer &context() noexcept;
+    TopicContainer &topics() noexcept;
+    File::IndexContainer &index() noexcept;
+    File::IndexTagContainer &indexTags() noexcept;
+
+    // Compresses the topics `jobs` threads at a time and builds the file.
+    bool write(std::vector<u8> &buffer, unsigned jobs = 1) noexcept;
+    bool write(std::string_view filepath, unsigned jobs = 1) noexcept;
+
+    // Table chosen by the last write().
+    const Compression &compression() const noexcept;
+    const Statistics &statistics() const noexcept;
+
+    const std::string &lastError() const noexcept;
+
+private:
+    std::unique_ptr<WriterData> d;
+};
+
+} // namespace BHF
+
+#endif // BHFCONVERTER_SRC_BHF_WRITER_HPP
@@ -0,0 +1,140 @@
+// SPDX-License-Identifier: MIT
+// Copyright (c) 2022 Gustavo Ribeiro Croscato
+
+#include <algorithm>
+#include <charconv>
+#include <thread>
+
+#include "arguments.hpp"
+
+namespace CLI {
+
+// More threads than this only add scratch buffers and contention.
+static constexpr unsigned kMaximumJobs = 256;
+
+struct ArgumentsData {
+    std::vector<std::pair<std::string_view, std::string_view>> values;
+    std::vector<std::string_view> positional;
+
+    // --jobs, 0 when not given.
+    unsigned jobs = 0;
+
+    std::string last_error;
+};
+
+Arguments::Arguments() noexcept
+    : d{std::make_unique<ArgumentsData>()}
+{}
+
+Arguments::~Arguments() noexcept = default;
+
+bool
+Arguments::parse(int argc, char *argv[], std::initializer_list<Option> options) noexcept
+{
+    d->values.clear();
+    d->positional.clear();
+    d->jobs = 0;
+
+    for (int i = 0; i < argc; ++i) {
+        std::string_view argument = argv[i];
+
+        if (argument.size() < 2 || argument.substr(0, 2) != "--") {
+            d->positional.push_back(argument);
+
+            continue;
+        }
+
+        const Option *option = nullptr;
+
+        for (const Option &candidate : options) {
+            if (candidate.name == argument) {
+                option = &candidate;
+
+                break;
+            }
+        }
+
+        if (!option) {
+            d->last_error = fmt::format("Unknown option '{}'.", argument);
+
+            return false;
+        }
+
+        if (!option->has_value) {
+            d->values.emplace_back(option->name, std::string_view{});
+
+            continue;
+        }
+
+        if (i + 1 >= argc) {
+            d->last_error = fmt::format("Option '{}' requires a value.", argument);
+
+            return false;
+        }
+
+        d->values.emplace_back(option->name, argv[++i]);
+    }
+
+    if (has("--jobs")) {
+        std::string_view jobs = value("--jobs");
+
+        auto [end, error] = std::from_chars(jobs.data(), jobs.data() + jobs.size(), d->jobs);
+
+        if (error != std::errc{} || end != jobs.data() + jobs.size() || d->jobs == 0 || d->jobs > kMaximumJobs) {
+            d->last_error = fmt::format("Invalid value '{}' for --jobs, expected 1 to {}.", jobs, kMaximumJobs);
+            d->jobs = 0;
+
+            return false;
+        }
+    }
+
+    return true;
+}
+
+bool
+Arguments::has(std::string_view name) const noexcept
+{
+    for (const auto &[key, value] : d->values) {
+        if (key == name) {
+            return true;
+        }
+    }
+
+    return false;
+}
+
+std::string_view
+Arguments::value(std::string_view name, std::string_view fallback) const noexcept
+{
+    for (const auto &[key, value] : d->values) {
+        if (key == name) {
+            return value;
+        }
+    }
+
+    return fallback;
+}
+
+unsigned
+Arguments::jobs() const noexcept
+{
+    if (d->jobs > 0) {
+        return d->jobs;
+    }
+
+    return std::clamp(std::thread::hardware_concurrency(), 1u, kMaximumJobs);
+}
+
+const std::vector<std::string_view> &
+Arguments::positional() const noexcept
+{
+    return d->positional;
+}
+
+const std::string &
+Arguments::lastError() const noexcept
+{
+    return d->last_error;
+}
+
+} // namespace CLI
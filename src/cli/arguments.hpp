@@ -0,0 +1,42 @@
+// SPDX-License-Identifier: MIT
+// Copyright (c) 2022 Gustavo Ribeiro Croscato
+
+#ifndef BHFCONVERTER_SRC_CLI_ARGUMENTS_HPP
+#define BHFCONVERTER_SRC_CLI_ARGUMENTS_HPP 1
+
+#include <initializer_list>
+
+namespace CLI {
+
+struct ArgumentsData;
+
+class Arguments
+{
+public:
+    struct Option {
+        std::string_view name;
+        bool has_value;
+    };
+
+    Arguments() noexcept;
+    ~Arguments() noexcept;
+
+    bool parse(int argc, char *argv[], std::initializer_list<Option> options) noexcept;
+
+    bool has(std::string_view name) const noexcept;
+    std::string_view value(std::string_view name, std::string_view fallback = {}) const noexcept;
+
+    // --jobs, checked by parse(), or the hardware threads when not given.
+    unsigned jobs() const noexcept;
+
+    const std::vector<std::string_view> &positional() const noexcept;
+
+    const std::string &lastError() const noexcept;
+
+private:
+    std::unique_ptr<ArgumentsData> d;
+};
+
+} // namespace CLI
+
+#endif // BHFCONVERTER_SRC_CLI_ARGUMENTS_HPP
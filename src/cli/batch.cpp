@@ -0,0 +1,236 @@
+// SPDX-License-Identifier: MIT
+// Copyright (c) 2022 Gustavo Ribeiro Croscato
+
+#include <algorithm>
+#include <filesystem>
+
+#include "batch.hpp"
+#include "pipeline.hpp"
+#include "reader.hpp"
+#include "export/html.hpp"
+#include "export/sqlite.hpp"
+
+namespace CLI {
+
+// A file is held in memory along with its decoded topics and the output of
+// the threads working on it, the budget is charged this many times its size.
+static constexpr usize kMemoryPerFileByte = 4;
+
+static constexpr std::array<std::string_view, 3> kHelpFileExtensions = {".tch", ".tph", ".hlp"};
+
+struct BatchJob {
+    std::filesystem::path input;
+    std::filesystem::path output;
+    std::string error;
+    double seconds = 0.0;
+};
+
+static bool
+Batch_IsHelpFile(const std::filesystem::path &path) noexcept
+{
+    std::string extension = path.extension().string();
+
+    std::transform(extension.begin(), extension.end(), extension.begin(), [](char c) -> char {
+        return (c >= 'A' && c <= 'Z') ? static_cast<char>(c - 'A' + 'a') : c;
+    });
+
+    return std::find(kHelpFileExtensions.begin(), kHelpFileExtensions.end(), extension) != kHelpFileExtensions.end();
+}
+
+// Directories are not searched recursively, their help files are taken in
+// name order.
+static void
+Batch_CollectInputs(const std::vector<std::string_view> &inputs, std::vector<BatchJob> &jobs) noexcept
+{
+    for (std::string_view input : inputs) {
+        std::filesystem::path path(input);
+        std::error_code code;
+
+        if (!std::filesystem::is_directory(path, code)) {
+            jobs.push_back({path, {}, {}, 0.0});
+
+            continue;
+        }
+
+        std::vector<std::filesystem::path> files;
+
+        for (std::filesystem::directory_iterator it(path, code), end; !code && it != end; it.increment(code)) {
+            if (it->is_regular_file(code) && Batch_IsHelpFile(it->path())) {
+                files.push_back(it->path());
+            }
+        }
+
+        if (code) {
+            jobs.push_back({path, {}, fmt::format("Error reading directory: {}.", code.message()), 0.0});
+
+            continue;
+        }
+
+        std::sort(files.begin(), files.end());
+
+        for (std::filesystem::path &file : files) {
+            jobs.push_back({std::move(file), {}, {}, 0.0});
+        }
+    }
+}
+
+// Output named after the input file, files with the same name from
+// different directories get a numeric suffix.
+static void
+Batch_AssignOutputs(std::vector<BatchJob> &jobs, const BatchOptions &options) noexcept
+{
+    std::vector<std::string> names;
+
+    for (BatchJob &job : jobs) {
+        std::string stem = job.input.stem().string();
+        std::string name = stem;
+
+        for (usize n = 2; std::find(names.begin(), names.end(), name) != names.end(); ++n) {
+            name = fmt::format("{}-{}", stem, n);
+        }
+
+        names.push_back(name);
+
+        if (options.target == BatchOptions::SQLite) {
+            name += ".db";
+        }
+
+        job.output = std::filesystem::path(options.output) / name;
+    }
+}
+
+// Converts into a staging path next to the output and renames it over the
+// output once done, so a failed or timed out conversion leaves no partial
+// output behind and the previous one, if any, untouched.
+static void
+Batch_Convert(BatchJob &job, std::vector<u8> &&data, const BatchOptions &options) noexcept
+{
+    Deadline::Clock::time_point start = Deadline::Clock::now();
+    Deadline deadline;
+
+    if (options.timeout.count() > 0) {
+        deadline = Deadline::after(options.timeout);
+    }
+
+    std::filesystem::path staging = job.output;
+    staging += ".partial";
+
+    std::error_code code;
+
+    std::filesystem::remove_all(staging, code);
+
+    {
+        BHF::File file;
+
+        if (!file.open(std::move(data))) {
+            job.error = file.lastError();
+        } else if (options.target == BatchOptions::HTML) {
+            Export::html(file, staging.string(), 1, job.error, deadline);
+        } else {
+#if defined(USING_SQLITE3)
+            Export::sqlite(file, staging.string(), 1, job.error, deadline);
+#else
+            job.error = "SQLite3 support is not available in this build.";
+#endif
+        }
+    }
+
+    if (job.error.empty()) {
+        std::filesystem::remove_all(job.output, code);
+
+        if (!code) {
+            std::filesystem::rename(staging, job.output, code);
+        }
+
+        if (code) {
+            job.error = fmt::format("Error replacing {}: {}.", job.output.string(), code.message());
+        }
+    }
+
+    if (!job.error.empty()) {
+        std::filesystem::remove_all(staging, code);
+    }
+
+    job.seconds = std::chrono::duration<double>(Deadline::Clock::now() - start).count();
+}
+
+usize
+batch(const std::vector<std::string_view> &inputs, const BatchOptions &options) noexcept
+{
+    std::vector<BatchJob> jobs;
+
+    Batch_CollectInputs(inputs, jobs);
+    Batch_AssignOutputs(jobs, options);
+
+    std::error_code code;
+
+    std::filesystem::create_directories(std::filesystem::path(options.output), code);
+
+    if (code) {
+        fmt::print(stderr, "Error creating directory {}: {}.\n", options.output, code.message());
+
+        return jobs.size();
+    }
+
+    MemoryBudget budget;
+    budget.limit = options.memory_budget;
+    budget.scale = kMemoryPerFileByte;
+
+    // Files that failed to be listed already carry their error.
+    std::vector<usize> readable;
+    std::vector<std::string> paths;
+
+    for (usize i = 0; i < jobs.size(); ++i) {
+        if (jobs[i].error.empty()) {
+            readable.push_back(i);
+            paths.push_back(jobs[i].input.string());
+        }
+    }
+
+    FileReader reader;
+    reader.start(std::move(paths), options.reads_in_flight, &budget);
+
+    // Each call converts whichever file finished reading first.
+    auto convert = [&](unsigned worker, usize i) -> bool {
+        UNUSED(worker);
+        UNUSED(i);
+
+        FileReader::Result result;
+
+        if (!reader.next(result)) {
+            return false;
+        }
+
+        BatchJob &job = jobs[readable[result.id]];
+
+        if (!result.error.empty()) {
+            job.error = std::move(result.error);
+        } else {
+            Batch_Convert(job, std::move(result.data), options);
+        }
+
+        budget.release(result.charge);
+
+        return true;
+    };
+
+    parallelFor(readable.size(), options.jobs, convert);
+
+    usize failed = 0;
+
+    for (const BatchJob &job : jobs) {
+        if (job.error.empty()) {
+            fmt::print("ok     {} -> {} ({:.2f}s)\n", job.input.string(), job.output.string(), job.seconds);
+        } else {
+            fmt::print("failed {}: {}\n", job.input.string(), job.error);
+
+            ++failed;
+        }
+    }
+
+    fmt::print("{} files, {} failed, read with {}\n", jobs.size(), failed, reader.backend());
+
+    return failed;
+}
+
+} // namespace CLI
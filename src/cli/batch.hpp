@@ -0,0 +1,42 @@
+// SPDX-License-Identifier: MIT
+// Copyright (c) 2022 Gustavo Ribeiro Croscato
+
+#ifndef BHFCONVERTER_SRC_CLI_BATCH_HPP
+#define BHFCONVERTER_SRC_CLI_BATCH_HPP 1
+
+#include <chrono>
+
+namespace CLI {
+
+struct BatchOptions {
+    enum Target {
+          HTML
+        , SQLite
+    };
+
+    Target target = HTML;
+    std::string_view output;
+    unsigned jobs = 1;
+
+    // Files read ahead of the conversions.
+    unsigned reads_in_flight = 16;
+
+    // Estimated bytes of all the files in memory at the same time, read
+    // ahead or being converted, 0 means no limit. Reading waits for room,
+    // a file over the budget still runs, alone.
+    usize memory_budget = 0;
+
+    // Per file limit, 0 means no limit.
+    std::chrono::milliseconds timeout{0};
+};
+
+// Converts every help file of `inputs`, files or directories of help files,
+// into `options.output`: a directory per file for HTML, a database per file
+// for SQLite. Files are converted concurrently and a failure only affects
+// its own file. Prints one line per file and returns the number of files
+// that failed.
+usize batch(const std::vector<std::string_view> &inputs, const BatchOptions &options) noexcept;
+
+} // namespace CLI
+
+#endif // BHFCONVERTER_SRC_CLI_BATCH_HPP
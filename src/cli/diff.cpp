@@ -0,0 +1,547 @@
+// SPDX-License-Identifier: MIT
+// Copyright (c) 2022 Gustavo Ribeiro Croscato
+
+#include <algorithm>
+#include <unordered_map>
+
+#include "bhf/hash.hpp"
+#include "diff.hpp"
+#include "pipeline.hpp"
+
+namespace CLI {
+
+static constexpr u64 kDiffSeed = 0x6469666600000001ull;
+
+// Edit distance past which Myers gives up and a topic is shown as all its
+// lines removed and all the new ones added. Bounds the trace at about
+// kMaximumEdits² entries per thread.
+static constexpr usize kMaximumEdits = 2048;
+
+static constexpr usize kNoMatch = static_cast<usize>(-1);
+
+struct DiffTopic {
+    BHF::File::ContextType offset;
+
+    // Lowest context pointing to the topic, the one printed.
+    BHF::File::ContextType context;
+
+    // Of the plain text, and of the topics the links go to once matched.
+    u64 hash = 0;
+    u64 links = 0;
+
+    // Its records could not be decoded, it is compared as an empty topic.
+    bool damaged = false;
+
+    BHF::File::KeywordType keywords;
+    std::vector<std::string_view> keys;
+    usize match = kNoMatch;
+};
+
+struct DiffLine {
+    enum Operation : u8 {
+          Equal
+        , Delete
+        , Insert
+    };
+
+    Operation operation;
+    u32 before;
+    u32 after;
+};
+
+// Topic at `offset`, topics are sorted by offset.
+static usize
+Diff_Find(const std::vector<DiffTopic> &topics, BHF::File::ContextType offset) noexcept
+{
+    auto topic = std::lower_bound(topics.begin(), topics.end(), offset, [](const DiffTopic &a, BHF::File::ContextType value) {
+        return a.offset < value;
+    });
+
+    return topic != topics.end() && topic->offset == offset ? static_cast<usize>(topic - topics.begin()) : kNoMatch;
+}
+
+// One topic per distinct context offset, with its index keys, its links and
+// the hash of its plain text, decoded `jobs` topics at a time.
+static std::vector<DiffTopic>
+Diff_Topics(const BHF::File &file, unsigned jobs) noexcept
+{
+    const BHF::File::ContextContainer &contexts = file.context();
+
+    std::vector<DiffTopic> topics;
+
+    // Aliases share the topic of a lower numbered context, which stays.
+    for (usize c = 0; c < contexts.size(); ++c) {
+        if (contexts[c] >= 0 && !file.isAlias(static_cast<BHF::File::ContextType>(c))) {
+            topics.push_back({contexts[c], static_cast<BHF::File::ContextType>(c), 0, 0, false, {}, {}, kNoMatch});
+        }
+    }
+
+    std::sort(topics.begin(), topics.end(), [](const DiffTopic &a, const DiffTopic &b) {
+        return a.offset < b.offset;
+    });
+
+    for (const BHF::File::IndexType &index : file.index()) {
+        if (index.context < 0 || static_cast<usize>(index.context) >= contexts.size()) {
+            continue;
+        }
+
+        usize topic = Diff_Find(topics, contexts[static_cast<usize>(index.context)]);
+
+        if (topic != kNoMatch) {
+            topics[topic].keys.push_back(index.index);
+        }
+    }
+
+    parallelFor(topics.size(), jobs, [&file, &topics](unsigned, usize topic) {
+        std::string text;
+        std::string scratch;
+
+        bool decoded = file.text(topics[topic].offset, BHF::File::PlainText, text, scratch);
+        decoded = file.keywords(topics[topic].offset, topics[topic].keywords) && decoded;
+
+        topics[topic].hash = BHF::hash64(text, kDiffSeed);
+        topics[topic].damaged = !decoded;
+
+        std::sort(topics[topic].keys.begin(), topics[topic].keys.end());
+
+        return true;
+    });
+
+    return topics;
+}
+
+static bool
+Diff_ShareKey(const DiffTopic &a, const DiffTopic &b) noexcept
+{
+    for (std::string_view key : a.keys) {
+        if (std::binary_search(b.keys.begin(), b.keys.end(), key)) {
+            return true;
+        }
+    }
+
+    return false;
+}
+
+static void
+Diff_Pair(std::vector<DiffTopic> &before, usize b, std::vector<DiffTopic> &after, usize a) noexcept
+{
+    before[b].match = a;
+    after[a].match = b;
+}
+
+// Pairs the topics of both versions: same text, preferring a pair sharing
+// a key when the text is repeated, then a shared key, then the same context
+// number for topics without keys.
+static void
+Diff_Match(std::vector<DiffTopic> &before, std::vector<DiffTopic> &after, const BHF::File &after_file) noexcept
+{
+    std::unordered_multimap<u64, usize> by_hash;
+    std::unordered_map<std::string_view, usize> by_key;
+
+    by_hash.reserve(after.size());
+
+    for (usize a = 0; a < after.size(); ++a) {
+        by_hash.emplace(after[a].hash, a);
+
+        for (std::string_view key : after[a].keys) {
+            by_key.emplace(key, a);
+        }
+    }
+
+    for (usize b = 0; b < before.size(); ++b) {
+        auto [first, last] = by_hash.equal_range(before[b].hash);
+
+        usize found = kNoMatch;
+
+        for (auto it = first; it != last; ++it) {
+            if (after[it->second].match != kNoMatch) {
+                continue;
+            }
+
+            if (found == kNoMatch || Diff_ShareKey(before[b], after[it->second])) {
+                found = it->second;
+            }
+
+            if (Diff_ShareKey(before[b], after[found])) {
+                break;
+            }
+        }
+
+        if (found != kNoMatch) {
+            Diff_Pair(before, b, after, found);
+        }
+    }
+
+    for (usize b = 0; b < before.size(); ++b) {
+        for (usize k = 0; k < before[b].keys.size() && before[b].match == kNoMatch; ++k) {
+            auto found = by_key.find(before[b].keys[k]);
+
+            if (found != by_key.end() && after[found->second].match == kNoMatch) {
+                Diff_Pair(before, b, after, found->second);
+            }
+        }
+    }
+
+    const BHF::File::ContextContainer &contexts = after_file.context();
+
+    for (usize b = 0; b < before.size(); ++b) {
+        usize context = static_cast<usize>(before[b].context);
+
+        if (before[b].match != kNoMatch || !before[b].keys.empty() || context >= contexts.size()) {
+            continue;
+        }
+
+        usize found = Diff_Find(after, contexts[context]);
+
+        if (found != kNoMatch && after[found].match == kNoMatch && after[found].keys.empty()) {
+            Diff_Pair(before, b, after, found);
+        }
+    }
+}
+
+// Topic a link of `file` goes to, kNoMatch for none.
+static usize
+Diff_Target(const std::vector<DiffTopic> &topics, const BHF::File &file, BHF::File::ContextType context) noexcept
+{
+    const BHF::File::ContextContainer &contexts = file.context();
+
+    if (context < 0 || static_cast<usize>(context) >= contexts.size()) {
+        return kNoMatch;
+    }
+
+    return Diff_Find(topics, contexts[static_cast<usize>(context)]);
+}
+
+// Sets DiffTopic::links of the topics of one version, once they are matched.
+// Context numbers change between versions, so a link is hashed as the after
+// topic it goes to: in the before version the match of its target, or
+// kNoMatch - 1 when that was removed.
+static void
+Diff_HashLinks(std::vector<DiffTopic> &topics, const BHF::File &file, bool before) noexcept
+{
+    std::vector<usize> targets;
+
+    for (DiffTopic &topic : topics) {
+        targets.clear();
+
+        auto add = [&](BHF::File::ContextType context) -> void {
+            usize target = Diff_Target(topics, file, context);
+
+            if (before && target != kNoMatch) {
+                target = topics[target].match != kNoMatch ? topics[target].match : kNoMatch - 1;
+            }
+
+            targets.push_back(target);
+        };
+
+        add(topic.keywords.up);
+        add(topic.keywords.down);
+
+        for (BHF::File::ContextType context : topic.keywords.contexts) {
+            add(context);
+        }
+
+        topic.links = BHF::hash64(targets.data(), targets.size() * sizeof(usize), kDiffSeed);
+    }
+}
+
+static std::string
+Diff_Links(const BHF::File::KeywordType &keywords) noexcept
+{
+    return fmt::format("up {}, down {}, links [{}]", keywords.up, keywords.down, fmt::join(keywords.contexts, ", "));
+}
+
+static std::vector<std::string_view>
+Diff_SplitLines(std::string_view text) noexcept
+{
+    std::vector<std::string_view> lines;
+
+    while (!text.empty()) {
+        std::string_view::size_type end = text.find('\n');
+
+        if (end == std::string_view::npos) {
+            lines.push_back(text);
+
+            break;
+        }
+
+        lines.push_back(text.substr(0, end));
+        text.remove_prefix(end + 1);
+    }
+
+    return lines;
+}
+
+// Myers' O(ND) shortest edit script. trace[d] keeps the furthest x of the
+// diagonals -d + 1 to d - 1 reached with d - 1 edits, all the backtracking
+// needs.
+static std::vector<DiffLine>
+Diff_Lines(const std::vector<std::string_view> &a, const std::vector<std::string_view> &b) noexcept
+{
+    const isize n = static_cast<isize>(a.size());
+    const isize m = static_cast<isize>(b.size());
+    const isize limit = std::min<isize>(n + m, static_cast<isize>(kMaximumEdits));
+
+    std::vector<isize> v(static_cast<usize>(2 * limit + 3), 0);
+    std::vector<std::vector<isize>> trace;
+
+    auto at = [&v, limit](isize k) -> isize & {
+        return v[static_cast<usize>(k + limit + 1)];
+    };
+
+    isize edits = -1;
+
+    for (isize d = 0; d <= limit && edits < 0; ++d) {
+        if (d > 0) {
+            trace.emplace_back(v.begin() + (limit + 2 - d), v.begin() + (limit + 1 + d));
+        } else {
+            trace.emplace_back();
+        }
+
+        for (isize k = -d; k <= d; k += 2) {
+            isize x = (k == -d || (k != d && at(k - 1) < at(k + 1))) ? at(k + 1) : at(k - 1) + 1;
+            isize y = x - k;
+
+            while (x < n && y < m && a[static_cast<usize>(x)] == b[static_cast<usize>(y)]) {
+                ++x;
+                ++y;
+            }
+
+            at(k) = x;
+
+            if (x >= n && y >= m) {
+                edits = d;
+
+                break;
+            }
+        }
+    }
+
+    std::vector<DiffLine> result;
+
+    if (edits < 0) {
+        for (isize x = 0; x < n; ++x) {
+            result.push_back({DiffLine::Delete, static_cast<u32>(x), 0});
+        }
+
+        for (isize y = 0; y < m; ++y) {
+            result.push_back({DiffLine::Insert, static_cast<u32>(n), static_cast<u32>(y)});
+        }
+
+        return result;
+    }
+
+    isize x = n;
+    isize y = m;
+
+    for (isize d = edits; d >= 0; --d) {
+        const std::vector<isize> &previous = trace[static_cast<usize>(d)];
+
+        auto furthest = [&previous, d](isize k) -> isize {
+            return previous[static_cast<usize>(k + d - 1)];
+        };
+
+        isize k = x - y;
+        isize previous_k = 0;
+        isize previous_x = 0;
+
+        if (d > 0) {
+            previous_k = (k == -d || (k != d && furthest(k - 1) < furthest(k + 1))) ? k + 1 : k - 1;
+            previous_x = furthest(previous_k);
+        }
+
+        isize previous_y = previous_x - previous_k;
+
+        while (x > previous_x && y > previous_y) {
+            --x;
+            --y;
+
+            result.push_back({DiffLine::Equal, static_cast<u32>(x), static_cast<u32>(y)});
+        }
+
+        if (d > 0) {
+            if (x == previous_x) {
+                result.push_back({DiffLine::Insert, static_cast<u32>(x), static_cast<u32>(previous_y)});
+            } else {
+                result.push_back({DiffLine::Delete, static_cast<u32>(previous_x), static_cast<u32>(y)});
+            }
+        }
+
+        x = previous_x;
+        y = previous_y;
+    }
+
+    std::reverse(result.begin(), result.end());
+
+    return result;
+}
+
+// Unified diff hunks of two texts, `context_lines` unchanged lines around
+// the changes.
+static void
+Diff_Format(std::string_view before, std::string_view after, usize context_lines, std::string &out) noexcept
+{
+    std::vector<std::string_view> a = Diff_SplitLines(before);
+    std::vector<std::string_view> b = Diff_SplitLines(after);
+    std::vector<DiffLine> lines = Diff_Lines(a, b);
+
+    auto isChange = [&lines](usize i) -> bool {
+        return lines[i].operation != DiffLine::Equal;
+    };
+
+    usize i = 0;
+
+    while (i < lines.size()) {
+        while (i < lines.size() && !isChange(i)) {
+            ++i;
+        }
+
+        if (i == lines.size()) {
+            break;
+        }
+
+        usize start = i > context_lines ? i - context_lines : 0;
+        usize last = i;
+
+        // Changes closer than twice the context share a hunk.
+        for (usize j = i + 1; j < lines.size() && j <= last + 2 * context_lines + 1; ++j) {
+            if (isChange(j)) {
+                last = j;
+            }
+        }
+
+        usize end = std::min(last + context_lines + 1, lines.size());
+
+        usize before_count = 0;
+        usize after_count = 0;
+
+        for (usize j = start; j < end; ++j) {
+            before_count += lines[j].operation != DiffLine::Insert;
+            after_count += lines[j].operation != DiffLine::Delete;
+        }
+
+        fmt::format_to(std::back_inserter(out), "@@ -{},{} +{},{} @@\n", lines[start].before + 1, before_count, lines[start].after + 1, after_count);
+
+        for (usize j = start; j < end; ++j) {
+            const DiffLine &line = lines[j];
+
+            switch (line.operation) {
+                case DiffLine::Equal  : fmt::format_to(std::back_inserter(out), " {}\n", a[line.before]); break;
+                case DiffLine::Delete : fmt::format_to(std::back_inserter(out), "-{}\n", a[line.before]); break;
+                case DiffLine::Insert : fmt::format_to(std::back_inserter(out), "+{}\n", b[line.after]); break;
+            }
+        }
+
+        i = end;
+    }
+}
+
+static std::string
+Diff_Keys(const DiffTopic &topic) noexcept
+{
+    return topic.keys.empty() ? std::string() : fmt::format(" [{}]", fmt::join(topic.keys, ", "));
+}
+
+DiffSummary
+diff(const BHF::File &before, const BHF::File &after, const DiffOptions &options) noexcept
+{
+    std::vector<DiffTopic> before_topics = Diff_Topics(before, options.jobs);
+    std::vector<DiffTopic> after_topics = Diff_Topics(after, options.jobs);
+
+    Diff_Match(before_topics, after_topics, after);
+
+    Diff_HashLinks(before_topics, before, true);
+    Diff_HashLinks(after_topics, after, false);
+
+    DiffSummary summary;
+
+    for (const DiffTopic &topic : before_topics) {
+        if (topic.damaged) {
+            fmt::print("damaged before {}{}\n", topic.context, Diff_Keys(topic));
+
+            ++summary.damaged;
+        }
+    }
+
+    for (const DiffTopic &topic : after_topics) {
+        if (topic.damaged) {
+            fmt::print("damaged after {}{}\n", topic.context, Diff_Keys(topic));
+
+            ++summary.damaged;
+        }
+    }
+
+    std::vector<usize> changed;
+
+    for (usize b = 0; b < before_topics.size(); ++b) {
+        const DiffTopic &topic = before_topics[b];
+
+        if (topic.match == kNoMatch) {
+            ++summary.removed;
+        } else if (after_topics[topic.match].hash == topic.hash && after_topics[topic.match].links == topic.links) {
+            ++summary.unchanged;
+        } else {
+            ++summary.changed;
+
+            changed.push_back(b);
+        }
+    }
+
+    for (const DiffTopic &topic : after_topics) {
+        summary.added += topic.match == kNoMatch;
+    }
+
+    // Changed topics are decoded again, only them, and diffed in parallel.
+    std::vector<std::string> hunks(options.summary ? 0 : changed.size());
+
+    parallelFor(hunks.size(), options.jobs, [&](unsigned, usize i) {
+        const DiffTopic &topic = before_topics[changed[i]];
+        const DiffTopic &match = after_topics[topic.match];
+
+        if (match.hash != topic.hash) {
+            Diff_Format(before.text(topic.offset), after.text(match.offset), options.context_lines, hunks[i]);
+        }
+
+        if (match.links != topic.links) {
+            fmt::format_to(std::back_inserter(hunks[i]), "@@ links @@\n-{}\n+{}\n", Diff_Links(topic.keywords), Diff_Links(match.keywords));
+        }
+
+        return true;
+    });
+
+    usize next_changed = 0;
+
+    for (usize b = 0; b < before_topics.size(); ++b) {
+        const DiffTopic &topic = before_topics[b];
+
+        if (topic.match == kNoMatch) {
+            fmt::print("removed {}{}\n", topic.context, Diff_Keys(topic));
+        } else if (next_changed < changed.size() && changed[next_changed] == b) {
+            fmt::print("changed {} -> {}{}\n", topic.context, after_topics[topic.match].context, Diff_Keys(after_topics[topic.match]));
+
+            if (!options.summary) {
+                fmt::print("{}", hunks[next_changed]);
+            }
+
+            ++next_changed;
+        }
+    }
+
+    for (const DiffTopic &topic : after_topics) {
+        if (topic.match == kNoMatch) {
+            fmt::print("added {}{}\n", topic.context, Diff_Keys(topic));
+        }
+    }
+
+    fmt::print("{} added, {} removed, {} changed, {} unchanged", summary.added, summary.removed, summary.changed, summary.unchanged);
+
+    if (summary.damaged > 0) {
+        fmt::print(", {} damaged", summary.damaged);
+    }
+
+    fmt::print("\n");
+
+    return summary;
+}
+
+} // namespace CLI
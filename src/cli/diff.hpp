@@ -0,0 +1,41 @@
+// SPDX-License-Identifier: MIT
+// Copyright (c) 2022 Gustavo Ribeiro Croscato
+
+#ifndef BHFCONVERTER_SRC_CLI_DIFF_HPP
+#define BHFCONVERTER_SRC_CLI_DIFF_HPP 1
+
+#include "bhf/file.hpp"
+
+namespace CLI {
+
+struct DiffOptions {
+    unsigned jobs = 1;
+
+    // Only list the topics, without line diffs.
+    bool summary = false;
+
+    // Unchanged lines printed around the changed ones.
+    usize context_lines = 3;
+};
+
+struct DiffSummary {
+    usize added = 0;
+    usize removed = 0;
+    usize changed = 0;
+    usize unchanged = 0;
+
+    // Topics whose records could not be decoded, in either version.
+    usize damaged = 0;
+};
+
+// Compares the topics of two versions of a help file and prints the added,
+// removed and changed ones, with a unified diff of the plain text of the
+// changed ones and their links when those go to other topics. Contexts are
+// renumbered between versions, so topics are matched by content first, then
+// by index keys, then by context number when a topic has no keys. Topics
+// that can't be decoded are listed as damaged and compared as empty ones.
+DiffSummary diff(const BHF::File &before, const BHF::File &after, const DiffOptions &options) noexcept;
+
+} // namespace CLI
+
+#endif // BHFCONVERTER_SRC_CLI_DIFF_HPP
@@ -0,0 +1,282 @@
+// SPDX-License-Identifier: MIT
+// Copyright (c) 2022 Gustavo Ribeiro Croscato
+
+#include <filesystem>
+#include <mutex>
+
+#include "bhf/format.hpp"
+#include "bhf/hash.hpp"
+#include "htmlutil.hpp"
+#include "manifest.hpp"
+#include "pipeline.hpp"
+#include "export/html.hpp"
+
+namespace CLI {
+namespace Export {
+
+// Pages per directory.
+static constexpr u32 kShardBits = 8;
+
+static constexpr std::string_view kManifestFile = ".bhf-manifest";
+
+// Part of the manifest hash, change it whenever the page layout changes so
+// the next export rewrites every page.
+static constexpr u64 kManifestSeed = 0x68746d6c00000001ull;
+
+// Buffers of a thread, one page in flight per thread.
+struct HTMLScratch {
+    std::string page;
+    std::string text;
+    std::string decode;
+};
+
+struct Site {
+    const BHF::File &file;
+    std::filesystem::path root;
+
+    // First index key of each context, used as the page title.
+    std::vector<std::string_view> titles;
+};
+
+// Path of a page relative to another page.
+static void
+HTML_AppendPageLink(std::string &out, BHF::File::ContextType context) noexcept
+{
+    fmt::format_to(std::back_inserter(out), "../{}/{}.html", static_cast<u32>(context) >> kShardBits, context);
+}
+
+// Keyword targets without a page of their own lead to the main index topic.
+struct HTMLSiteLink {
+    void operator()(std::string &out, BHF::File::ContextType context) const noexcept
+    {
+        HTML_AppendPageLink(out, htmlHasPage(site->file, context) ? context : site->file.fileHeader().main_index);
+    }
+
+    const Site *site = nullptr;
+};
+
+static void
+HTML_RenderPage(const Site &site, BHF::File::ContextType context, HTMLScratch &scratch) noexcept
+{
+    std::string &out = scratch.page;
+
+    BHF::File::ContextType offset = site.file.context()[static_cast<usize>(context)];
+    BHF::File::KeywordType keywords = site.file.keywords(offset);
+
+    std::string_view title = site.titles[static_cast<usize>(context)];
+
+    out += "<!DOCTYPE html>\n<html>\n<head>\n<meta charset=\"utf-8\">\n<title>";
+
+    if (title.empty()) {
+        fmt::format_to(std::back_inserter(out), "Context {}", context);
+    } else {
+        appendHTMLEscaped(out, title);
+    }
+
+    out += "</title>\n</head>\n<body>\n<nav><a href=\"../../index.html\">Index</a>";
+
+    if (htmlHasPage(site.file, keywords.up) && keywords.up > 0) {
+        out += " <a rel=\"prev\" href=\"";
+        HTML_AppendPageLink(out, keywords.up);
+        out += "\">Previous</a>";
+    }
+
+    if (htmlHasPage(site.file, keywords.down) && keywords.down > 0) {
+        out += " <a rel=\"next\" href=\"";
+        HTML_AppendPageLink(out, keywords.down);
+        out += "\">Next</a>";
+    }
+
+    out += "</nav>\n";
+
+    BHF::HTMLEmitter<HTMLSiteLink> emitter{out, {&site}};
+
+    site.file.text(offset, BHF::File::Raw, scratch.text, scratch.decode);
+
+    BHF::formatText(scratch.text, keywords, emitter);
+
+    out += "\n</body>\n</html>\n";
+}
+
+static void
+HTML_RenderIndex(const Site &site, std::string &out) noexcept
+{
+    out += "<!DOCTYPE html>\n<html>\n<head>\n<meta charset=\"utf-8\">\n<title>";
+    appendHTMLEscaped(out, site.file.signature());
+    out += "</title>\n</head>\n<body>\n";
+
+    BHF::File::ContextType main_index = site.file.fileHeader().main_index;
+
+    if (htmlHasPage(site.file, main_index)) {
+        fmt::format_to(std::back_inserter(out), "<nav><a href=\"c/{}/{}.html\">Contents</a></nav>\n", static_cast<u32>(main_index) >> kShardBits, main_index);
+    }
+
+    out += "<ul>\n";
+
+    for (const BHF::File::IndexType &index : site.file.index()) {
+        out += "<li>";
+
+        if (htmlHasPage(site.file, index.context)) {
+            fmt::format_to(std::back_inserter(out), "<a href=\"c/{}/{}.html\">", static_cast<u32>(index.context) >> kShardBits, index.context);
+            appendHTMLEscaped(out, index.index);
+            out += "</a>";
+        } else {
+            appendHTMLEscaped(out, index.index);
+        }
+
+        out += "</li>\n";
+    }
+
+    out += "</ul>\n</body>\n</html>\n";
+}
+
+// The page is complete in memory, so it goes to the file in a single write.
+static bool
+HTML_WriteFile(const std::filesystem::path &path, std::string_view content, std::string &error) noexcept
+{
+    std::FILE *file = std::fopen(path.c_str(), "wb");
+
+    if (!file) {
+        error = fmt::format("Error creating file {}.", path.string());
+
+        return false;
+    }
+
+    std::setvbuf(file, nullptr, _IONBF, 0);
+
+    bool result = std::fwrite(content.data(), 1, content.size(), file) == content.size();
+
+    result = std::fclose(file) == 0 && result;
+
+    if (!result) {
+        error = fmt::format("Error writing file {}.", path.string());
+    }
+
+    return result;
+}
+
+static bool
+HTML_CreateDirectory(const std::filesystem::path &path, std::string &error) noexcept
+{
+    std::error_code code;
+
+    std::filesystem::create_directories(path, code);
+
+    if (code) {
+        error = fmt::format("Error creating directory {}: {}.", path.string(), code.message());
+
+        return false;
+    }
+
+    return true;
+}
+
+bool
+html(const BHF::File &file, std::string_view directory, unsigned jobs, std::string &error, const Deadline &deadline) noexcept
+{
+    Site site{file, std::filesystem::path(directory), std::vector<std::string_view>(file.context().size())};
+
+    for (const BHF::File::IndexType &index : file.index()) {
+        if (index.context >= 0 && static_cast<usize>(index.context) < site.titles.size() && site.titles[static_cast<usize>(index.context)].empty()) {
+            site.titles[static_cast<usize>(index.context)] = index.index;
+        }
+    }
+
+    if (!HTML_CreateDirectory(site.root / "c", error)) {
+        return false;
+    }
+
+    std::string buffer;
+
+    HTML_RenderIndex(site, buffer);
+
+    if (!HTML_WriteFile(site.root / "index.html", buffer, error)) {
+        return false;
+    }
+
+    const BHF::File::ContextContainer &contexts = file.context();
+
+    Manifest previous;
+    Manifest current;
+
+    bool reuse = previous.load(site.root / kManifestFile);
+
+    current.global = manifestGlobalHash(file, kManifestSeed);
+    current.entries.resize(contexts.size());
+
+    reuse = reuse && previous.global == current.global;
+
+    usize shards = (contexts.size() + (1u << kShardBits) - 1) >> kShardBits;
+
+    for (usize shard = 0; shard < shards; ++shard) {
+        usize first = shard << kShardBits;
+        usize last = std::min(first + (1u << kShardBits), contexts.size());
+
+        bool has_page = std::any_of(contexts.begin() + static_cast<isize>(first), contexts.begin() + static_cast<isize>(last), [](BHF::File::ContextType offset) {
+            return offset >= 0;
+        });
+
+        if (has_page && !HTML_CreateDirectory(site.root / "c" / std::to_string(shard), error)) {
+            return false;
+        }
+    }
+
+    auto cost = [&site, &contexts](usize i) -> usize {
+        return htmlHasPage(site.file, static_cast<BHF::File::ContextType>(i)) ? site.file.topicData(contexts[i]).size() : 0;
+    };
+
+    std::vector<HTMLScratch> scratch(jobs > 0 ? jobs : 1);
+    std::mutex error_mutex;
+
+    auto render = [&](unsigned worker, usize i) -> bool {
+        BHF::File::ContextType context = static_cast<BHF::File::ContextType>(i);
+
+        if (!htmlHasPage(site.file, context)) {
+            return true;
+        }
+
+        std::string page_error;
+
+        if (deadline.isExpired()) {
+            page_error = "Timed out.";
+        } else {
+            Manifest::Entry &entry = current.entries[i];
+
+            entry.hash = BHF::hash64(file.topicData(contexts[i]));
+            entry.output = fmt::format("c/{}/{}.html", i >> kShardBits, i);
+
+            // Same records and same surroundings give the same page.
+            if (reuse && previous.isUnchanged(context, entry.hash, entry.output, site.root)) {
+                return true;
+            }
+
+            scratch[worker].page.clear();
+
+            HTML_RenderPage(site, context, scratch[worker]);
+
+            if (HTML_WriteFile(site.root / entry.output, scratch[worker].page, page_error)) {
+                return true;
+            }
+        }
+
+        std::lock_guard lock(error_mutex);
+
+        if (error.empty()) {
+            error = std::move(page_error);
+        }
+
+        return false;
+    };
+
+    // Pages are files of their own, written in whatever order they finish.
+    if (!parallelForByCost(contexts.size(), jobs, cost, render)) {
+        return false;
+    }
+
+    manifestRemoveStale(previous, current, site.root);
+
+    return current.save(site.root / kManifestFile, error);
+}
+
+} // namespace Export
+} // namespace CLI
@@ -0,0 +1,24 @@
+// SPDX-License-Identifier: MIT
+// Copyright (c) 2022 Gustavo Ribeiro Croscato
+
+#ifndef BHFCONVERTER_SRC_CLI_EXPORT_HTML_HPP
+#define BHFCONVERTER_SRC_CLI_EXPORT_HTML_HPP 1
+
+#include "bhf/file.hpp"
+#include "pipeline.hpp"
+
+namespace CLI {
+namespace Export {
+
+// Writes a static site to `directory`: index.html with every index key and
+// one page per context under c/<context / 256>/<context>.html, keywords are
+// relative links between the pages. A manifest in the directory records the
+// hash of every topic, exporting again only rewrites the pages of topics
+// that changed and deletes the pages of topics that are gone. Returns false
+// and fills `error` when the export fails or `deadline` expires.
+bool html(const BHF::File &file, std::string_view directory, unsigned jobs, std::string &error, const Deadline &deadline = {}) noexcept;
+
+} // namespace Export
+} // namespace CLI
+
+#endif // BHFCONVERTER_SRC_CLI_EXPORT_HTML_HPP
@@ -0,0 +1,144 @@
+// SPDX-License-Identifier: MIT
+// Copyright (c) 2022 Gustavo Ribeiro Croscato
+
+#include "json.hpp"
+#include "export/ndjson.hpp"
+
+namespace CLI {
+namespace Export {
+
+// Topics a thread may encode ahead of the output, bounds the lines waiting
+// in memory whatever the size of the help file.
+static constexpr usize kTopicsPerJob = 64;
+
+// Decode buffers of a thread.
+struct NDJSONScratch {
+    std::string text;
+    std::string decode;
+};
+
+static void
+NDJSON_AppendContext(std::string &out, BHF::File::ContextType context) noexcept
+{
+    if (context > 0) {
+        fmt::format_to(std::back_inserter(out), "{}", context);
+    } else {
+        out += "null";
+    }
+}
+
+bool
+ndjson(const BHF::File &file, std::FILE *output, bool with_html, unsigned jobs, std::string &error) noexcept
+{
+    const BHF::File::ContextContainer &context = file.context();
+    const BHF::File::IndexContainer &index = file.index();
+
+    // Index entries grouped by context: the keys of context c are
+    // keys[first[c]] .. keys[first[c + 1] - 1], positions into the index.
+    std::vector<usize> first(context.size() + 1, 0);
+    std::vector<usize> keys;
+
+    for (const BHF::File::IndexType &entry : index) {
+        if (entry.context >= 0 && static_cast<usize>(entry.context) < context.size()) {
+            ++first[static_cast<usize>(entry.context) + 1];
+        }
+    }
+
+    for (usize i = 1; i < first.size(); ++i) {
+        first[i] += first[i - 1];
+    }
+
+    keys.resize(first.back());
+
+    {
+        std::vector<usize> next(first.begin(), first.end() - 1);
+
+        for (usize i = 0; i < index.size(); ++i) {
+            if (index[i].context >= 0 && static_cast<usize>(index[i].context) < context.size()) {
+                keys[next[static_cast<usize>(index[i].context)]++] = i;
+            }
+        }
+    }
+
+    auto cost = [&file, &context](usize i) -> usize {
+        return context[i] < 0 ? 0 : file.topicData(context[i]).size();
+    };
+
+    std::vector<NDJSONScratch> scratch(jobs > 0 ? jobs : 1);
+
+    auto encode = [&](unsigned worker, usize i) -> std::string {
+        std::string out;
+
+        if (context[i] < 0) {
+            return out;
+        }
+
+        NDJSONScratch &buffers = scratch[worker];
+        BHF::File::KeywordType keywords = file.keywords(context[i]);
+
+        fmt::format_to(std::back_inserter(out), "{{\"context\":{},\"offset\":{},\"keys\":[", i, context[i]);
+
+        for (usize k = first[i]; k < first[i + 1]; ++k) {
+            if (k > first[i]) {
+                out += ',';
+            }
+
+            appendJSONString(out, index[keys[k]].index);
+        }
+
+        out += "],\"up\":";
+        NDJSON_AppendContext(out, keywords.up);
+        out += ",\"down\":";
+        NDJSON_AppendContext(out, keywords.down);
+        out += ",\"keywords\":[";
+
+        for (BHF::File::ContextContainer::size_type k = 0; k < keywords.contexts.size(); ++k) {
+            if (k > 0) {
+                out += ',';
+            }
+
+            fmt::format_to(std::back_inserter(out), "{}", keywords.contexts[k]);
+        }
+
+        out += "],\"text\":";
+        file.text(context[i], BHF::File::PlainText, buffers.text, buffers.decode);
+        appendJSONString(out, buffers.text);
+
+        if (with_html) {
+            out += ",\"html\":";
+            file.text(context[i], BHF::File::HTML, buffers.text, buffers.decode);
+            appendJSONString(out, buffers.text);
+        }
+
+        out += "}\n";
+
+        return out;
+    };
+
+    auto write = [output, &error](std::string &&line) -> bool {
+        if (std::fwrite(line.data(), 1, line.size(), output) != line.size()) {
+            error = "Error writing output.";
+
+            return false;
+        }
+
+        return true;
+    };
+
+    usize window = static_cast<usize>(jobs > 0 ? jobs : 1) * kTopicsPerJob;
+
+    if (!orderedPipeline(context.size(), jobs, window, cost, encode, write)) {
+        return false;
+    }
+
+    if (std::fflush(output) != 0) {
+        error = "Error writing output.";
+
+        return false;
+    }
+
+    return true;
+}
+
+} // namespace Export
+} // namespace CLI
@@ -0,0 +1,28 @@
+// SPDX-License-Identifier: MIT
+// Copyright (c) 2022 Gustavo Ribeiro Croscato
+
+#ifndef BHFCONVERTER_SRC_CLI_EXPORT_NDJSON_HPP
+#define BHFCONVERTER_SRC_CLI_EXPORT_NDJSON_HPP 1
+
+#include "bhf/file.hpp"
+#include "pipeline.hpp"
+
+namespace CLI {
+namespace Export {
+
+// Writes one JSON object per line and per context to `output`, in context
+// order:
+//
+//   {"context":1,"offset":1234,"keys":["..."],"up":null,"down":2,
+//    "keywords":[3,4],"text":"...","html":"..."}
+//
+// "html" is only present when `with_html` is set. Topics are decoded by
+// `jobs` threads a few batches ahead of the writer, so memory does not grow
+// with the size of the help file. Returns false and fills `error` when the
+// export fails.
+bool ndjson(const BHF::File &file, std::FILE *output, bool with_html, unsigned jobs, std::string &error) noexcept;
+
+} // namespace Export
+} // namespace CLI
+
+#endif // BHFCONVERTER_SRC_CLI_EXPORT_NDJSON_HPP
@@ -0,0 +1,399 @@
+// SPDX-License-Identifier: MIT
+// Copyright (c) 2022 Gustavo Ribeiro Croscato
+
+#include "pipeline.hpp"
+#include "export/sqlite.hpp"
+#include "generated/database.hpp"
+
+#if defined(USING_SQLITE3)
+
+namespace CLI {
+namespace Export {
+
+// Topics a thread may decode ahead of the writer, bounds the rows waiting
+// in memory.
+static constexpr usize kTopicsPerJob = 64;
+
+// The database is written from scratch by a single connection, durability
+// only matters once the final COMMIT is done.
+static constexpr std::string_view kBulkPragmas = R"sql(
+PRAGMA foreign_keys = OFF;
+PRAGMA journal_mode = OFF;
+PRAGMA synchronous = OFF;
+PRAGMA locking_mode = EXCLUSIVE;
+PRAGMA temp_store = MEMORY;
+PRAGMA cache_size = -65536;
+)sql";
+
+enum Statement : usize {
+      InsertContext
+    , InsertIndex
+    , InsertText
+    , InsertKeyword
+    , InsertKeywordList
+    , InsertSearch
+    , StatementCount
+};
+
+static constexpr std::array<std::string_view, StatementCount> kStatements = {
+      "INSERT INTO tbl_context (context_id, context_offset) VALUES (?, ?)"
+    , "INSERT INTO tbl_index (context_id, index_value) VALUES (?, ?)"
+    , "INSERT INTO tbl_text (context_id, text_value) VALUES (?, ?)"
+    , "INSERT INTO tbl_keyword (context_id, keyword_up_context, keyword_down_context) VALUES (?, ?, ?)"
+    , "INSERT INTO tbl_keyword_list (context_id, keyword_index, keyword_context) VALUES (?, ?, ?)"
+    , "INSERT INTO tbl_text_search (rowid, index_keys, text_plain, text_terms) VALUES (?, ?, ?, ?)"
+};
+
+struct TopicRow {
+    i64 context;
+    std::string text;
+    std::string plain;
+    std::string terms;
+    BHF::File::KeywordType keywords;
+};
+
+struct Database {
+    ~Database() noexcept
+    {
+        for (sqlite3_stmt *statement : statements) {
+            sqlite3_finalize(statement);
+        }
+
+        sqlite3_close(db);
+    }
+
+    bool open(std::string_view path) noexcept
+    {
+        std::string filepath(path);
+
+        std::remove(filepath.c_str());
+
+        if (sqlite3_open_v2(filepath.c_str(), &db, SQLITE_OPEN_READWRITE | SQLITE_OPEN_CREATE, nullptr) != SQLITE_OK) {
+            return fail("open");
+        }
+
+        return true;
+    }
+
+    bool exec(std::string_view sql) noexcept
+    {
+        if (sqlite3_exec(db, std::string(sql).c_str(), nullptr, nullptr, nullptr) != SQLITE_OK) {
+            return fail("exec");
+        }
+
+        return true;
+    }
+
+    bool prepare() noexcept
+    {
+        for (usize i = 0; i < StatementCount; ++i) {
+            if (sqlite3_prepare_v3(db, kStatements[i].data(), static_cast<int>(kStatements[i].size()), SQLITE_PREPARE_PERSISTENT, &statements[i], nullptr) != SQLITE_OK) {
+                return fail("prepare");
+            }
+        }
+
+        return true;
+    }
+
+    // Runs the cached statement with the values already bound and leaves it
+    // ready for the next row.
+    bool step(Statement statement) noexcept
+    {
+        sqlite3_stmt *stmt = statements[statement];
+
+        int status = sqlite3_step(stmt);
+
+        sqlite3_reset(stmt);
+        sqlite3_clear_bindings(stmt);
+
+        if (status != SQLITE_DONE) {
+            return fail(kStatements[statement]);
+        }
+
+        return true;
+    }
+
+    bool fail(std::string_view operation) noexcept
+    {
+        error = fmt::format("SQLite3 {}: {}", operation, sqlite3_errmsg(db));
+
+        return false;
+    }
+
+    sqlite3 *db = nullptr;
+    std::array<sqlite3_stmt *, StatementCount> statements{};
+    std::string error;
+};
+
+static bool
+SQLite_IsIdentifierChar(char c) noexcept
+{
+    return (c >= 'a' && c <= 'z') || (c >= 'A' && c <= 'Z') || (c >= '0' && c <= '9') || c == '_';
+}
+
+static bool
+SQLite_IsUpper(char c) noexcept
+{
+    return c >= 'A' && c <= 'Z';
+}
+
+static bool
+SQLite_IsLower(char c) noexcept
+{
+    return c >= 'a' && c <= 'z';
+}
+
+// Appends the parts of every compound identifier of `text` to `terms`:
+// underscores and case changes split it, "GetMaxX" gives "Get Max X" and
+// "str_len" gives "str len". The whole identifier stays in text_plain.
+static void
+SQLite_IdentifierTerms(std::string_view text, std::string &terms) noexcept
+{
+    std::string_view::size_type i = 0;
+
+    while (i < text.size()) {
+        if (!SQLite_IsIdentifierChar(text[i])) {
+            ++i;
+
+            continue;
+        }
+
+        std::string_view::size_type start = i;
+
+        while (i < text.size() && SQLite_IsIdentifierChar(text[i])) {
+            ++i;
+        }
+
+        std::string_view identifier = text.substr(start, i - start);
+
+        bool compound = false;
+
+        for (std::string_view::size_type j = 1; j < identifier.size() && !compound; ++j) {
+            compound = identifier[j] == '_' || (SQLite_IsLower(identifier[j - 1]) && SQLite_IsUpper(identifier[j]));
+        }
+
+        if (!compound) {
+            continue;
+        }
+
+        std::string_view::size_type part = 0;
+
+        for (std::string_view::size_type j = 0; j <= identifier.size(); ++j) {
+            bool boundary = j == identifier.size() || identifier[j] == '_';
+
+            if (!boundary && j > part) {
+                char previous = identifier[j - 1];
+                char current = identifier[j];
+                bool next_lower = j + 1 < identifier.size() && SQLite_IsLower(identifier[j + 1]);
+
+                // fooBar | FOOBar
+                boundary = SQLite_IsUpper(current) && (SQLite_IsLower(previous) || (SQLite_IsUpper(previous) && next_lower));
+            }
+
+            if (!boundary) {
+                continue;
+            }
+
+            if (j > part) {
+                terms += identifier.substr(part, j - part);
+                terms += ' ';
+            }
+
+            part = (j < identifier.size() && identifier[j] == '_') ? j + 1 : j;
+        }
+    }
+}
+
+static bool
+SQLite_WriteContext(Database &database, const BHF::File &file) noexcept
+{
+    sqlite3_stmt *stmt = database.statements[InsertContext];
+
+    const BHF::File::ContextContainer &context = file.context();
+
+    for (BHF::File::ContextContainer::size_type i = 0; i < context.size(); ++i) {
+        sqlite3_bind_int64(stmt, 1, static_cast<i64>(i));
+        sqlite3_bind_int64(stmt, 2, context[i]);
+
+        if (!database.step(InsertContext)) {
+            return false;
+        }
+    }
+
+    return true;
+}
+
+static bool
+SQLite_WriteIndex(Database &database, const BHF::File &file) noexcept
+{
+    sqlite3_stmt *stmt = database.statements[InsertIndex];
+
+    for (const BHF::File::IndexType &index : file.index()) {
+        sqlite3_bind_int64(stmt, 1, index.context);
+        sqlite3_bind_text(stmt, 2, index.index.data(), static_cast<int>(index.index.size()), SQLITE_STATIC);
+
+        if (!database.step(InsertIndex)) {
+            return false;
+        }
+    }
+
+    return true;
+}
+
+static bool
+SQLite_WriteTopic(Database &database, const TopicRow &row, const std::vector<std::string> &keys) noexcept
+{
+    sqlite3_stmt *text = database.statements[InsertText];
+    sqlite3_stmt *keyword = database.statements[InsertKeyword];
+    sqlite3_stmt *keyword_list = database.statements[InsertKeywordList];
+
+    sqlite3_bind_int64(text, 1, row.context);
+    sqlite3_bind_blob(text, 2, row.text.data(), static_cast<int>(row.text.size()), SQLITE_STATIC);
+
+    if (!database.step(InsertText)) {
+        return false;
+    }
+
+    sqlite3_bind_int64(keyword, 1, row.context);
+
+    if (row.keywords.up > 0) {
+        sqlite3_bind_int64(keyword, 2, row.keywords.up);
+    }
+
+    if (row.keywords.down > 0) {
+        sqlite3_bind_int64(keyword, 3, row.keywords.down);
+    }
+
+    if (!database.step(InsertKeyword)) {
+        return false;
+    }
+
+    for (BHF::File::ContextContainer::size_type i = 0; i < row.keywords.contexts.size(); ++i) {
+        sqlite3_bind_int64(keyword_list, 1, row.context);
+        sqlite3_bind_int64(keyword_list, 2, static_cast<i64>(i));
+        sqlite3_bind_int64(keyword_list, 3, row.keywords.contexts[i]);
+
+        if (!database.step(InsertKeywordList)) {
+            return false;
+        }
+    }
+
+    sqlite3_stmt *search = database.statements[InsertSearch];
+    const std::string &index_keys = keys[static_cast<usize>(row.context)];
+
+    sqlite3_bind_int64(search, 1, row.context);
+    sqlite3_bind_text(search, 2, index_keys.data(), static_cast<int>(index_keys.size()), SQLITE_STATIC);
+    sqlite3_bind_text(search, 3, row.plain.data(), static_cast<int>(row.plain.size()), SQLITE_STATIC);
+    sqlite3_bind_text(search, 4, row.terms.data(), static_cast<int>(row.terms.size()), SQLITE_STATIC);
+
+    if (!database.step(InsertSearch)) {
+        return false;
+    }
+
+    return true;
+}
+
+bool
+sqlite(const BHF::File &file, std::string_view database_path, unsigned jobs, std::string &error, const Deadline &deadline) noexcept
+{
+    Database database;
+
+    // The schema turns foreign keys on, the bulk pragmas must come after it.
+    bool result = database.open(database_path)
+        && database.exec(kSchemaTables)
+        && database.exec(kBulkPragmas)
+        && database.exec("BEGIN TRANSACTION")
+        && database.prepare()
+        && SQLite_WriteContext(database, file)
+        && SQLite_WriteIndex(database, file);
+
+    if (result) {
+        const BHF::File::ContextContainer &context = file.context();
+
+        // Index keys of each context, for the weighted column of the search table.
+        std::vector<std::string> keys(context.size());
+
+        for (const BHF::File::IndexType &index : file.index()) {
+            if (index.context >= 0 && static_cast<usize>(index.context) < keys.size()) {
+                std::string &context_keys = keys[static_cast<usize>(index.context)];
+
+                if (!context_keys.empty()) {
+                    context_keys += '\n';
+                }
+
+                context_keys += index.index;
+            }
+        }
+
+        auto cost = [&file, &context](usize i) -> usize {
+            return context[i] < 0 ? 0 : file.topicData(context[i]).size();
+        };
+
+        std::vector<std::string> scratch(jobs > 0 ? jobs : 1);
+
+        // Decoder threads fill the rows, this thread is the only one talking
+        // to SQLite.
+        auto decode = [&file, &context, &scratch](unsigned worker, usize i) -> std::optional<TopicRow> {
+            if (context[i] < 0) {
+                return std::nullopt;
+            }
+
+            TopicRow row{static_cast<i64>(i), {}, {}, {}, file.keywords(context[i])};
+
+            file.text(context[i], BHF::File::Raw, row.text, scratch[worker]);
+            file.text(context[i], BHF::File::PlainText, row.plain, scratch[worker]);
+
+            SQLite_IdentifierTerms(row.plain, row.terms);
+
+            return row;
+        };
+
+        auto write = [&database, &keys, &deadline](std::optional<TopicRow> &&row) -> bool {
+            if (deadline.isExpired()) {
+                database.error = "Timed out.";
+
+                return false;
+            }
+
+            return !row || SQLite_WriteTopic(database, *row, keys);
+        };
+
+        usize window = static_cast<usize>(jobs > 0 ? jobs : 1) * kTopicsPerJob;
+
+        result = orderedPipeline(context.size(), jobs, window, cost, decode, write)
+            && database.exec(kSchemaIndexes)
+            && database.exec("COMMIT TRANSACTION");
+    }
+
+    if (result) {
+        result = database.exec("PRAGMA foreign_keys = ON");
+    }
+
+    if (result) {
+        sqlite3_stmt *stmt = nullptr;
+        usize violations = 0;
+
+        if (sqlite3_prepare_v2(database.db, "PRAGMA foreign_key_check", -1, &stmt, nullptr) == SQLITE_OK) {
+            while (sqlite3_step(stmt) == SQLITE_ROW) {
+                ++violations;
+            }
+        }
+
+        sqlite3_finalize(stmt);
+
+        if (violations > 0) {
+            fmt::print(stderr, "warning: {} foreign key violations in '{}'\n", violations, database_path);
+        }
+    }
+
+    if (!result) {
+        error = database.error;
+    }
+
+    return result;
+}
+
+} // namespace Export
+} // namespace CLI
+
+#endif // USING_SQLITE3
@@ -0,0 +1,21 @@
+// SPDX-License-Identifier: MIT
+// Copyright (c) 2022 Gustavo Ribeiro Croscato
+
+#ifndef BHFCONVERTER_SRC_CLI_EXPORT_SQLITE_HPP
+#define BHFCONVERTER_SRC_CLI_EXPORT_SQLITE_HPP 1
+
+#include "bhf/file.hpp"
+#include "pipeline.hpp"
+
+namespace CLI {
+namespace Export {
+
+// Writes the whole help file to a new database using the doc/database.sql
+// schema. Returns false and fills `error` when the export fails or
+// `deadline` expires.
+bool sqlite(const BHF::File &file, std::string_view database_path, unsigned jobs, std::string &error, const Deadline &deadline = {}) noexcept;
+
+} // namespace Export
+} // namespace CLI
+
+#endif // BHFCONVERTER_SRC_CLI_EXPORT_SQLITE_HPP
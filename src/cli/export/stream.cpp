@@ -0,0 +1,141 @@
+// SPDX-License-Identifier: MIT
+// Copyright (c) 2022 Gustavo Ribeiro Croscato
+
+#include "bhf/stream.hpp"
+#include "json.hpp"
+#include "export/stream.hpp"
+
+namespace CLI {
+namespace Export {
+
+// Output is handed to the FILE* in blocks of about this size.
+static constexpr usize kFlushSize = 1024 * 1024;
+
+static void
+Stream_AppendContext(std::string &out, BHF::File::ContextType context) noexcept
+{
+    if (context > 0) {
+        fmt::format_to(std::back_inserter(out), "{}", context);
+    } else {
+        out += "null";
+    }
+}
+
+static bool
+Stream_Flush(std::string &out, std::FILE *output, std::string &error) noexcept
+{
+    if (std::fwrite(out.data(), 1, out.size(), output) != out.size()) {
+        error = "Error writing output.";
+
+        return false;
+    }
+
+    out.clear();
+
+    return true;
+}
+
+bool
+stream(std::FILE *input, std::FILE *output, BHF::File::TextFormat format, std::string &error) noexcept
+{
+    BHF::RecordStream records(input);
+
+    if (!records.open()) {
+        error = records.lastError();
+
+        return false;
+    }
+
+    const BHF::File &header = records.header();
+    const BHF::File::ContextContainer &context = header.context();
+
+    std::vector<std::vector<std::string_view>> keys(context.size());
+
+    for (const BHF::File::IndexType &index : header.index()) {
+        if (index.context >= 0 && static_cast<usize>(index.context) < keys.size()) {
+            keys[static_cast<usize>(index.context)].push_back(index.index);
+        }
+    }
+
+    std::string out;
+    out.reserve(kFlushSize * 2);
+
+    BHF::RecordStream::Topic topic;
+
+    while (records.next(topic)) {
+        // Topics come by offset, the header knows the contexts pointing to it.
+        BHF::File::ContextRange contexts = header.contextsOf(topic.offset);
+
+        fmt::format_to(std::back_inserter(out), "{{\"offset\":{},\"contexts\":[", topic.offset);
+
+        for (const BHF::File::ContextType *it = contexts.begin(); it != contexts.end(); ++it) {
+            if (it != contexts.begin()) {
+                out += ',';
+            }
+
+            fmt::format_to(std::back_inserter(out), "{}", *it);
+        }
+
+        out += "],\"keys\":[";
+
+        bool separator = false;
+
+        for (BHF::File::ContextType c : contexts) {
+            for (std::string_view key : keys[static_cast<usize>(c)]) {
+                if (separator) {
+                    out += ',';
+                }
+
+                appendJSONString(out, key);
+
+                separator = true;
+            }
+        }
+
+        BHF::File::KeywordType keywords = header.topicKeywords(topic.records);
+
+        out += "],\"up\":";
+        Stream_AppendContext(out, keywords.up);
+        out += ",\"down\":";
+        Stream_AppendContext(out, keywords.down);
+        out += ",\"keywords\":[";
+
+        for (BHF::File::ContextContainer::size_type k = 0; k < keywords.contexts.size(); ++k) {
+            if (k > 0) {
+                out += ',';
+            }
+
+            fmt::format_to(std::back_inserter(out), "{}", keywords.contexts[k]);
+        }
+
+        out += "],\"text\":";
+        appendJSONString(out, header.formatTopic(topic.records, format));
+        out += "}\n";
+
+        if (out.size() >= kFlushSize && !Stream_Flush(out, output, error)) {
+            return false;
+        }
+    }
+
+    // Topics read before a truncation are still written.
+    if (!Stream_Flush(out, output, error)) {
+        return false;
+    }
+
+    if (!records.lastError().empty()) {
+        error = records.lastError();
+
+        return false;
+    }
+
+    if (std::fflush(output) != 0) {
+        error = "Error writing output.";
+
+        return false;
+    }
+
+    return true;
+}
+
+} // namespace Export
+} // namespace CLI
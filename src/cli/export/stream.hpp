@@ -0,0 +1,26 @@
+// SPDX-License-Identifier: MIT
+// Copyright (c) 2022 Gustavo Ribeiro Croscato
+
+#ifndef BHFCONVERTER_SRC_CLI_EXPORT_STREAM_HPP
+#define BHFCONVERTER_SRC_CLI_EXPORT_STREAM_HPP 1
+
+#include "bhf/file.hpp"
+
+namespace CLI {
+namespace Export {
+
+// Converts a help file read front to back from `input`, a pipe or stdin
+// works, writing one JSON object per topic and per line to `output`, in
+// file order:
+//
+//   {"offset":1234,"contexts":[1,7],"keys":["..."],"up":null,"down":2,
+//    "keywords":[3,4],"text":"..."}
+//
+// "text" is in `format`. Returns false and fills `error` when the input is
+// not a valid help file or writing fails.
+bool stream(std::FILE *input, std::FILE *output, BHF::File::TextFormat format, std::string &error) noexcept;
+
+} // namespace Export
+} // namespace CLI
+
+#endif // BHFCONVERTER_SRC_CLI_EXPORT_STREAM_HPP
@@ -0,0 +1,38 @@
+// SPDX-License-Identifier: MIT
+// Copyright (c) 2022 Gustavo Ribeiro Croscato
+
+#ifndef BHFCONVERTER_SRC_CLI_HTMLUTIL_HPP
+#define BHFCONVERTER_SRC_CLI_HTMLUTIL_HPP 1
+
+#include "bhf/file.hpp"
+
+namespace CLI {
+
+// Whether `context` leads to a topic, the pages of both the exported site
+// and the server.
+inline bool
+htmlHasPage(const BHF::File &file, BHF::File::ContextType context) noexcept
+{
+    const BHF::File::ContextContainer &contexts = file.context();
+
+    return context >= 0 && static_cast<usize>(context) < contexts.size() && contexts[static_cast<usize>(context)] >= 0;
+}
+
+// Appends `text` escaped for HTML text and attribute values.
+inline void
+appendHTMLEscaped(std::string &out, std::string_view text) noexcept
+{
+    for (char c : text) {
+        switch (c) {
+            case '"': out += "&quot;"; break;
+            case '&': out += "&amp;"; break;
+            case '<': out += "&lt;"; break;
+            case '>': out += "&gt;"; break;
+            default: out += c; break;
+        }
+    }
+}
+
+} // namespace CLI
+
+#endif // BHFCONVERTER_SRC_CLI_HTMLUTIL_HPP
@@ -0,0 +1,60 @@
+// SPDX-License-Identifier: MIT
+// Copyright (c) 2022 Gustavo Ribeiro Croscato
+
+#ifndef BHFCONVERTER_SRC_CLI_JSON_HPP
+#define BHFCONVERTER_SRC_CLI_JSON_HPP 1
+
+namespace CLI {
+
+inline bool
+jsonNeedsEscape(char c) noexcept
+{
+    return c == '"' || c == '\\' || static_cast<u8>(c) < 0x20;
+}
+
+// Appends `text` as a JSON string, the runs without anything to escape are
+// copied at once. The text is already UTF-8.
+inline void
+appendJSONString(std::string &out, std::string_view text) noexcept
+{
+    static constexpr std::string_view kHexDigits = "0123456789abcdef";
+
+    out += '"';
+
+    std::string_view::size_type i = 0;
+
+    while (i < text.size()) {
+        std::string_view::size_type start = i;
+
+        while (i < text.size() && !jsonNeedsEscape(text[i])) {
+            ++i;
+        }
+
+        out.append(text, start, i - start);
+
+        if (i == text.size()) {
+            break;
+        }
+
+        char c = text[i++];
+
+        switch (c) {
+            case '"': out += "\\\""; break;
+            case '\\': out += "\\\\"; break;
+            case '\n': out += "\\n"; break;
+            case '\t': out += "\\t"; break;
+            case '\r': out += "\\r"; break;
+            default:
+                out += "\\u00";
+                out += kHexDigits[(static_cast<u8>(c) >> 4) & 0x0f];
+                out += kHexDigits[static_cast<u8>(c) & 0x0f];
+                break;
+        }
+    }
+
+    out += '"';
+}
+
+} // namespace CLI
+
+#endif // BHFCONVERTER_SRC_CLI_JSON_HPP
@@ -1,709 +1,736 @@
 // SPDX-License-Identifier: MIT
 // Copyright (c) 2022 Gustavo Ribeiro Croscato
 
-#if 0
-#include <sys/stat.h>
+#include <filesystem>
 
-#define EXTRACT_CONTEXT 0
-#define EXTRACT_INDEX 0
-#define EXTRACT_TEXT 0
+#include "bhf/catalog.hpp"
+#include "bhf/file.hpp"
+#include "bhf/graph.hpp"
+#include "bhf/writer.hpp"
+#include "arguments.hpp"
+#include "batch.hpp"
+#include "diff.hpp"
+#include "serve.hpp"
+#include "export/html.hpp"
+#include "export/ndjson.hpp"
+#include "export/sqlite.hpp"
+#include "export/stream.hpp"
+
+static int
+CLI_Usage()
+{
+    fmt::print(
+        "usage: bhfconverter_cli <command> [options] <help file>\n"
+        "\n"
+        "commands:\n"
+        "  info <file>                       print the help file header\n"
+        "  text [options] <file> <context>   print the text of a context\n"
+        "  export [options] <file>           convert the whole help file\n"
+        "  batch [options] <file|dir>...     convert many help files\n"
+        "  serve [options] <file>            browse the help file on http://127.0.0.1\n"
+        "  graph [options] <file>            analyze the links between topics\n"
+        "  lookup [options] <key> <file>...  find an index key in several help files\n"
+        "  stream [options] [file|-]         convert a help file read from a pipe or stdin\n"
+        "  rewrite [options] <file> <output> recompress a help file and check the result\n"
+        "  diff [options] <before> <after>   compare the topics of two help files\n"
+        "\n"
+        "text options:\n"
+        "  --format <plain|html|markdown|raw> output format, plain by default\n"
+        "\n"
+        "export options:\n"
+        "  --html <directory>                write a static HTML site\n"
+        "  --sqlite <database>               write a SQLite database (doc/database.sql)\n"
+        "  --ndjson                          write one JSON object per context to stdout\n"
+        "  --with-html                       add the HTML text to the --ndjson objects\n"
+        "  --jobs <count>                    number of decoder threads\n"
+        "\n"
+        "batch options:\n"
+        "  --html <directory>                write a site per help file in directory\n"
+        "  --sqlite <directory>              write a database per help file in directory\n"
+        "  --jobs <count>                    number of files converted at the same time\n"
+        "  --memory <MiB>                    memory budget of the files being converted\n"
+        "  --timeout <seconds>               give up on a file after this long\n"
+        "  --reads <count>                   number of files read ahead, 16 by default\n"
+        "\n"
+        "serve options:\n"
+        "  --port <port>                     port to listen on, 8437 by default\n"
+        "  --jobs <count>                    number of request threads\n"
+        "  --cache <MiB>                     memory for rendered topics, 64 by default\n"
+        "\n"
+        "graph options:\n"
+        "  --list                            list the topics and links of every finding\n"
+        "  --jobs <count>                    number of threads reading the links\n"
+        "\n"
+        "lookup options:\n"
+        "  --prefix                          find the keys starting with key\n"
+        "\n"
+        "stream options:\n"
+        "  --format <plain|html|markdown|raw> text format of the JSON lines, plain by default\n"
+        "\n"
+        "rewrite options:\n"
+        "  --jobs <count>                    number of compression threads\n"
+        "\n"
+        "diff options:\n"
+        "  --summary                         list the changed topics without their lines\n"
+        "  --context <lines>                 unchanged lines around a change, 3 by default\n"
+        "  --jobs <count>                    number of decoder threads\n"
+    );
+
+    return 1;
+}
 
-constexpr u8 kNibbleRaw = 0x0F;
-constexpr u8 kNibbleRep = 0x0E;
+static bool
+CLI_Open(BHF::File &file, std::string_view filepath)
+{
+    if (!file.open(filepath)) {
+        fmt::print(stderr, "{}\n", file.lastError());
 
-#pragma pack(push,1)
+        return false;
+    }
 
-struct BHFVersion {
-    enum Format : u8 {
-          BP7 = 0x34
-        , TP6 = 0x33
-        , TP4 = 0x04 // Turbo C++ 3.0
-        , TP2 = 0x02
-    };
+    return true;
+}
 
-    Format format;
-    u8 text;
-};
-
-struct BHFHeader {
-    enum Type : u8 {
-          FileHeader
-        , Context
-        , Text
-        , Keyword
-        , Index
-        , Compression
-        , IndexTags
-    };
+static bool
+CLI_Format(std::string_view name, BHF::File::TextFormat &format)
+{
+    if (name == "plain") {
+        format = BHF::File::PlainText;
+    } else if (name == "html") {
+        format = BHF::File::HTML;
+    } else if (name == "markdown") {
+        format = BHF::File::Markdown;
+    } else if (name == "raw") {
+        format = BHF::File::Raw;
+    } else {
+        fmt::print(stderr, "Unknown format '{}'.\n", name);
+
+        return false;
+    }
 
-    Type type;
-    u16 length;
-};
-
-struct BHFRecordFile {
-    u16 options;
-    u16 main_index;
-    u16 largest_record;
-    u8 height;
-    u8 width;
-    u8 left_margin;
-};
-
-struct BHFRecordCompression {
-    enum Type : u8 {
-        Nibble = 2
-    };
+    return true;
+}
 
-    Type type;
-    u8 table[14];
-};
+static int
+CLI_Info(int argc, char *argv[])
+{
+    CLI::Arguments arguments;
 
-struct BHFKeyword {
-    u16 up_context;
-    u16 down_context;
-    u16 count;
-};
+    if (!arguments.parse(argc, argv, {}) || arguments.positional().size() != 1) {
+        return CLI_Usage();
+    }
 
-#pragma pack(pop)
+    BHF::File file;
 
-static std::string_view BHF_ReadString(char **buffer, size_t size = 0);
-template<typename T> static T * BHF_ReadPointer(char **buffer);
-template<typename T> static T BHF_ReadValue(char **buffer);
-const char * BHF_CP437toUTF8(u8 character);
-static std::string BHF_StringNormalize(const char *buffer, size_t size);
-static std::string BHF_Uncompress(char **buffer, size_t size, const BHFRecordCompression *compression);
+    if (!CLI_Open(file, arguments.positional()[0])) {
+        return 1;
+    }
 
-struct FileData {
-    i64 size;
-    std::unique_ptr<char, decltype(free)*> data;
-};
+    const BHF::FileHeader &header = file.fileHeader();
 
-FileData File_Read(std::string_view filepath);
+    fmt::print("stamp.........: {}\n", file.stamp());
+    fmt::print("signature.....: {}\n", file.signature());
+    fmt::print("version.......: {} {:x}\n", file.version().text, static_cast<u32>(file.version().format));
+    fmt::print("options.......: {}\n", header.options);
+    fmt::print("main index....: {}\n", header.main_index);
+    fmt::print("largest rec...: {}\n", header.largest_record);
+    fmt::print("screen size...: {} x {}\n", header.height, header.width);
+    fmt::print("left margin...: {}\n", header.left_margin);
+    fmt::print("contexts......: {}\n", file.context().size());
+    fmt::print("indexes.......: {}\n", file.index().size());
 
-int
-main(void)
+    return 0;
+}
+
+static int
+CLI_Text(int argc, char *argv[])
 {
-    // -- Database --
-    sqlite3 *db = nullptr;
+    CLI::Arguments arguments;
 
-    if (sqlite3_open("bcpp_31.db", &db) != SQLITE_OK) {
-        fmt::print("SQlite3: {}\n", sqlite3_errmsg(db));
-        exit(1);
+    if (!arguments.parse(argc, argv, {{"--format", true}}) || arguments.positional().size() != 2) {
+        return CLI_Usage();
     }
 
-    {
-        FileData sql_file = File_Read("database.sql");
-
-        char *error_message;
+    BHF::File::TextFormat format = BHF::File::PlainText;
 
-        if (sqlite3_exec(db, sql_file.data.get(), nullptr, nullptr, &error_message) != SQLITE_OK) {
-            fmt::print("SQlite3: {}\n", error_message);
-            sqlite3_free(error_message);
-            exit(1);
-        }
+    if (!CLI_Format(arguments.value("--format", "plain"), format)) {
+        return CLI_Usage();
     }
 
-    // -- Input --
-    FileData help_file = File_Read("data/tchelp.tch");
+    BHF::File file;
 
-    // -- Parsing --
-    char *cursor = help_file.data.get();
-    char *end = cursor + help_file.size;
+    if (!CLI_Open(file, arguments.positional()[0])) {
+        return 1;
+    }
 
-    std::string_view stamp = BHF_ReadString(&cursor);
-    fmt::print("stamp.........: {}\n", stamp);
+    std::string context_number(arguments.positional()[1]);
 
-    std::string_view signature = BHF_ReadString(&cursor);
-    fmt::print("signature.....: {}\n", signature);
+    usize context = std::strtoul(context_number.c_str(), nullptr, 10);
 
-    const BHFVersion *version = BHF_ReadPointer<BHFVersion>(&cursor);
-    fmt::print("version.......: {} {:x}\n", version->text, static_cast<u32>(version->format));
+    if (context >= file.context().size()) {
+        fmt::print(stderr, "Context {} out of range.\n", context_number);
 
-    const BHFRecordCompression *compression = nullptr;
+        return 1;
+    }
 
-    i64 context_id = 0;
+    fmt::print("{}", file.text(file.context()[context], format));
 
-    while (cursor < end) {
-        i64 offset = cursor - help_file.data.get();
+    return 0;
+}
 
-        const BHFHeader *header = BHF_ReadPointer<BHFHeader>(&cursor);
+static int
+CLI_Export(int argc, char *argv[])
+{
+    CLI::Arguments arguments;
 
-        if (header->length == 0) {
-            fmt::print("cursor {:p} {:p}\n", cursor, help_file.data.get() + help_file.size);
-            exit(0);
-        }
+    bool parsed = arguments.parse(argc, argv, {
+          {"--html", true}
+        , {"--sqlite", true}
+        , {"--ndjson", false}
+        , {"--with-html", false}
+        , {"--jobs", true}
+    });
 
-        if (header->type == BHFHeader::FileHeader) {
-            const BHFRecordFile *file = BHF_ReadPointer<BHFRecordFile>(&cursor);
+    if (!parsed) {
+        fmt::print(stderr, "{}\n", arguments.lastError());
 
-            fmt::print("--{{ FileHeader }}--\n");
-            fmt::print("  options.....: {}\n", file->options);
-            fmt::print("  main index..: {}\n", file->main_index);
-            fmt::print("  largest rec.: {}\n", file->largest_record);
-            fmt::print("  screen size.: {} x {}\n", file->height, file->width);
-            fmt::print("  left margin.: {}\n", file->left_margin);
+        return CLI_Usage();
+    }
 
-            continue;
-        }
+    if (arguments.positional().size() != 1) {
+        return CLI_Usage();
+    }
 
-        if (header->type == BHFHeader::Compression) {
-            compression = BHF_ReadPointer<BHFRecordCompression>(&cursor);
+    BHF::File file;
 
-            std::string table = BHF_StringNormalize(reinterpret_cast<const char *>(compression->table), sizeof(compression->table));
+    if (!CLI_Open(file, arguments.positional()[0])) {
+        return 1;
+    }
 
-            fmt::print("--{{ Compression }}--\n");
-            fmt::print("  type........: {}\n", static_cast<u32>(compression->type));
-            fmt::print("  table.......: |{}| ", table);
+    std::string error;
 
-            for (int i = 0; i < 14; ++i) {
-                fmt::print("{:02x} ", compression->table[i]);
-            }
+    if (arguments.has("--html")) {
+        if (!CLI::Export::html(file, arguments.value("--html"), arguments.jobs(), error)) {
+            fmt::print(stderr, "{}\n", error);
 
-            fmt::print("\n");
+            return 1;
+        }
+    } else if (arguments.has("--ndjson")) {
+        if (!CLI::Export::ndjson(file, stdout, arguments.has("--with-html"), arguments.jobs(), error)) {
+            fmt::print(stderr, "{}\n", error);
 
-            continue;
+            return 1;
         }
+    } else if (arguments.has("--sqlite")) {
+#if defined(USING_SQLITE3)
+        if (!CLI::Export::sqlite(file, arguments.value("--sqlite"), arguments.jobs(), error)) {
+            fmt::print(stderr, "{}\n", error);
 
-        if (header->type == BHFHeader::Context) {
-#if EXTRACT_CONTEXT 
-            fmt::print("--{{ Context }}--\n");
-            u16 count = BHF_ReadValue<u16>(&cursor);
+            return 1;
+        }
+#else
+        fmt::print(stderr, "SQLite3 support is not available in this build.\n");
 
-            fmt::print("  count.......: {}\n", count);
+        return 1;
+#endif
+    } else {
+        return CLI_Usage();
+    }
 
-            sqlite3_stmt *stmt = nullptr;
+    return 0;
+}
 
-            sqlite3_exec(db, "BEGIN_TRANSACTION", nullptr, nullptr, nullptr);
-            sqlite3_prepare(db, "INSERT INTO tbl_context (context_offset) VALUES (?)", -1, &stmt, nullptr);
+static int
+CLI_Batch(int argc, char *argv[])
+{
+    CLI::Arguments arguments;
 
-            for (u16 i = 0; i < count; ++i) {
-                u32 index = static_cast<u8>(*cursor++);
-                index |= static_cast<u32>(static_cast<u8>((*cursor++)) << 8u);
-                index |= static_cast<u32>(static_cast<u8>(*cursor++) << 16u);
+    bool parsed = arguments.parse(argc, argv, {
+          {"--html", true}
+        , {"--sqlite", true}
+        , {"--jobs", true}
+        , {"--memory", true}
+        , {"--timeout", true}
+        , {"--reads", true}
+    });
 
-                sqlite3_reset(stmt);
-                sqlite3_clear_bindings(stmt);
-                sqlite3_bind_int64(stmt, 1, index);
+    if (!parsed) {
+        fmt::print(stderr, "{}\n", arguments.lastError());
 
-                if (sqlite3_step(stmt) == SQLITE_ERROR) {
-                    fmt::print("Context insert error: {}\n", sqlite3_errmsg(db));
-                    fmt::print("Current context: {} {}\n", i, index);
-                }
-            }
+        return CLI_Usage();
+    }
+
+    if (arguments.positional().empty() || arguments.has("--html") == arguments.has("--sqlite")) {
+        return CLI_Usage();
+    }
 
-            sqlite3_finalize(stmt);
-            sqlite3_exec(db, "END_TRANSACTION", nullptr, nullptr, nullptr);
+    CLI::BatchOptions options;
+
+    if (arguments.has("--sqlite")) {
+#if defined(USING_SQLITE3)
+        options.target = CLI::BatchOptions::SQLite;
+        options.output = arguments.value("--sqlite");
 #else
-            cursor += header->length;
+        fmt::print(stderr, "SQLite3 support is not available in this build.\n");
+
+        return 1;
 #endif
-            continue;
-        }
+    } else {
+        options.target = CLI::BatchOptions::HTML;
+        options.output = arguments.value("--html");
+    }
+
+    std::string memory(arguments.value("--memory", "0"));
+    std::string timeout(arguments.value("--timeout", "0"));
+    std::string reads(arguments.value("--reads", "16"));
+
+    options.jobs = arguments.jobs();
+    options.reads_in_flight = static_cast<unsigned>(std::max(1ul, std::strtoul(reads.c_str(), nullptr, 10)));
+    options.memory_budget = std::strtoul(memory.c_str(), nullptr, 10) * 1024 * 1024;
+
+    double timeout_seconds = std::strtod(timeout.c_str(), nullptr);
 
-        if (header->type == BHFHeader::Index) {
-#if EXTRACT_INDEX 
-            fmt::print("--{{ Index }}--\n");
-            u16 count = BHF_ReadValue<u16>(&cursor);
-            fmt::print("  count.......: {}\n", count);
+    if (timeout_seconds > 0.0) {
+        options.timeout = std::chrono::milliseconds(std::max<i64>(1, static_cast<i64>(timeout_seconds * 1000.0)));
+    }
 
-            sqlite3_stmt *stmt = nullptr;
+    return CLI::batch(arguments.positional(), options) > 0 ? 1 : 0;
+}
 
-            sqlite3_exec(db, "BEGIN_TRANSACTION", nullptr, nullptr, nullptr);
-            sqlite3_prepare(db, "INSERT INTO tbl_index (context_id, index_value) VALUES (?, ?)", -1, &stmt, nullptr);
+static int
+CLI_Serve(int argc, char *argv[])
+{
+    CLI::Arguments arguments;
 
-            std::string previous_index;
+    bool parsed = arguments.parse(argc, argv, {
+          {"--port", true}
+        , {"--jobs", true}
+        , {"--cache", true}
+    });
 
-            for (u16 i = 0; i < count; ++i) {
-                u8 length = BHF_ReadValue<u8>(&cursor)  ;
-                u8 carry = static_cast<u8>(length >> 5);
+    if (!parsed) {
+        fmt::print(stderr, "{}\n", arguments.lastError());
 
-                length &= 0x1f;
+        return CLI_Usage();
+    }
 
-                std::string chars;
+    if (arguments.positional().size() != 1) {
+        return CLI_Usage();
+    }
 
-                if (carry) {
-                    chars = previous_index.substr(0, carry);
-                }
+#if defined(__linux__)
+    BHF::File file;
 
-                chars += BHF_StringNormalize(cursor, length);
+    if (!CLI_Open(file, arguments.positional()[0])) {
+        return 1;
+    }
 
-                cursor += length;
+    CLI::ServeOptions options;
 
-                u16 context = BHF_ReadValue<u16>(&cursor);
+    std::string port(arguments.value("--port", "8437"));
+    std::string cache(arguments.value("--cache", "64"));
 
-                sqlite3_reset(stmt);
-                sqlite3_clear_bindings(stmt);
-                sqlite3_bind_int64(stmt, 1, context);
-                sqlite3_bind_text(stmt, 2, chars.c_str(), static_cast<int>(chars.size()), nullptr);
-                
-                if (sqlite3_step(stmt) == SQLITE_ERROR) {
-                    fmt::print("Index insert error: {}\n", sqlite3_errmsg(db));
-                    fmt::print("Current index: {} {}\n", i, chars);
-                }
+    options.port = static_cast<u16>(std::strtoul(port.c_str(), nullptr, 10));
+    options.jobs = arguments.jobs();
+    options.cache_size = std::strtoul(cache.c_str(), nullptr, 10) * 1024 * 1024;
 
-                previous_index = chars;
-            }
+    std::string error;
+
+    if (!CLI::serve(file, options, error)) {
+        fmt::print(stderr, "{}\n", error);
 
-            sqlite3_finalize(stmt);
-            sqlite3_exec(db, "END_TRANSACTION", nullptr, nullptr, nullptr);
+        return 1;
+    }
+
+    return 0;
 #else
-            cursor += header->length;
+    fmt::print(stderr, "serve is only available on Linux.\n");
+
+    return 1;
 #endif
-            continue;
-        }
+}
 
-        if (header->type == BHFHeader::Text) {
-#if EXTRACT_TEXT
-            fmt::print("--{{ Text }}--\n");
-            sqlite3_stmt *stmt = nullptr;
+static void
+CLI_PrintContexts(std::string_view title, const BHF::File::ContextContainer &contexts)
+{
+    fmt::print("\n{}:\n", title);
 
-            sqlite3_prepare(db, "SELECT context_id FROM tbl_context WHERE context_offset = ?", -1, &stmt, nullptr);
-            sqlite3_bind_int64(stmt, 1, offset);
-            sqlite3_step(stmt);
+    for (BHF::File::ContextType context : contexts) {
+        fmt::print("  {}\n", context);
+    }
+}
 
-            context_id = sqlite3_column_int64(stmt, 0);
+static void
+CLI_PrintLinks(std::string_view title, const BHF::LinkGraph::LinkContainer &links)
+{
+    fmt::print("\n{}:\n", title);
 
-            sqlite3_finalize(stmt);
+    for (const BHF::LinkGraph::Link &link : links) {
+        fmt::print("  {} -> {}\n", link.source, link.target);
+    }
+}
 
-            sqlite3_exec(db, "BEGIN_TRANSACTION", nullptr, nullptr, nullptr);
-            sqlite3_prepare(db, "INSERT INTO tbl_text (context_id, text_value) VALUES (?, ?)", -1, &stmt, nullptr);
+static int
+CLI_Graph(int argc, char *argv[])
+{
+    CLI::Arguments arguments;
 
-            std::string text = BHF_Uncompress(&cursor, header->length, compression);
+    bool parsed = arguments.parse(argc, argv, {
+          {"--list", false}
+        , {"--jobs", true}
+    });
 
-            sqlite3_bind_int64(stmt, 1, context_id);
-            sqlite3_bind_blob(stmt, 2, text.c_str(), static_cast<int>(text.size()), nullptr);
+    if (!parsed) {
+        fmt::print(stderr, "{}\n", arguments.lastError());
 
-            if (sqlite3_step(stmt) == SQLITE_ERROR) {
-                fmt::print("Text insert error: {}\n", sqlite3_errmsg(db));
-                fmt::print("Current context: {}\n", context_id);
-            }
+        return CLI_Usage();
+    }
 
-            sqlite3_finalize(stmt);
+    if (arguments.positional().size() != 1) {
+        return CLI_Usage();
+    }
 
-            sqlite3_exec(db, "END_TRANSACTION", nullptr, nullptr, nullptr);
-#else
-            if (offset == 1510071) {
-                std::string text = BHF_Uncompress(&cursor, header->length, compression);
+    BHF::File file;
 
-                fmt::print("TEXT: {}", text);
-            } else {
-                cursor += header->length;
-            }
-#endif
-            continue;
-        }
+    if (!CLI_Open(file, arguments.positional()[0])) {
+        return 1;
+    }
 
-        if (header->type == BHFHeader::Keyword) {
-#if EXTRACT_TEXT
-            fmt::print("--{{ Keyword }}--\n");
-            BHFKeyword *keyword = BHF_ReadPointer<BHFKeyword>(&cursor);
-            fmt::print("  count.......: {}\n", keyword->count);
+    BHF::LinkGraph graph(file, arguments.jobs());
 
-            sqlite3_stmt *stmt = nullptr;
+    BHF::File::ContextType main_index = file.fileHeader().main_index;
 
-            sqlite3_exec(db, "BEGIN_TRANSACTION", nullptr, nullptr, nullptr);
-            sqlite3_prepare(db, "INSERT INTO tbl_keyword (context_id, keyword_up_context, keyword_down_context) VALUES (?, ?, ?)", -1, &stmt, nullptr);
+    usize topics = 0;
+    BHF::File::ContextType most_linked = -1;
 
-            sqlite3_bind_int64(stmt, 1, context_id);
+    for (usize c = 0; c < graph.size(); ++c) {
+        BHF::File::ContextType context = static_cast<BHF::File::ContextType>(c);
 
-            if (keyword->up_context > 0) {
-                sqlite3_bind_int64(stmt, 2, keyword->up_context);
-            }
+        if (graph.hasTopic(context)) {
+            ++topics;
 
-            if (keyword->down_context > 0) {
-                sqlite3_bind_int64(stmt, 3, keyword->down_context);
+            if (most_linked < 0 || graph.inDegree(context) > graph.inDegree(most_linked)) {
+                most_linked = context;
             }
+        }
+    }
 
-            if (sqlite3_step(stmt) == SQLITE_ERROR) {
-                fmt::print("Keyword insert error: {}\n", sqlite3_errmsg(db));
-            }
-            sqlite3_finalize(stmt);
-            sqlite3_exec(db, "END_TRANSACTION", nullptr, nullptr, nullptr);
+    BHF::LinkGraph::LinkContainer dangling = graph.dangling();
+    BHF::File::ContextContainer orphans = graph.orphans();
+    BHF::File::ContextContainer unreachable = graph.unreachable(main_index);
+    BHF::LinkGraph::ChainContainer chains = graph.chains();
+    BHF::LinkGraph::LinkContainer broken = graph.brokenChains();
 
-            sqlite3_exec(db, "BEGIN_TRANSACTION", nullptr, nullptr, nullptr);
-            if (sqlite3_prepare(db, "INSERT INTO tbl_keyword_list (context_id, keyword_index, keyword_context) VALUES (?, ?, ?)", -1, &stmt, nullptr) == SQLITE_ERROR) {
-                fmt::print("PREPARE ERROR: {}\n", sqlite3_errmsg(db));
-                exit(0);
-            }
+    usize longest = 0;
 
-            for (i32 index = 0; index < keyword->count; ++index) {
-                sqlite3_reset(stmt);
-                sqlite3_clear_bindings(stmt);
-                sqlite3_bind_int64(stmt, 1, context_id);
-                sqlite3_bind_int64(stmt, 2, index);
-                sqlite3_bind_int64(stmt, 3, BHF_ReadValue<u16>(&cursor));
-                    
-                if (sqlite3_step(stmt) == SQLITE_ERROR) {
-                    fmt::print("Keyword index insert error: {}\n", sqlite3_errmsg(db));
-                }
-            }
+    for (const BHF::File::ContextContainer &chain : chains) {
+        longest = std::max(longest, chain.size());
+    }
 
-            sqlite3_finalize(stmt);
-            sqlite3_exec(db, "END_TRANSACTION", nullptr, nullptr, nullptr);
-#else
-            cursor += header->length;
-#endif
-            continue;
-        }
+    fmt::print("topics........: {}\n", topics);
+    fmt::print("links.........: {}\n", graph.linkCount());
+    fmt::print("most linked...: {} ({} links)\n", most_linked, graph.inDegree(most_linked));
+    fmt::print("dangling......: {}\n", dangling.size());
+    fmt::print("orphans.......: {}\n", orphans.size());
+    fmt::print("unreachable...: {} (from main index {})\n", unreachable.size(), main_index);
+    fmt::print("chains........: {} (longest {})\n", chains.size(), longest);
+    fmt::print("broken chains.: {}\n", broken.size());
 
-        if (header->type == BHFHeader::IndexTags) {
-            fmt::print("--{{ IndexTags }}--\n");
+    if (arguments.has("--list")) {
+        CLI_PrintLinks("dangling links", dangling);
+        CLI_PrintContexts("orphan topics", orphans);
+        CLI_PrintContexts("unreachable topics", unreachable);
 
-            cursor += header->length;
+        fmt::print("\nchains:\n");
 
-            continue;
+        for (const BHF::File::ContextContainer &chain : chains) {
+            fmt::print("  {}\n", fmt::join(chain, " -> "));
         }
 
-        // ERROR: should not be reachable
-        fmt::print("header........: {} {}\n", static_cast<u32>(header->type), header->length);
+        CLI_PrintLinks("broken chain links (down link not matched by an up link)", broken);
     }
 
-    sqlite3_close(db);
-
     return 0;
 }
 
-std::string_view
-BHF_ReadString(char **buffer, size_t size)
+static int
+CLI_Lookup(int argc, char *argv[])
 {
-    if (size == 0) {
-        size = strlen(*buffer) + 1;
+    CLI::Arguments arguments;
+
+    if (!arguments.parse(argc, argv, {{"--prefix", false}}) || arguments.positional().size() < 2) {
+        return CLI_Usage();
     }
 
-    std::string_view result(*buffer, size);
-    *buffer += result.length();
+    const std::vector<std::string_view> &positional = arguments.positional();
 
-    return result;
-}
+    BHF::Catalog catalog;
 
-template<typename T>
-T *
-BHF_ReadPointer(char **buffer)
-{
-    T *result = reinterpret_cast<T *>(*buffer);
-    *buffer += sizeof(T);
+    if (!catalog.open({positional.begin() + 1, positional.end()})) {
+        fmt::print(stderr, "{}\n", catalog.lastError());
 
-    return result;
-}
+        return 1;
+    }
 
-template<typename T>
-T
-BHF_ReadValue(char **buffer)
-{
-    T result = *reinterpret_cast<T *>(*buffer);
-    *buffer += sizeof(T);
+    BHF::Catalog::EntryContainer entries = arguments.has("--prefix") ? catalog.findPrefix(positional[0]) : catalog.find(positional[0]);
+
+    for (const BHF::Catalog::Entry &entry : entries) {
+        fmt::print("{}: {} -> {}\n", catalog.filepath(entry.file), entry.key, entry.context);
+    }
 
-    return result;
+    return entries.empty() ? 1 : 0;
 }
 
-// reference: https://en.wikipedia.org/wiki/Code_page_437
-const char *
-BHF_CP437toUTF8(u8 character)
+static int
+CLI_Stream(int argc, char *argv[])
 {
-    static char default_char[2] = {0, 0};
-
-    switch (character) {
-        case 0x01: return "\u263a";
-        case 0x02: return "\u263b";
-        case 0x03: return "\u2665";
-        case 0x04: return "\u2666";
-        case 0x05: return "\u2663";
-        case 0x06: return "\u2660";
-        case 0x07: return "\u2022";
-        case 0x08: return "\u25d8";
-        case 0x09: return "\u25cb";
-        case 0x0a: return "\u25d9";
-        case 0x0b: return "\u2642";
-        case 0x0c: return "\u2640";
-        case 0x0d: return "\u266a";
-        case 0x0e: return "\u266b";
-        case 0x0f: return "\u263c";
-
-        case 0x10: return "\u25ba";
-        case 0x11: return "\u25c4";
-        case 0x12: return "\u2195";
-        case 0x13: return "\u203c";
-        case 0x14: return "\u00b6";
-        case 0x15: return "\u00a7";
-        case 0x16: return "\u25ac";
-        case 0x17: return "\u21a8";
-        case 0x18: return "\u2191";
-        case 0x19: return "\u2193";
-        case 0x1a: return "\u2192";
-        case 0x1b: return "\u2190";
-        case 0x1c: return "\u221f";
-        case 0x1d: return "\u2194";
-        case 0x1e: return "\u25b2";
-        case 0x1f: return "\u25bc";
-
-        case 0x7f: return "\u2302";
-
-        case 0x80: return "\u00c7";
-        case 0x81: return "\u00fc";
-        case 0x82: return "\u00e9";
-        case 0x83: return "\u00e2";
-        case 0x84: return "\u00e4";
-        case 0x85: return "\u00e0";
-        case 0x86: return "\u00e5";
-        case 0x87: return "\u00e7";
-        case 0x88: return "\u00ea";
-        case 0x89: return "\u00eb";
-        case 0x8a: return "\u00e8";
-        case 0x8b: return "\u00ef";
-        case 0x8c: return "\u00ee";
-        case 0x8d: return "\u00ec";
-        case 0x8e: return "\u00c4";
-        case 0x8f: return "\u00c5";
-
-        case 0x90: return "\u00c9";
-        case 0x91: return "\u00e6";
-        case 0x92: return "\u00c6";
-        case 0x93: return "\u00f4";
-        case 0x94: return "\u00f6";
-        case 0x95: return "\u00f2";
-        case 0x96: return "\u00fb";
-        case 0x97: return "\u00f9";
-        case 0x98: return "\u00ff";
-        case 0x99: return "\u00d6";
-        case 0x9a: return "\u00dc";
-        case 0x9b: return "\u00a2";
-        case 0x9c: return "\u00a3";
-        case 0x9d: return "\u00a5";
-        case 0x9e: return "\u20a7";
-        case 0x9f: return "\u0192";
-
-        case 0xa0: return "\u00e1";
-        case 0xa1: return "\u00ed";
-        case 0xa2: return "\u00f3";
-        case 0xa3: return "\u00fa";
-        case 0xa4: return "\u00f1";
-        case 0xa5: return "\u00d1";
-        case 0xa6: return "\u00aa";
-        case 0xa7: return "\u00ba";
-        case 0xa8: return "\u00bf";
-        case 0xa9: return "\u2310";
-        case 0xaa: return "\u00ac";
-        case 0xab: return "\u00bd";
-        case 0xac: return "\u00bc";
-        case 0xad: return "\u00a1";
-        case 0xae: return "\u00ab";
-        case 0xaf: return "\u00bb";
-
-        case 0xb0: return "\u2591";
-        case 0xb1: return "\u2592";
-        case 0xb2: return "\u2593";
-        case 0xb3: return "\u2502";
-        case 0xb4: return "\u2524";
-        case 0xb5: return "\u2561";
-        case 0xb6: return "\u2562";
-        case 0xb7: return "\u2556";
-        case 0xb8: return "\u2555";
-        case 0xb9: return "\u2563";
-        case 0xba: return "\u2551";
-        case 0xbb: return "\u2557";
-        case 0xbc: return "\u255d";
-        case 0xbd: return "\u255c";
-        case 0xbe: return "\u255b";
-        case 0xbf: return "\u2510";
-
-        case 0xc0: return "\u2514";
-        case 0xc1: return "\u2534";
-        case 0xc2: return "\u252c";
-        case 0xc3: return "\u251c";
-        case 0xc4: return "\u2500";
-        case 0xc5: return "\u253c";
-        case 0xc6: return "\u255e";
-        case 0xc7: return "\u255f";
-        case 0xc8: return "\u255a";
-        case 0xc9: return "\u2554";
-        case 0xca: return "\u2569";
-        case 0xcb: return "\u2566";
-        case 0xcc: return "\u2560";
-        case 0xcd: return "\u2550";
-        case 0xce: return "\u256c";
-        case 0xcf: return "\u2567";
-
-        case 0xd0: return "\u2568";
-        case 0xd1: return "\u2564";
-        case 0xd2: return "\u2565";
-        case 0xd3: return "\u2559";
-        case 0xd4: return "\u2558";
-        case 0xd5: return "\u2552";
-        case 0xd6: return "\u2553";
-        case 0xd7: return "\u256b";
-        case 0xd8: return "\u256a";
-        case 0xd9: return "\u2518";
-        case 0xda: return "\u250c";
-        case 0xdb: return "\u2588";
-        case 0xdc: return "\u2584";
-        case 0xdd: return "\u258c";
-        case 0xde: return "\u2590";
-        case 0xdf: return "\u2580";
-
-        case 0xe0: return "\u03b1";
-        case 0xe1: return "\u00df";
-        case 0xe2: return "\u0393";
-        case 0xe3: return "\u03c0";
-        case 0xe4: return "\u03a3";
-        case 0xe5: return "\u03c3";
-        case 0xe6: return "\u00b5";
-        case 0xe7: return "\u03c4";
-        case 0xe8: return "\u03a6";
-        case 0xe9: return "\u0398";
-        case 0xea: return "\u03a9";
-        case 0xeb: return "\u03b4";
-        case 0xec: return "\u221e";
-        case 0xed: return "\u03c6";
-        case 0xee: return "\u03b5";
-        case 0xef: return "\u2229";
-
-        case 0xf0: return "\u2261";
-        case 0xf1: return "\u00b1";
-        case 0xf2: return "\u2265";
-        case 0xf3: return "\u2264";
-        case 0xf4: return "\u2320";
-        case 0xf5: return "\u2321";
-        case 0xf6: return "\u00f7";
-        case 0xf7: return "\u2248";
-        case 0xf8: return "\u00b0";
-        case 0xf9: return "\u2219";
-        case 0xfa: return "\u00b7";
-        case 0xfb: return "\u221a";
-        case 0xfc: return "\u207f";
-        case 0xfd: return "\u00b2";
-        case 0xfe: return "\u25a0";
-        case 0xff: return "\u00a0";
-
-        default: {
-            if (character == 0x00) {
-                default_char[0] = '\n';
-            } else if (character < 0x20 || character > 0x7e) {
-                // ERROR
-            } else {
-                default_char[0] = static_cast<char>(character);
-            }
+    CLI::Arguments arguments;
 
-            return default_char;
+    if (!arguments.parse(argc, argv, {{"--format", true}}) || arguments.positional().size() > 1) {
+        return CLI_Usage();
+    }
+
+    BHF::File::TextFormat format = BHF::File::PlainText;
+
+    if (!CLI_Format(arguments.value("--format", "plain"), format)) {
+        return CLI_Usage();
+    }
+
+    std::FILE *input = stdin;
+
+    if (!arguments.positional().empty() && arguments.positional()[0] != "-") {
+        std::string filepath(arguments.positional()[0]);
+
+        input = std::fopen(filepath.c_str(), "rb");
+
+        if (!input) {
+            fmt::print(stderr, "Can't open file '{}'.\n", filepath);
+
+            return 1;
         }
     }
-}
 
-std::string
-BHF_StringNormalize(const char *buffer, size_t size)
-{
-    std::string result;
+    std::string error;
 
-    result.reserve(size);
+    bool result = CLI::Export::stream(input, stdout, format, error);
 
-    for (size_t i = 0; i < size; ++i) {
-        result += BHF_CP437toUTF8(static_cast<u8>(buffer[i]));
+    if (input != stdin) {
+        std::fclose(input);
     }
 
-    return result;
+    if (!result) {
+        fmt::print(stderr, "{}\n", error);
 
+        return 1;
+    }
+
+    return 0;
 }
 
-std::string
-BHF_Uncompress(char **buffer, size_t size, const BHFRecordCompression *compression)
+// Compares what the two files return for every context, index key and tag.
+static usize
+CLI_CompareFiles(const BHF::File &original, const BHF::File &rewritten)
 {
-    std::string result;
-
-    const u8 *nibbles = reinterpret_cast<const u8 *>(*buffer);
-    const u8 *end = nibbles + size;
+    usize differences = 0;
 
-    i32 count = 0;
-    i64 i = 0;
+    auto report = [&differences](std::string_view what) -> void {
+        if (++differences <= 10) {
+            fmt::print(stderr, "{} differs\n", what);
+        }
+    };
 
-    while (nibbles < end) {
-        u8 nibble = (++i & 0x01) ? *nibbles & 0x0f : (*nibbles++ >> 4) & 0x0f;
-        u8 value = 0;
+    const BHF::File::ContextContainer &before = original.context();
+    const BHF::File::ContextContainer &after = rewritten.context();
 
-        if (nibble == kNibbleRaw) {
-            u8 n1 = (++i & 0x01) ? *nibbles & 0x0f : (*nibbles++ >> 4) & 0x0f;
-            u8 n2 = (++i & 0x01) ? *nibbles & 0x0f : (*nibbles++ >> 4) & 0x0f;
+    if (before.size() != after.size()) {
+        report("context count");
+    }
 
-            value = static_cast<u8>((n2 << 4) | n1);
-            count += 1;
-        } else if (nibble == kNibbleRep) {
-            count = ((++i & 0x01) ? *nibbles & 0x0f : (*nibbles++ >> 4) & 0x0f) + 1;
+    for (usize c = 0; c < std::min(before.size(), after.size()); ++c) {
+        if (before[c] < 0 || after[c] < 0) {
+            if (before[c] != after[c]) {
+                report(fmt::format("context {}", c));
+            }
 
             continue;
-        } else {
-            value = compression->table[nibble];
-            count += 1;
         }
 
-        if (value == 0x01 || value == 0x02) {
-            count = 0;
+        BHF::File::KeywordType keywords_before = original.keywords(before[c]);
+        BHF::File::KeywordType keywords_after = rewritten.keywords(after[c]);
 
-            continue;
+        if (original.text(before[c]) != rewritten.text(after[c])
+            || original.text(before[c], BHF::File::HTML) != rewritten.text(after[c], BHF::File::HTML)
+            || keywords_before.up != keywords_after.up
+            || keywords_before.down != keywords_after.down
+            || keywords_before.contexts != keywords_after.contexts) {
+            report(fmt::format("context {}", c));
         }
+    }
 
-        const char *out = BHF_CP437toUTF8(value);
+    const BHF::File::IndexContainer &index = rewritten.index();
 
-        while (count > 0) {
-            result += out;
+    if (original.index().size() != index.size()) {
+        report("index count");
+    }
 
-            --count;
+    for (usize i = 0; i < std::min(original.index().size(), index.size()); ++i) {
+        if (original.index()[i].index != index[i].index || original.index()[i].context != index[i].context) {
+            report(fmt::format("index key '{}'", original.index()[i].index));
         }
     }
 
-    *buffer += size;
+    const BHF::File::IndexTagContainer &tags = rewritten.indexTags();
 
-    return result;
+    if (original.indexTags().size() != tags.size()) {
+        report("index tag count");
+    }
+
+    for (usize i = 0; i < std::min(original.indexTags().size(), tags.size()); ++i) {
+        if (original.indexTags()[i].index != tags[i].index || original.indexTags()[i].tag != tags[i].tag) {
+            report(fmt::format("index tag '{}'", original.indexTags()[i].tag));
+        }
+    }
+
+    return differences;
 }
 
-FileData
-File_Read(std::string_view filepath)
+static int
+CLI_Rewrite(int argc, char *argv[])
 {
-    FileData result {0, {nullptr, free}};
+    CLI::Arguments arguments;
 
-    struct stat file_stat;
+    if (!arguments.parse(argc, argv, {{"--jobs", true}})) {
+        fmt::print(stderr, "{}\n", arguments.lastError());
 
-    if (stat(filepath.data(), &file_stat) != 0) {
-        fmt::print("Can't get file information for '{}'\n", filepath);
-        exit(1);
+        return CLI_Usage();
     }
 
-    result.size = file_stat.st_size;
-    result.data.reset(reinterpret_cast<char *>(malloc(static_cast<size_t>(file_stat.st_size + 1))));
+    if (arguments.positional().size() != 2) {
+        return CLI_Usage();
+    }
+
+    BHF::File file;
+
+    if (!CLI_Open(file, arguments.positional()[0])) {
+        return 1;
+    }
+
+    BHF::Writer writer;
+
+    if (!writer.load(file) || !writer.write(arguments.positional()[1], arguments.jobs())) {
+        fmt::print(stderr, "{}\n", writer.lastError());
 
-    if (!result.data) {
-        fmt::print("Can't allocate {} bytes", file_stat.st_size);
-        exit(2);
+        return 1;
     }
 
-    FILE *input_file = fopen(filepath.data(), "rb");
+    BHF::File rewritten;
 
-    if (!input_file) {
-        fmt::print("Can't open input file '{}'\n", filepath);
-        exit(3);
+    if (!CLI_Open(rewritten, arguments.positional()[1])) {
+        return 1;
     }
 
-    u64 bytes_read = fread(result.data.get(), 1, static_cast<size_t>(file_stat.st_size), input_file);
+    usize differences = CLI_CompareFiles(file, rewritten);
 
-    fclose(input_file);
+    std::error_code error;
+    std::uintmax_t original_size = std::filesystem::file_size(std::string(arguments.positional()[0]), error);
 
-    if (bytes_read != static_cast<u64>(file_stat.st_size)) {
-        fmt::print("Trying to read {} bytes from input but got {} bytes", file_stat.st_size, bytes_read);
-        exit(4);
+    const BHF::Writer::Statistics &statistics = writer.statistics();
+
+    auto percent = [&statistics](usize size) -> double {
+        return statistics.text_size > 0 ? 100.0 * static_cast<double>(size) / static_cast<double>(statistics.text_size) : 0.0;
+    };
+
+    fmt::print("topics........: {}\n", writer.topics().size());
+    fmt::print("text..........: {} bytes\n", statistics.text_size);
+    fmt::print("original table: {} bytes ({:.1f}%) {:02x}\n", statistics.reference_size, percent(statistics.reference_size), fmt::join(file.compression().table, " "));
+    fmt::print("new table.....: {} bytes ({:.1f}%) {:02x}\n", statistics.compressed_size, percent(statistics.compressed_size), fmt::join(writer.compression().table, " "));
+    fmt::print("file size.....: {} -> {} bytes\n", original_size, statistics.file_size);
+
+    if (differences > 0) {
+        fmt::print("round trip....: {} differences\n", differences);
+
+        return 1;
     }
 
-    result.data.get()[result.size] = '\0';
+    fmt::print("round trip....: ok\n");
 
-    return result;
+    return 0;
 }
-#else
-#include "bhf/file.hpp"
 
-int
-main()
+static int
+CLI_Diff(int argc, char *argv[])
 {
-    BHF::File help("data/tchelp.tch");
+    CLI::Arguments arguments;
 
-    std::string text = help.text(1510071);
+    bool parsed = arguments.parse(argc, argv, {
+          {"--summary", false}
+        , {"--context", true}
+        , {"--jobs", true}
+    });
 
-    fmt::print("{}", text);
+    if (!parsed) {
+        fmt::print(stderr, "{}\n", arguments.lastError());
 
-    return 0;
+        return CLI_Usage();
+    }
+
+    if (arguments.positional().size() != 2) {
+        return CLI_Usage();
+    }
+
+    BHF::File before;
+    BHF::File after;
+
+    if (!CLI_Open(before, arguments.positional()[0]) || !CLI_Open(after, arguments.positional()[1])) {
+        return 2;
+    }
+
+    CLI::DiffOptions options;
+    options.jobs = arguments.jobs();
+    options.summary = arguments.has("--summary");
+    options.context_lines = std::strtoul(std::string(arguments.value("--context", "3")).c_str(), nullptr, 10);
+
+    fmt::print("--- {}\n+++ {}\n", arguments.positional()[0], arguments.positional()[1]);
+
+    CLI::DiffSummary summary = CLI::diff(before, after, options);
+
+    if (summary.damaged > 0) {
+        return 2;
+    }
+
+    return summary.added + summary.removed + summary.changed > 0 ? 1 : 0;
+}
+
+int
+main(int argc, char *argv[])
+{
+    if (argc < 2) {
+        return CLI_Usage();
+    }
+
+    std::string_view command = argv[1];
+
+    if (command == "info") {
+        return CLI_Info(argc - 2, argv + 2);
+    } else if (command == "text") {
+        return CLI_Text(argc - 2, argv + 2);
+    } else if (command == "export") {
+        return CLI_Export(argc - 2, argv + 2);
+    } else if (command == "batch") {
+        return CLI_Batch(argc - 2, argv + 2);
+    } else if (command == "serve") {
+        return CLI_Serve(argc - 2, argv + 2);
+    } else if (command == "graph") {
+        return CLI_Graph(argc - 2, argv + 2);
+    } else if (command == "lookup") {
+        return CLI_Lookup(argc - 2, argv + 2);
+    } else if (command == "stream") {
+        return CLI_Stream(argc - 2, argv + 2);
+    } else if (command == "rewrite") {
+        return CLI_Rewrite(argc - 2, argv + 2);
+    } else if (command == "diff") {
+        return CLI_Diff(argc - 2, argv + 2);
+    }
+
+    return CLI_Usage();
 }
-#endif
@@ -0,0 +1,216 @@
+// SPDX-License-Identifier: MIT
+// Copyright (c) 2022 Gustavo Ribeiro Croscato
+
+#include <charconv>
+
+#include "bhf/hash.hpp"
+#include "manifest.hpp"
+
+namespace CLI {
+
+static constexpr std::string_view kManifestMagic = "bhf-manifest 1";
+
+static bool
+Manifest_ReadLine(std::FILE *file, std::string &line) noexcept
+{
+    line.clear();
+
+    int c = 0;
+
+    while ((c = std::fgetc(file)) != EOF && c != '\n') {
+        line += static_cast<char>(c);
+    }
+
+    return c != EOF || !line.empty();
+}
+
+// "<context> <hash> <output>", hash in hexadecimal.
+static bool
+Manifest_ParseEntry(std::string_view line, usize &context, Manifest::Entry &entry) noexcept
+{
+    const char *begin = line.data();
+    const char *end = line.data() + line.size();
+
+    auto [context_end, context_error] = std::from_chars(begin, end, context);
+
+    if (context_error != std::errc() || context_end == end || *context_end != ' ') {
+        return false;
+    }
+
+    auto [hash_end, hash_error] = std::from_chars(context_end + 1, end, entry.hash, 16);
+
+    if (hash_error != std::errc() || hash_end == end || *hash_end != ' ') {
+        return false;
+    }
+
+    entry.output.assign(hash_end + 1, end);
+
+    return !entry.output.empty();
+}
+
+bool
+Manifest::load(const std::filesystem::path &path) noexcept
+{
+    global = 0;
+    entries.clear();
+
+    std::FILE *file = std::fopen(path.c_str(), "rb");
+
+    if (!file) {
+        return false;
+    }
+
+    std::string line;
+
+    bool result = Manifest_ReadLine(file, line) && line == kManifestMagic && Manifest_ReadLine(file, line);
+
+    if (result) {
+        auto [end, error] = std::from_chars(line.data(), line.data() + line.size(), global, 16);
+
+        result = error == std::errc() && end == line.data() + line.size();
+    }
+
+    while (result && Manifest_ReadLine(file, line)) {
+        usize context = 0;
+        Entry entry;
+
+        result = Manifest_ParseEntry(line, context, entry);
+
+        if (result) {
+            if (context >= entries.size()) {
+                entries.resize(context + 1);
+            }
+
+            entries[context] = std::move(entry);
+        }
+    }
+
+    std::fclose(file);
+
+    if (!result) {
+        global = 0;
+        entries.clear();
+    }
+
+    return result;
+}
+
+// Written next to the destination and renamed over it, an interrupted save
+// leaves the previous manifest in place.
+bool
+Manifest::save(const std::filesystem::path &path, std::string &error) const noexcept
+{
+    std::string content = fmt::format("{}\n{:x}\n", kManifestMagic, global);
+
+    for (EntryContainer::size_type i = 0; i < entries.size(); ++i) {
+        if (!entries[i].output.empty()) {
+            fmt::format_to(std::back_inserter(content), "{} {:x} {}\n", i, entries[i].hash, entries[i].output);
+        }
+    }
+
+    std::filesystem::path temporary = path;
+    temporary += ".tmp";
+
+    std::FILE *file = std::fopen(temporary.c_str(), "wb");
+
+    if (!file) {
+        error = fmt::format("Error creating file {}.", temporary.string());
+
+        return false;
+    }
+
+    bool result = std::fwrite(content.data(), 1, content.size(), file) == content.size();
+
+    result = std::fclose(file) == 0 && result;
+
+    std::error_code code;
+
+    if (result) {
+        std::filesystem::rename(temporary, path, code);
+
+        result = !code;
+    }
+
+    if (!result) {
+        error = fmt::format("Error writing file {}.", path.string());
+
+        std::filesystem::remove(temporary, code);
+    }
+
+    return result;
+}
+
+bool
+Manifest::isUnchanged(BHF::File::ContextType context, u64 hash, std::string_view output, const std::filesystem::path &root) const noexcept
+{
+    if (context < 0 || static_cast<usize>(context) >= entries.size()) {
+        return false;
+    }
+
+    const Entry &entry = entries[static_cast<usize>(context)];
+
+    if (entry.hash != hash || entry.output != output) {
+        return false;
+    }
+
+    // Removed by hand since, it is written again.
+    std::error_code code;
+
+    return std::filesystem::is_regular_file(root / entry.output, code);
+}
+
+u64
+manifestGlobalHash(const BHF::File &file, u64 seed) noexcept
+{
+    const BHF::FileHeader &file_header = file.fileHeader();
+    const BHF::Compression &compression = file.compression();
+    const BHF::File::ContextContainer &context = file.context();
+
+    // Field by field, largest_record follows the record sizes and the
+    // padding is not ours to hash.
+    u64 result = BHF::hash64(&file_header.options, sizeof(file_header.options), seed);
+
+    result = BHF::hash64(&file_header.main_index, sizeof(file_header.main_index), result);
+    result = BHF::hash64(&file_header.height, sizeof(file_header.height), result);
+    result = BHF::hash64(&file_header.width, sizeof(file_header.width), result);
+    result = BHF::hash64(&file_header.left_margin, sizeof(file_header.left_margin), result);
+    result = BHF::hash64(&compression, sizeof(compression), result);
+
+    // Which contexts have a topic, not where it is: a topic growing moves
+    // every later offset without changing any other page.
+    std::vector<u8> has_topic(context.size());
+
+    for (usize i = 0; i < context.size(); ++i) {
+        has_topic[i] = context[i] >= 0;
+    }
+
+    result = BHF::hash64(has_topic.data(), has_topic.size(), result);
+
+    for (const BHF::File::IndexType &index : file.index()) {
+        result = BHF::hash64(index.index, result ^ static_cast<u64>(index.context));
+    }
+
+    return result;
+}
+
+void
+manifestRemoveStale(const Manifest &previous, const Manifest &current, const std::filesystem::path &root) noexcept
+{
+    for (Manifest::EntryContainer::size_type i = 0; i < previous.entries.size(); ++i) {
+        const std::string &output = previous.entries[i].output;
+
+        if (output.empty()) {
+            continue;
+        }
+
+        if (i < current.entries.size() && current.entries[i].output == output) {
+            continue;
+        }
+
+        std::error_code code;
+
+        std::filesystem::remove(root / output, code);
+    }
+}
+
+} // namespace CLI
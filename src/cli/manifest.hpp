@@ -0,0 +1,49 @@
+// SPDX-License-Identifier: MIT
+// Copyright (c) 2022 Gustavo Ribeiro Croscato
+
+#ifndef BHFCONVERTER_SRC_CLI_MANIFEST_HPP
+#define BHFCONVERTER_SRC_CLI_MANIFEST_HPP 1
+
+#include <filesystem>
+
+#include "bhf/file.hpp"
+
+namespace CLI {
+
+// What an export wrote for every context, stored next to the output so the
+// following export of the same help set only redoes the topics that changed.
+//
+// `global` covers everything a page depends on besides its own records
+// (header, compression, which contexts have a topic, index); when it differs
+// nothing of the previous export can be reused.
+struct Manifest {
+    struct Entry {
+        u64 hash = 0;
+        std::string output;
+    };
+
+    using EntryContainer = std::vector<Entry>;
+
+    // A missing or unreadable manifest leaves it empty and returns false.
+    bool load(const std::filesystem::path &path) noexcept;
+    bool save(const std::filesystem::path &path, std::string &error) const noexcept;
+
+    // Entry of a context that produced `output` with the same hash before,
+    // and the file is still there under `root`.
+    bool isUnchanged(BHF::File::ContextType context, u64 hash, std::string_view output, const std::filesystem::path &root) const noexcept;
+
+    u64 global = 0;
+
+    // Indexed by context number, an empty output means no entry.
+    EntryContainer entries;
+};
+
+// Hash of the parts of a help file shared by all of its topics.
+u64 manifestGlobalHash(const BHF::File &file, u64 seed) noexcept;
+
+// Removes the outputs of `previous` that `current` no longer produces.
+void manifestRemoveStale(const Manifest &previous, const Manifest &current, const std::filesystem::path &root) noexcept;
+
+} // namespace CLI
+
+#endif // BHFCONVERTER_SRC_CLI_MANIFEST_HPP
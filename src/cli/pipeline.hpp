@@ -0,0 +1,232 @@
+// SPDX-License-Identifier: MIT
+// Copyright (c) 2022 Gustavo Ribeiro Croscato
+
+#ifndef BHFCONVERTER_SRC_CLI_PIPELINE_HPP
+#define BHFCONVERTER_SRC_CLI_PIPELINE_HPP 1
+
+#include <algorithm>
+#include <atomic>
+#include <chrono>
+#include <condition_variable>
+#include <mutex>
+#include <numeric>
+#include <optional>
+#include <thread>
+#include <type_traits>
+
+namespace CLI {
+
+// Time limit of a long running job. Nothing is interrupted, the job checks
+// isExpired() between items and gives up on its own.
+struct Deadline {
+    using Clock = std::chrono::steady_clock;
+
+    static Deadline after(std::chrono::milliseconds duration) noexcept
+    {
+        return {Clock::now() + duration};
+    }
+
+    bool isExpired() const noexcept
+    {
+        return at && Clock::now() >= *at;
+    }
+
+    std::optional<Clock::time_point> at;
+};
+
+// Calls work(worker, i) for every i in [0, count) on `jobs` worker threads,
+// `worker` is in [0, jobs) so callers can keep per thread scratch data.
+// Items are handed out one at a time, in index order. When work() returns
+// false the remaining items are skipped and the function returns false.
+template<typename Work>
+bool
+parallelFor(usize count, unsigned jobs, Work &&work) noexcept
+{
+    std::atomic<usize> next = 0;
+    std::atomic<bool> result = true;
+
+    auto worker = [&](unsigned id) -> void {
+        while (result.load(std::memory_order_relaxed)) {
+            usize current = next.fetch_add(1, std::memory_order_relaxed);
+
+            if (current >= count) {
+                return;
+            }
+
+            if (!work(id, current)) {
+                result = false;
+            }
+        }
+    };
+
+    // No more threads than items.
+    unsigned threads = static_cast<unsigned>(std::min<usize>(jobs > 0 ? jobs : 1, count));
+
+    std::vector<std::thread> workers;
+    workers.reserve(threads);
+
+    for (unsigned i = 0; i < threads; ++i) {
+        workers.emplace_back(worker, i);
+    }
+
+    for (std::thread &thread : workers) {
+        thread.join();
+    }
+
+    return result;
+}
+
+// parallelFor() for independent items of very uneven cost, such as topics
+// written to files of their own: items start largest cost(i) first, so a
+// big one is never left alone at the end with the other threads idle.
+template<typename Cost, typename Work>
+bool
+parallelForByCost(usize count, unsigned jobs, Cost &&cost, Work &&work) noexcept
+{
+    std::vector<usize> costs(count);
+    std::vector<usize> order(count);
+
+    for (usize i = 0; i < count; ++i) {
+        costs[i] = cost(i);
+    }
+
+    std::iota(order.begin(), order.end(), usize{0});
+
+    std::stable_sort(order.begin(), order.end(), [&costs](usize a, usize b) {
+        return costs[a] > costs[b];
+    });
+
+    return parallelFor(count, jobs, [&order, &work](unsigned worker, usize i) -> bool {
+        return work(worker, order[i]);
+    });
+}
+
+// Calls produce(worker, i) for every i in [0, count) on `jobs` worker
+// threads, `worker` in [0, jobs) for per thread scratch data, and hands the
+// results to consume() on the calling thread in index order, so the output
+// does not depend on the number of threads. When consume() returns false
+// the workers stop and the function returns false.
+//
+// Workers never run more than `window` items ahead of the consumer, which
+// bounds the memory held by finished but not yet consumed items. Inside the
+// window the item of largest cost(i) starts first: a big topic is picked up
+// as soon as it enters the window instead of when its turn comes.
+template<typename Cost, typename Produce, typename Consume>
+bool
+orderedPipeline(usize count, unsigned jobs, usize window, Cost &&cost, Produce &&produce, Consume &&consume) noexcept
+{
+    using Item = std::invoke_result_t<Produce &, unsigned, usize>;
+
+    // Cost and index of an item in the window, not started yet.
+    struct Ready {
+        usize cost;
+        usize index;
+    };
+
+    jobs = static_cast<unsigned>(std::clamp<usize>(jobs, 1, std::max<usize>(count, 1)));
+    window = std::max<usize>(window, 1);
+
+    std::mutex mutex;
+    std::condition_variable produced;
+    std::condition_variable consumed;
+    std::vector<std::optional<Item>> slots(window);
+
+    // Heap of the largest cost, the lowest index among equals.
+    std::vector<Ready> ready;
+    usize admitted = 0;
+    bool abort = false;
+
+    auto before = [](const Ready &a, const Ready &b) -> bool {
+        return a.cost != b.cost ? a.cost < b.cost : a.index > b.index;
+    };
+
+    // Items [admitted, limit) enter the window, called with the lock held.
+    auto admit = [&](usize limit) -> void {
+        for (; admitted < std::min(limit, count); ++admitted) {
+            ready.push_back({cost(admitted), admitted});
+            std::push_heap(ready.begin(), ready.end(), before);
+        }
+    };
+
+    auto worker = [&](unsigned id) -> void {
+        for (;;) {
+            usize current = 0;
+
+            {
+                std::unique_lock lock(mutex);
+
+                consumed.wait(lock, [&] { return abort || !ready.empty() || admitted >= count; });
+
+                if (abort || ready.empty()) {
+                    return;
+                }
+
+                std::pop_heap(ready.begin(), ready.end(), before);
+
+                current = ready.back().index;
+                ready.pop_back();
+            }
+
+            Item item = produce(id, current);
+
+            {
+                std::lock_guard lock(mutex);
+
+                slots[current % window] = std::move(item);
+            }
+
+            produced.notify_all();
+        }
+    };
+
+    admit(window);
+
+    std::vector<std::thread> workers;
+    workers.reserve(jobs);
+
+    for (unsigned i = 0; i < jobs; ++i) {
+        workers.emplace_back(worker, i);
+    }
+
+    bool result = true;
+
+    for (usize i = 0; i < count; ++i) {
+        std::optional<Item> item;
+
+        {
+            std::unique_lock lock(mutex);
+
+            produced.wait(lock, [&] { return slots[i % window].has_value(); });
+
+            item.swap(slots[i % window]);
+
+            admit(i + 1 + window);
+        }
+
+        consumed.notify_all();
+
+        if (!consume(std::move(*item))) {
+            result = false;
+
+            break;
+        }
+    }
+
+    {
+        std::lock_guard lock(mutex);
+
+        abort = true;
+    }
+
+    consumed.notify_all();
+
+    for (std::thread &thread : workers) {
+        thread.join();
+    }
+
+    return result;
+}
+
+} // namespace CLI
+
+#endif // BHFCONVERTER_SRC_CLI_PIPELINE_HPP
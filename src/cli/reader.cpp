@@ -0,0 +1,584 @@
+// SPDX-License-Identifier: MIT
+// Copyright (c) 2022 Gustavo Ribeiro Croscato
+
+#include <algorithm>
+#include <cerrno>
+#include <condition_variable>
+#include <cstring>
+#include <deque>
+#include <mutex>
+#include <thread>
+
+#include <fcntl.h>
+#include <sys/stat.h>
+#include <unistd.h>
+
+#if defined(USING_IO_URING) && defined(__linux__) && __has_include(<linux/io_uring.h>)
+#define BHF_READER_IO_URING 1
+
+#include <linux/io_uring.h>
+#include <sys/mman.h>
+#include <sys/syscall.h>
+#include <sys/uio.h>
+#endif
+
+#include "reader.hpp"
+
+namespace CLI {
+
+#if defined(BHF_READER_IO_URING)
+
+// Submission and completion rings shared with the kernel, through the raw
+// system calls so there is no liburing dependency. Reads are IORING_OP_READV,
+// available since Linux 5.1.
+struct IOURing {
+    IOURing() noexcept = default;
+
+    IOURing(const IOURing &) = delete;
+    IOURing &operator=(const IOURing &) = delete;
+
+    ~IOURing() noexcept
+    {
+        if (sqes) {
+            munmap(sqes, sqes_size);
+        }
+
+        if (cq_ring && cq_ring != sq_ring) {
+            munmap(cq_ring, cq_size);
+        }
+
+        if (sq_ring) {
+            munmap(sq_ring, sq_size);
+        }
+
+        if (fd >= 0) {
+            close(fd);
+        }
+    }
+
+    // Fails when the kernel is too old or io_uring is disabled or filtered
+    // out, as it often is in containers.
+    bool setup(unsigned entries) noexcept
+    {
+        io_uring_params params;
+        std::memset(&params, 0, sizeof(params));
+
+        fd = static_cast<int>(syscall(__NR_io_uring_setup, entries, &params));
+
+        if (fd < 0) {
+            return false;
+        }
+
+        sq_size = params.sq_off.array + params.sq_entries * sizeof(u32);
+        cq_size = params.cq_off.cqes + params.cq_entries * sizeof(io_uring_cqe);
+
+        bool single_mmap = params.features & IORING_FEAT_SINGLE_MMAP;
+
+        if (single_mmap) {
+            sq_size = cq_size = std::max(sq_size, cq_size);
+        }
+
+        sq_ring = IOURing_Map(fd, sq_size, IORING_OFF_SQ_RING);
+        cq_ring = single_mmap ? sq_ring : IOURing_Map(fd, cq_size, IORING_OFF_CQ_RING);
+
+        sqes_size = params.sq_entries * sizeof(io_uring_sqe);
+        sqes = static_cast<io_uring_sqe *>(IOURing_Map(fd, sqes_size, IORING_OFF_SQES));
+
+        if (!sq_ring || !cq_ring || !sqes) {
+            return false;
+        }
+
+        u8 *sq = static_cast<u8 *>(sq_ring);
+        u8 *cq = static_cast<u8 *>(cq_ring);
+
+        sq_tail = reinterpret_cast<u32 *>(sq + params.sq_off.tail);
+        sq_mask = *reinterpret_cast<u32 *>(sq + params.sq_off.ring_mask);
+        sq_array = reinterpret_cast<u32 *>(sq + params.sq_off.array);
+
+        cq_head = reinterpret_cast<u32 *>(cq + params.cq_off.head);
+        cq_tail = reinterpret_cast<u32 *>(cq + params.cq_off.tail);
+        cq_mask = *reinterpret_cast<u32 *>(cq + params.cq_off.ring_mask);
+        cqes = reinterpret_cast<io_uring_cqe *>(cq + params.cq_off.cqes);
+
+        return true;
+    }
+
+    static void *IOURing_Map(int ring, usize size, u64 offset) noexcept
+    {
+        void *result = mmap(nullptr, size, PROT_READ | PROT_WRITE, MAP_SHARED | MAP_POPULATE, ring, static_cast<off_t>(offset));
+
+        return result == MAP_FAILED ? nullptr : result;
+    }
+
+    // Queues a read, the next enter() submits it.
+    void readv(int file, const iovec *iov, u64 offset, u64 user_data) noexcept
+    {
+        u32 tail = *sq_tail;
+        u32 index = tail & sq_mask;
+
+        io_uring_sqe &sqe = sqes[index];
+        std::memset(&sqe, 0, sizeof(sqe));
+
+        sqe.opcode = IORING_OP_READV;
+        sqe.fd = file;
+        sqe.addr = reinterpret_cast<u64>(iov);
+        sqe.len = 1;
+        sqe.off = offset;
+        sqe.user_data = user_data;
+
+        sq_array[index] = index;
+
+        __atomic_store_n(sq_tail, tail + 1, __ATOMIC_RELEASE);
+
+        ++pending;
+    }
+
+    // Submits the queued reads and waits for a completion.
+    bool enter() noexcept
+    {
+        for (;;) {
+            long submitted = syscall(__NR_io_uring_enter, fd, pending, 1, IORING_ENTER_GETEVENTS, nullptr, 0);
+
+            if (submitted >= 0) {
+                pending -= static_cast<unsigned>(submitted);
+
+                return true;
+            }
+
+            if (errno != EINTR && errno != EAGAIN && errno != EBUSY) {
+                return false;
+            }
+        }
+    }
+
+    // Calls complete(user_data, result) for every finished read.
+    template<typename Function>
+    void reap(Function &&complete) noexcept
+    {
+        u32 head = *cq_head;
+        u32 tail = __atomic_load_n(cq_tail, __ATOMIC_ACQUIRE);
+
+        for (; head != tail; ++head) {
+            const io_uring_cqe &cqe = cqes[head & cq_mask];
+
+            complete(cqe.user_data, cqe.res);
+        }
+
+        __atomic_store_n(cq_head, head, __ATOMIC_RELEASE);
+    }
+
+    int fd = -1;
+    unsigned pending = 0;
+
+    void *sq_ring = nullptr;
+    void *cq_ring = nullptr;
+    usize sq_size = 0;
+    usize cq_size = 0;
+    usize sqes_size = 0;
+
+    u32 *sq_tail = nullptr;
+    u32 sq_mask = 0;
+    u32 *sq_array = nullptr;
+    io_uring_sqe *sqes = nullptr;
+
+    u32 *cq_head = nullptr;
+    u32 *cq_tail = nullptr;
+    u32 cq_mask = 0;
+    io_uring_cqe *cqes = nullptr;
+};
+
+// A file being read through the ring.
+struct ReaderSlot {
+    FileReader::Result result{0, {}, {}};
+    int fd = -1;
+    usize done = 0;
+    iovec iov{nullptr, 0};
+    bool busy = false;
+};
+
+#endif // BHF_READER_IO_URING
+
+struct FileReaderData {
+    std::vector<std::string> paths;
+    unsigned in_flight = 1;
+    MemoryBudget *budget = nullptr;
+    std::string_view backend = "pread";
+
+#if defined(BHF_READER_IO_URING)
+    // Buffers the ring may still write to. Declared before the ring, so they
+    // are freed only once its fd is closed and nothing is in flight.
+    std::vector<std::vector<u8>> abandoned;
+
+    std::unique_ptr<IOURing> ring;
+#endif
+
+    std::mutex mutex;
+    std::condition_variable completed;
+    std::condition_variable taken;
+    std::deque<FileReader::Result> done;
+    usize handed = 0;
+    bool stop = false;
+
+    std::thread thread;
+};
+
+static bool
+Reader_Open(const std::string &path, int &fd, usize &size, std::string &error) noexcept
+{
+    fd = open(path.c_str(), O_RDONLY | O_CLOEXEC);
+
+    if (fd < 0) {
+        error = fmt::format("Can't open file '{}'.", path);
+
+        return false;
+    }
+
+    struct stat status;
+
+    if (fstat(fd, &status) != 0) {
+        error = fmt::format("Error reading file '{}': {}.", path, std::strerror(errno));
+
+        close(fd);
+
+        return false;
+    }
+
+    size = static_cast<usize>(status.st_size);
+
+    return true;
+}
+
+static void
+Reader_Push(FileReaderData &data, FileReader::Result &&result) noexcept
+{
+    {
+        std::lock_guard lock(data.mutex);
+
+        data.done.push_back(std::move(result));
+    }
+
+    data.completed.notify_one();
+}
+
+// Waits for next() to take a file, false when stopping.
+static bool
+Reader_WaitRoom(FileReaderData &data) noexcept
+{
+    std::unique_lock lock(data.mutex);
+
+    data.taken.wait(lock, [&data] { return data.stop || data.done.size() < data.in_flight; });
+
+    return !data.stop;
+}
+
+// Takes the budget share of file `id` before it is read, false when there is
+// no room and `wait` is false. A file stat() fails on is charged nothing,
+// opening it reports the error.
+static bool
+Reader_Charge(FileReaderData &data, usize id, bool wait, usize &charge) noexcept
+{
+    charge = 0;
+
+    if (!data.budget) {
+        return true;
+    }
+
+    struct stat status;
+
+    if (stat(data.paths[id].c_str(), &status) == 0) {
+        charge = data.budget->charge(static_cast<usize>(status.st_size));
+    }
+
+    return data.budget->acquire(charge, wait);
+}
+
+static FileReader::Result
+Reader_ReadFile(const FileReaderData &data, usize id) noexcept
+{
+    FileReader::Result result{id, {}, {}};
+
+    const std::string &path = data.paths[id];
+
+    int fd = -1;
+    usize size = 0;
+
+    if (!Reader_Open(path, fd, size, result.error)) {
+        return result;
+    }
+
+    result.data.resize(size);
+
+    usize read = 0;
+
+    while (read < size) {
+        ssize_t count = pread(fd, result.data.data() + read, size - read, static_cast<off_t>(read));
+
+        if (count < 0 && errno == EINTR) {
+            continue;
+        }
+
+        if (count < 0) {
+            result.error = fmt::format("Error reading file '{}': {}.", path, std::strerror(errno));
+
+            break;
+        }
+
+        if (count == 0) {
+            break;
+        }
+
+        read += static_cast<usize>(count);
+    }
+
+    result.data.resize(read);
+
+    close(fd);
+
+    return result;
+}
+
+static void
+Reader_RunPRead(FileReaderData &data) noexcept
+{
+    for (usize id = 0; id < data.paths.size() && Reader_WaitRoom(data); ++id) {
+        usize charge = 0;
+
+        Reader_Charge(data, id, true, charge);
+
+        FileReader::Result result = Reader_ReadFile(data, id);
+        result.charge = charge;
+
+        Reader_Push(data, std::move(result));
+    }
+}
+
+#if defined(BHF_READER_IO_URING)
+
+// True when another read can start without more than `in_flight` files in
+// memory waiting for next(), `active` reads included.
+static bool
+Reader_HasRoom(FileReaderData &data, usize active) noexcept
+{
+    std::lock_guard lock(data.mutex);
+
+    return !data.stop && data.done.size() + active < data.in_flight;
+}
+
+static void
+Reader_Submit(IOURing &ring, ReaderSlot &slot, usize index) noexcept
+{
+    slot.iov.iov_base = slot.result.data.data() + slot.done;
+    slot.iov.iov_len = slot.result.data.size() - slot.done;
+
+    ring.readv(slot.fd, &slot.iov, slot.done, index);
+}
+
+// Up to `in_flight` files are open with a read queued in the ring, a short
+// read queues the rest of the file again.
+static void
+Reader_RunIOURing(FileReaderData &data) noexcept
+{
+    IOURing &ring = *data.ring;
+
+    std::vector<ReaderSlot> slots(data.in_flight);
+
+    usize next_path = 0;
+    usize active = 0;
+
+    auto finish = [&data, &active](ReaderSlot &slot) -> void {
+        close(slot.fd);
+
+        slot.busy = false;
+        --active;
+
+        Reader_Push(data, std::move(slot.result));
+    };
+
+    for (;;) {
+        while (next_path < data.paths.size() && active < slots.size() && Reader_HasRoom(data, active)) {
+            FileReader::Result result{next_path, {}, {}};
+
+            // Waiting with reads in the ring would keep them from completing,
+            // and the files holding the budget from being released.
+            if (!Reader_Charge(data, next_path, active == 0, result.charge)) {
+                break;
+            }
+
+            int fd = -1;
+            usize size = 0;
+
+            if (!Reader_Open(data.paths[next_path++], fd, size, result.error) || size == 0) {
+                if (fd >= 0) {
+                    close(fd);
+                }
+
+                Reader_Push(data, std::move(result));
+
+                continue;
+            }
+
+            usize index = static_cast<usize>(std::find_if(slots.begin(), slots.end(), [](const ReaderSlot &slot) {
+                return !slot.busy;
+            }) - slots.begin());
+
+            ReaderSlot &slot = slots[index];
+
+            slot.result = std::move(result);
+            slot.result.data.resize(size);
+            slot.fd = fd;
+            slot.done = 0;
+            slot.busy = true;
+
+            ++active;
+
+            Reader_Submit(ring, slot, index);
+        }
+
+        if (active == 0) {
+            if (next_path >= data.paths.size() || !Reader_WaitRoom(data)) {
+                break;
+            }
+
+            continue;
+        }
+
+        if (!ring.enter()) {
+            // The reads already in the ring may still land in their buffers,
+            // those are kept until the reader goes away and the files are
+            // read again with pread(), like the rest.
+            for (ReaderSlot &slot : slots) {
+                if (slot.busy) {
+                    close(slot.fd);
+
+                    data.abandoned.push_back(std::move(slot.result.data));
+
+                    FileReader::Result result = Reader_ReadFile(data, slot.result.id);
+                    result.charge = slot.result.charge;
+
+                    Reader_Push(data, std::move(result));
+                }
+            }
+
+            for (; next_path < data.paths.size() && Reader_WaitRoom(data); ++next_path) {
+                usize charge = 0;
+
+                Reader_Charge(data, next_path, true, charge);
+
+                FileReader::Result result = Reader_ReadFile(data, next_path);
+                result.charge = charge;
+
+                Reader_Push(data, std::move(result));
+            }
+
+            return;
+        }
+
+        ring.reap([&](u64 index, i32 result) {
+            ReaderSlot &slot = slots[index];
+
+            if (result == -EINTR || result == -EAGAIN) {
+                Reader_Submit(ring, slot, index);
+
+                return;
+            }
+
+            if (result < 0) {
+                slot.result.error = fmt::format("Error reading file '{}': {}.", data.paths[slot.result.id], std::strerror(-result));
+            } else if (result == 0) {
+                // The file got shorter since fstat().
+                slot.result.data.resize(slot.done);
+            } else {
+                slot.done += static_cast<usize>(result);
+
+                if (slot.done < slot.result.data.size()) {
+                    Reader_Submit(ring, slot, index);
+
+                    return;
+                }
+            }
+
+            finish(slot);
+        });
+    }
+}
+
+#endif // BHF_READER_IO_URING
+
+FileReader::FileReader() noexcept
+    : d{std::make_unique<FileReaderData>()}
+{}
+
+FileReader::~FileReader() noexcept
+{
+    {
+        std::lock_guard lock(d->mutex);
+
+        d->stop = true;
+    }
+
+    d->taken.notify_all();
+    d->completed.notify_all();
+
+    if (d->thread.joinable()) {
+        d->thread.join();
+    }
+}
+
+void
+FileReader::start(std::vector<std::string> paths, unsigned in_flight, MemoryBudget *budget) noexcept
+{
+    d->paths = std::move(paths);
+    d->in_flight = std::max(in_flight, 1u);
+    d->budget = budget;
+
+#if defined(BHF_READER_IO_URING)
+    d->ring = std::make_unique<IOURing>();
+
+    if (d->ring->setup(d->in_flight)) {
+        d->backend = "io_uring";
+        d->thread = std::thread(Reader_RunIOURing, std::ref(*d));
+
+        return;
+    }
+
+    d->ring.reset();
+#endif
+
+    d->thread = std::thread(Reader_RunPRead, std::ref(*d));
+}
+
+bool
+FileReader::next(Result &result) noexcept
+{
+    std::unique_lock lock(d->mutex);
+
+    d->completed.wait(lock, [this] {
+        return !d->done.empty() || d->handed >= d->paths.size() || d->stop;
+    });
+
+    if (d->done.empty()) {
+        return false;
+    }
+
+    result = std::move(d->done.front());
+    d->done.pop_front();
+
+    // Threads still waiting have nothing left to wait for.
+    if (++d->handed >= d->paths.size()) {
+        d->completed.notify_all();
+    }
+
+    lock.unlock();
+
+    d->taken.notify_one();
+
+    return true;
+}
+
+std::string_view
+FileReader::backend() const noexcept
+{
+    return d->backend;
+}
+
+} // namespace CLI
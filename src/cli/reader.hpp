@@ -0,0 +1,116 @@
+// SPDX-License-Identifier: MIT
+// Copyright (c) 2022 Gustavo Ribeiro Croscato
+
+#ifndef BHFCONVERTER_SRC_CLI_READER_HPP
+#define BHFCONVERTER_SRC_CLI_READER_HPP 1
+
+#include <condition_variable>
+#include <mutex>
+
+namespace CLI {
+
+// Bytes of the files in memory at the same time, read ahead or being worked
+// on. FileReader takes the share of a file before reading it, whoever is done
+// with the file gives it back.
+struct MemoryBudget {
+    // Charged for `size` bytes of a file.
+    usize charge(usize size) const noexcept
+    {
+        return size * scale;
+    }
+
+    // False, without waiting, when `wait` is false and there is no room. A
+    // file over the limit gets in alone.
+    bool acquire(usize bytes, bool wait) noexcept
+    {
+        std::unique_lock lock(mutex);
+
+        auto room = [&] { return limit == 0 || used == 0 || used + bytes <= limit; };
+
+        if (wait) {
+            released.wait(lock, room);
+        } else if (!room()) {
+            return false;
+        }
+
+        used += bytes;
+
+        return true;
+    }
+
+    void release(usize bytes) noexcept
+    {
+        {
+            std::lock_guard lock(mutex);
+
+            used -= bytes;
+        }
+
+        released.notify_all();
+    }
+
+    // 0 means no limit.
+    usize limit = 0;
+    usize scale = 1;
+    usize used = 0;
+    std::mutex mutex;
+    std::condition_variable released;
+};
+
+struct FileReaderData;
+
+// Reads whole files on a background thread, many at a time, and hands each
+// one over as soon as it is complete, in completion order:
+//
+//   CLI::FileReader reader;
+//   CLI::FileReader::Result result;
+//
+//   reader.start(paths, 16);
+//
+//   while (reader.next(result)) {
+//       file.open(std::move(result.data));
+//   }
+//
+// With USING_IO_URING on Linux the reads go through io_uring, when the
+// kernel allows it, so a slow disk or network mount has them all waiting at
+// once. Otherwise files are read one after the other with pread(), still
+// overlapping with the threads calling next().
+class FileReader
+{
+public:
+    struct Result {
+        // Position of the file in the paths given to start().
+        usize id;
+        std::vector<u8> data;
+
+        // Empty when the file was read.
+        std::string error;
+
+        // Taken from the budget given to start(), to be released once done
+        // with the file.
+        usize charge = 0;
+    };
+
+    FileReader() noexcept;
+    ~FileReader() noexcept;
+
+    // Starts reading `paths`, `in_flight` files at a time. Completed files
+    // wait for next() up to `in_flight` of them, then reading pauses. With a
+    // `budget`, reading also waits for the share of the next file, charged
+    // by its size before its buffer is allocated.
+    void start(std::vector<std::string> paths, unsigned in_flight, MemoryBudget *budget = nullptr) noexcept;
+
+    // Blocks until a file is complete, false once every file was handed
+    // out. Safe to call from several threads.
+    bool next(Result &result) noexcept;
+
+    // "io_uring" or "pread", known once start() returns.
+    std::string_view backend() const noexcept;
+
+private:
+    std::unique_ptr<FileReaderData> d;
+};
+
+} // namespace CLI
+
+#endif // BHFCONVERTER_SRC_CLI_READER_HPP
@@ -0,0 +1,1047 @@
+// SPDX-License-Identifier: MIT
+// Copyright (c) 2022 Gustavo Ribeiro Croscato
+
+#include "serve.hpp"
+
+#if defined(__linux__)
+
+#include <algorithm>
+#include <charconv>
+#include <cerrno>
+#include <csignal>
+#include <cstring>
+#include <deque>
+#include <list>
+#include <unordered_map>
+
+#include <arpa/inet.h>
+#include <netinet/in.h>
+#include <netinet/tcp.h>
+#include <sys/epoll.h>
+#include <sys/eventfd.h>
+#include <sys/signalfd.h>
+#include <sys/socket.h>
+#include <unistd.h>
+
+#include "bhf/format.hpp"
+#include "bhf/hash.hpp"
+#include "htmlutil.hpp"
+#include "manifest.hpp"
+#include "pipeline.hpp"
+
+namespace CLI {
+
+// Requests have no body, anything longer than this is not a help browser.
+static constexpr usize kMaxRequestSize = 8192;
+
+static constexpr int kMaxEvents = 64;
+static constexpr usize kMaxResults = 200;
+
+// Part of every ETag, change it whenever the page layout changes so
+// browsers stop reusing their copies.
+static constexpr u64 kETagSeed = 0x7365727665000001ull;
+
+struct Page {
+    std::string etag;
+    std::shared_ptr<const std::string> body;
+};
+
+// Rendered topics, least recently used ones go first once `limit` bytes
+// are in use. Shared by the workers.
+struct PageCache {
+    std::shared_ptr<const Page> find(BHF::File::ContextType context) noexcept
+    {
+        std::lock_guard lock(mutex);
+
+        auto it = pages.find(context);
+
+        if (it == pages.end()) {
+            return nullptr;
+        }
+
+        order.splice(order.begin(), order, it->second.position);
+
+        return it->second.page;
+    }
+
+    void insert(BHF::File::ContextType context, std::shared_ptr<const Page> page) noexcept
+    {
+        std::lock_guard lock(mutex);
+
+        if (pages.count(context) > 0) {
+            return;
+        }
+
+        order.push_front(context);
+        bytes += page->body->size();
+        pages.emplace(context, Entry{std::move(page), order.begin()});
+
+        while (bytes > limit && order.size() > 1) {
+            auto it = pages.find(order.back());
+
+            bytes -= it->second.page->body->size();
+            pages.erase(it);
+            order.pop_back();
+        }
+    }
+
+    struct Entry {
+        std::shared_ptr<const Page> page;
+        std::list<BHF::File::ContextType>::iterator position;
+    };
+
+    usize limit = 0;
+    usize bytes = 0;
+    std::list<BHF::File::ContextType> order;
+    std::unordered_map<BHF::File::ContextType, Entry> pages;
+    std::mutex mutex;
+};
+
+struct Request {
+    int fd;
+    u64 connection;
+    bool head_only;
+    bool keep_alive;
+    std::string target;
+    std::string if_none_match;
+};
+
+struct Response {
+    int fd;
+    u64 connection;
+    bool keep_alive;
+    std::string head;
+    std::shared_ptr<const std::string> body;
+};
+
+struct Connection {
+    u64 id = 0;
+    std::string input;
+
+    // Response being written, `written` counts head and body bytes.
+    std::string head;
+    std::shared_ptr<const std::string> body;
+    usize written = 0;
+
+    bool busy = false;
+    bool keep_alive = true;
+};
+
+struct Server {
+    Server(const BHF::File &_file, const ServeOptions &_options) noexcept
+        : file{_file}
+        , options{_options}
+    {}
+
+    const BHF::File &file;
+    const ServeOptions &options;
+
+    u64 global_hash = 0;
+    bool upper_case_keys = false;
+    bool index_sorted = false;
+
+    // First index key of each context, used as the page title.
+    std::vector<std::string_view> titles;
+
+    PageCache cache;
+
+    // Lower case plain text of every topic, built by the first search.
+    std::once_flag search_once;
+    std::vector<std::string> search_text;
+
+    std::mutex queue_mutex;
+    std::condition_variable queue_ready;
+    std::deque<Request> requests;
+    std::vector<Response> responses;
+    bool stopping = false;
+
+    int wake_fd = -1;
+};
+
+static char
+Serve_ToLower(char c) noexcept
+{
+    return (c >= 'A' && c <= 'Z') ? static_cast<char>(c - 'A' + 'a') : c;
+}
+
+static char
+Serve_ToUpper(char c) noexcept
+{
+    return (c >= 'a' && c <= 'z') ? static_cast<char>(c - 'a' + 'A') : c;
+}
+
+static int
+Serve_HexValue(char c) noexcept
+{
+    if (c >= '0' && c <= '9') {
+        return c - '0';
+    }
+
+    c = Serve_ToLower(c);
+
+    if (c >= 'a' && c <= 'f') {
+        return c - 'a' + 10;
+    }
+
+    return -1;
+}
+
+// Value of `name` in a query string, percent and plus decoded.
+static std::string
+Serve_QueryValue(std::string_view query, std::string_view name) noexcept
+{
+    std::string result;
+
+    while (!query.empty()) {
+        std::string_view::size_type end = query.find('&');
+        std::string_view pair = query.substr(0, end);
+
+        query = end == std::string_view::npos ? std::string_view{} : query.substr(end + 1);
+
+        std::string_view::size_type equal = pair.find('=');
+
+        if (pair.substr(0, equal) != name) {
+            continue;
+        }
+
+        std::string_view value = equal == std::string_view::npos ? std::string_view{} : pair.substr(equal + 1);
+
+        for (std::string_view::size_type i = 0; i < value.size(); ++i) {
+            if (value[i] == '+') {
+                result += ' ';
+            } else if (value[i] == '%' && i + 2 < value.size() && Serve_HexValue(value[i + 1]) >= 0 && Serve_HexValue(value[i + 2]) >= 0) {
+                result += static_cast<char>(Serve_HexValue(value[i + 1]) * 16 + Serve_HexValue(value[i + 2]));
+                i += 2;
+            } else {
+                result += value[i];
+            }
+        }
+
+        break;
+    }
+
+    return result;
+}
+
+static void
+Serve_PageBegin(std::string &out, std::string_view title) noexcept
+{
+    out += "<!DOCTYPE html>\n<html>\n<head>\n<meta charset=\"utf-8\">\n<title>";
+    appendHTMLEscaped(out, title);
+    out += "</title>\n</head>\n<body>\n<nav><a href=\"/\">Contents</a> <a href=\"/index\">Index</a>"
+           " <form action=\"/search\" style=\"display:inline\"><input name=\"q\"></form>";
+}
+
+static void
+Serve_PageEnd(std::string &out) noexcept
+{
+    out += "\n</body>\n</html>\n";
+}
+
+// Keyword targets without a page of their own lead to the main index topic.
+struct ServeLink {
+    void operator()(std::string &out, BHF::File::ContextType context) const noexcept
+    {
+        fmt::format_to(std::back_inserter(out), "/topic/{}", htmlHasPage(server->file, context) ? context : server->file.fileHeader().main_index);
+    }
+
+    const Server *server = nullptr;
+};
+
+// Null when the records of the topic are damaged.
+static std::shared_ptr<const Page>
+Serve_RenderTopic(const Server &server, BHF::File::ContextType context, std::string etag) noexcept
+{
+    BHF::File::ContextType offset = server.file.context()[static_cast<usize>(context)];
+    BHF::File::KeywordType keywords{0, 0, {}};
+    std::string text;
+    std::string scratch;
+
+    if (!server.file.keywords(offset, keywords) || !server.file.text(offset, BHF::File::Raw, text, scratch)) {
+        return nullptr;
+    }
+
+    std::string_view title = server.titles[static_cast<usize>(context)];
+
+    auto body = std::make_shared<std::string>();
+
+    Serve_PageBegin(*body, title.empty() ? fmt::format("Context {}", context) : title);
+
+    if (htmlHasPage(server.file, keywords.up) && keywords.up > 0) {
+        fmt::format_to(std::back_inserter(*body), " <a rel=\"prev\" href=\"/topic/{}\">Previous</a>", keywords.up);
+    }
+
+    if (htmlHasPage(server.file, keywords.down) && keywords.down > 0) {
+        fmt::format_to(std::back_inserter(*body), " <a rel=\"next\" href=\"/topic/{}\">Next</a>", keywords.down);
+    }
+
+    *body += "</nav>\n";
+
+    BHF::HTMLEmitter<ServeLink> emitter{*body, {&server}};
+
+    BHF::formatText(text, keywords, emitter);
+
+    Serve_PageEnd(*body);
+
+    return std::make_shared<const Page>(Page{std::move(etag), std::move(body)});
+}
+
+static std::shared_ptr<const std::string>
+Serve_RenderIndex(const Server &server, std::string_view prefix) noexcept
+{
+    const BHF::File::IndexContainer &index = server.file.index();
+
+    std::string key(prefix);
+
+    if (server.upper_case_keys) {
+        std::transform(key.begin(), key.end(), key.begin(), Serve_ToUpper);
+    }
+
+    usize begin = 0;
+
+    if (server.index_sorted) {
+        begin = static_cast<usize>(std::partition_point(index.begin(), index.end(), [&](const BHF::File::IndexType &entry) {
+            return entry.index < key;
+        }) - index.begin());
+    }
+
+    auto body = std::make_shared<std::string>();
+
+    Serve_PageBegin(*body, "Index");
+    *body += "</nav>\n<ul>\n";
+
+    usize count = 0;
+
+    for (usize i = begin; i < index.size() && count < kMaxResults; ++i) {
+        std::string_view entry = index[i].index;
+
+        if (entry.substr(0, key.size()) != key) {
+            if (server.index_sorted) {
+                break;
+            }
+
+            continue;
+        }
+
+        *body += "<li>";
+
+        if (htmlHasPage(server.file, index[i].context)) {
+            fmt::format_to(std::back_inserter(*body), "<a href=\"/topic/{}\">", index[i].context);
+            appendHTMLEscaped(*body, entry);
+            *body += "</a>";
+        } else {
+            appendHTMLEscaped(*body, entry);
+        }
+
+        *body += "</li>\n";
+
+        ++count;
+    }
+
+    *body += "</ul>";
+
+    Serve_PageEnd(*body);
+
+    return body;
+}
+
+static std::shared_ptr<const std::string>
+Serve_RenderSearch(Server &server, std::string_view query) noexcept
+{
+    const BHF::File::ContextContainer &contexts = server.file.context();
+
+    std::call_once(server.search_once, [&server, &contexts]() {
+        server.search_text.resize(contexts.size());
+
+        parallelFor(contexts.size(), server.options.jobs, [&server, &contexts](unsigned worker, usize i) -> bool {
+            UNUSED(worker);
+
+            // Aliases stay empty, their topic is found through its owner.
+            if (contexts[i] >= 0 && !server.file.isAlias(static_cast<BHF::File::ContextType>(i))) {
+                std::string &text = server.search_text[i];
+
+                text = server.file.text(contexts[i]);
+
+                std::transform(text.begin(), text.end(), text.begin(), Serve_ToLower);
+            }
+
+            return true;
+        });
+    });
+
+    std::string lower(query);
+
+    std::transform(lower.begin(), lower.end(), lower.begin(), Serve_ToLower);
+
+    std::vector<std::string_view> words;
+
+    for (std::string_view rest = lower; !rest.empty();) {
+        std::string_view::size_type end = rest.find(' ');
+
+        if (end > 0) {
+            words.push_back(rest.substr(0, end));
+        }
+
+        rest = end == std::string_view::npos ? std::string_view{} : rest.substr(end + 1);
+    }
+
+    auto body = std::make_shared<std::string>();
+
+    Serve_PageBegin(*body, "Search");
+    *body += "</nav>\n<ul>\n";
+
+    usize count = 0;
+
+    for (usize i = 0; i < contexts.size() && count < kMaxResults && !words.empty(); ++i) {
+        const std::string &text = server.search_text[i];
+
+        bool found = !text.empty() && std::all_of(words.begin(), words.end(), [&text](std::string_view word) {
+            return text.find(word) != std::string::npos;
+        });
+
+        if (!found) {
+            continue;
+        }
+
+        fmt::format_to(std::back_inserter(*body), "<li><a href=\"/topic/{}\">", i);
+
+        if (server.titles[i].empty()) {
+            fmt::format_to(std::back_inserter(*body), "Context {}", i);
+        } else {
+            appendHTMLEscaped(*body, server.titles[i]);
+        }
+
+        *body += "</a></li>\n";
+
+        ++count;
+    }
+
+    *body += "</ul>";
+
+    Serve_PageEnd(*body);
+
+    return body;
+}
+
+static Response
+Serve_Reply(const Request &request, int status, std::string_view reason, std::shared_ptr<const std::string> body, std::string_view etag) noexcept
+{
+    Response response{request.fd, request.connection, request.keep_alive, {}, nullptr};
+
+    usize length = body ? body->size() : 0;
+
+    fmt::format_to(std::back_inserter(response.head), "HTTP/1.1 {} {}\r\nContent-Type: text/html; charset=utf-8\r\nContent-Length: {}\r\n", status, reason, length);
+
+    if (!etag.empty()) {
+        fmt::format_to(std::back_inserter(response.head), "ETag: {}\r\nCache-Control: no-cache\r\n", etag);
+    }
+
+    response.head += request.keep_alive ? "Connection: keep-alive\r\n\r\n" : "Connection: close\r\n\r\n";
+
+    if (!request.head_only && status != 304) {
+        response.body = std::move(body);
+    }
+
+    return response;
+}
+
+static Response
+Serve_NotFound(const Request &request) noexcept
+{
+    static const std::shared_ptr<const std::string> body = std::make_shared<const std::string>("<!DOCTYPE html>\n<title>Not Found</title>\n<p>Not Found</p>\n");
+
+    return Serve_Reply(request, 404, "Not Found", body, {});
+}
+
+static Response
+Serve_ServerError(const Request &request) noexcept
+{
+    static const std::shared_ptr<const std::string> body = std::make_shared<const std::string>("<!DOCTYPE html>\n<title>Internal Server Error</title>\n<p>The topic could not be decoded.</p>\n");
+
+    return Serve_Reply(request, 500, "Internal Server Error", body, {});
+}
+
+static Response
+Serve_Handle(Server &server, const Request &request) noexcept
+{
+    std::string_view target = request.target;
+    std::string_view::size_type question = target.find('?');
+    std::string_view path = target.substr(0, question);
+    std::string_view query = question == std::string_view::npos ? std::string_view{} : target.substr(question + 1);
+
+    if (path == "/index") {
+        return Serve_Reply(request, 200, "OK", Serve_RenderIndex(server, Serve_QueryValue(query, "prefix")), {});
+    }
+
+    if (path == "/search") {
+        return Serve_Reply(request, 200, "OK", Serve_RenderSearch(server, Serve_QueryValue(query, "q")), {});
+    }
+
+    BHF::File::ContextType context = -1;
+
+    if (path == "/") {
+        context = server.file.fileHeader().main_index;
+    } else if (path.substr(0, 7) == "/topic/") {
+        std::string_view number = path.substr(7);
+
+        auto [end, error] = std::from_chars(number.data(), number.data() + number.size(), context);
+
+        if (error != std::errc() || end != number.data() + number.size()) {
+            context = -1;
+        }
+    }
+
+    if (!htmlHasPage(server.file, context)) {
+        return Serve_NotFound(request);
+    }
+
+    // The page only depends on its records and on what every page depends
+    // on, so the ETag is known without rendering anything.
+    BHF::File::ContextType offset = server.file.context()[static_cast<usize>(context)];
+
+    std::string etag = fmt::format("\"{:016x}\"", BHF::hash64(server.file.topicData(offset), server.global_hash ^ static_cast<u64>(context)));
+
+    if (request.if_none_match == etag) {
+        return Serve_Reply(request, 304, "Not Modified", nullptr, etag);
+    }
+
+    std::shared_ptr<const Page> page = server.cache.find(context);
+
+    if (!page) {
+        page = Serve_RenderTopic(server, context, std::move(etag));
+
+        if (!page) {
+            return Serve_ServerError(request);
+        }
+
+        server.cache.insert(context, page);
+    }
+
+    return Serve_Reply(request, 200, "OK", page->body, page->etag);
+}
+
+static void
+Serve_Worker(Server &server) noexcept
+{
+    for (;;) {
+        Request request;
+
+        {
+            std::unique_lock lock(server.queue_mutex);
+
+            server.queue_ready.wait(lock, [&server] { return server.stopping || !server.requests.empty(); });
+
+            if (server.stopping) {
+                return;
+            }
+
+            request = std::move(server.requests.front());
+            server.requests.pop_front();
+        }
+
+        Response response = Serve_Handle(server, request);
+
+        {
+            std::lock_guard lock(server.queue_mutex);
+
+            server.responses.push_back(std::move(response));
+        }
+
+        u64 one = 1;
+
+        [[maybe_unused]] ssize_t written = ::write(server.wake_fd, &one, sizeof(one));
+    }
+}
+
+static std::string_view
+Serve_Trim(std::string_view text) noexcept
+{
+    while (!text.empty() && (text.front() == ' ' || text.front() == '\t')) {
+        text.remove_prefix(1);
+    }
+
+    while (!text.empty() && (text.back() == ' ' || text.back() == '\t')) {
+        text.remove_suffix(1);
+    }
+
+    return text;
+}
+
+static bool
+Serve_HeaderIs(std::string_view line, std::string_view name) noexcept
+{
+    if (line.size() <= name.size() || line[name.size()] != ':') {
+        return false;
+    }
+
+    for (usize i = 0; i < name.size(); ++i) {
+        if (Serve_ToLower(line[i]) != name[i]) {
+            return false;
+        }
+    }
+
+    return true;
+}
+
+enum class ParseResult {
+      Incomplete
+    , Complete
+    , Invalid
+};
+
+// Takes one request off the front of the connection input.
+static ParseResult
+Serve_ParseRequest(Connection &connection, Request &request) noexcept
+{
+    std::string::size_type end = connection.input.find("\r\n\r\n");
+
+    if (end == std::string::npos) {
+        return connection.input.size() > kMaxRequestSize ? ParseResult::Invalid : ParseResult::Incomplete;
+    }
+
+    std::string_view head(connection.input.data(), end);
+    std::string_view::size_type line_end = head.find("\r\n");
+    std::string_view line = head.substr(0, line_end);
+
+    std::string_view::size_type first_space = line.find(' ');
+    std::string_view::size_type last_space = line.rfind(' ');
+
+    if (first_space == std::string_view::npos || last_space == first_space) {
+        return ParseResult::Invalid;
+    }
+
+    std::string_view method = line.substr(0, first_space);
+    std::string_view version = line.substr(last_space + 1);
+
+    if ((method != "GET" && method != "HEAD") || version.substr(0, 5) != "HTTP/") {
+        return ParseResult::Invalid;
+    }
+
+    request.head_only = method == "HEAD";
+    request.keep_alive = version != "HTTP/1.0";
+    request.target = line.substr(first_space + 1, last_space - first_space - 1);
+    request.if_none_match.clear();
+
+    while (line_end != std::string_view::npos) {
+        std::string_view::size_type start = line_end + 2;
+
+        line_end = head.find("\r\n", start);
+        line = head.substr(start, line_end == std::string_view::npos ? std::string_view::npos : line_end - start);
+
+        if (Serve_HeaderIs(line, "connection")) {
+            std::string value(Serve_Trim(line.substr(11)));
+
+            std::transform(value.begin(), value.end(), value.begin(), Serve_ToLower);
+
+            if (value == "close") {
+                request.keep_alive = false;
+            } else if (value == "keep-alive") {
+                request.keep_alive = true;
+            }
+        } else if (Serve_HeaderIs(line, "if-none-match")) {
+            request.if_none_match = Serve_Trim(line.substr(14));
+        } else if (Serve_HeaderIs(line, "content-length") && Serve_Trim(line.substr(15)) != "0") {
+            return ParseResult::Invalid;
+        } else if (Serve_HeaderIs(line, "transfer-encoding")) {
+            return ParseResult::Invalid;
+        }
+    }
+
+    connection.input.erase(0, end + 4);
+
+    return ParseResult::Complete;
+}
+
+// The event loop, everything below runs on the calling thread only.
+struct Loop {
+    explicit Loop(Server &_server) noexcept
+        : server{_server}
+    {}
+
+    bool watch(int fd, u32 events) noexcept
+    {
+        epoll_event event{};
+        event.events = events;
+        event.data.fd = fd;
+
+        return epoll_ctl(epoll_fd, EPOLL_CTL_MOD, fd, &event) == 0;
+    }
+
+    void close(int fd) noexcept
+    {
+        epoll_ctl(epoll_fd, EPOLL_CTL_DEL, fd, nullptr);
+        ::close(fd);
+
+        connections.erase(fd);
+    }
+
+    void accept() noexcept
+    {
+        for (;;) {
+            int fd = accept4(listen_fd, nullptr, nullptr, SOCK_NONBLOCK | SOCK_CLOEXEC);
+
+            if (fd < 0) {
+                return;
+            }
+
+            int one = 1;
+
+            setsockopt(fd, IPPROTO_TCP, TCP_NODELAY, &one, sizeof(one));
+
+            epoll_event event{};
+            event.events = EPOLLIN | EPOLLRDHUP;
+            event.data.fd = fd;
+
+            if (epoll_ctl(epoll_fd, EPOLL_CTL_ADD, fd, &event) != 0) {
+                ::close(fd);
+
+                continue;
+            }
+
+            connections[fd].id = ++last_id;
+        }
+    }
+
+    // Reads what is available and dispatches the first complete request.
+    void read(int fd) noexcept
+    {
+        Connection &connection = connections[fd];
+
+        std::array<char, 16384> buffer;
+
+        for (;;) {
+            ssize_t count = recv(fd, buffer.data(), buffer.size(), 0);
+
+            if (count > 0) {
+                connection.input.append(buffer.data(), static_cast<usize>(count));
+
+                continue;
+            }
+
+            if (count == 0 || (errno != EAGAIN && errno != EINTR)) {
+                close(fd);
+
+                return;
+            }
+
+            if (errno == EINTR) {
+                continue;
+            }
+
+            break;
+        }
+
+        dispatch(fd);
+    }
+
+    void dispatch(int fd) noexcept
+    {
+        Connection &connection = connections[fd];
+
+        if (connection.busy) {
+            return;
+        }
+
+        Request request{fd, connection.id, false, true, {}, {}};
+
+        ParseResult result = Serve_ParseRequest(connection, request);
+
+        if (result == ParseResult::Incomplete) {
+            return;
+        }
+
+        if (result == ParseResult::Invalid) {
+            connection.head = "HTTP/1.1 400 Bad Request\r\nContent-Length: 0\r\nConnection: close\r\n\r\n";
+            connection.body = nullptr;
+            connection.written = 0;
+            connection.keep_alive = false;
+            connection.busy = true;
+
+            write(fd);
+
+            return;
+        }
+
+        connection.busy = true;
+
+        // No reading while the worker answers, pipelined requests wait in
+        // the input buffer.
+        watch(fd, 0);
+
+        {
+            std::lock_guard lock(server.queue_mutex);
+
+            server.requests.push_back(std::move(request));
+        }
+
+        server.queue_ready.notify_one();
+    }
+
+    void write(int fd) noexcept
+    {
+        Connection &connection = connections[fd];
+
+        usize body_size = connection.body ? connection.body->size() : 0;
+        usize total = connection.head.size() + body_size;
+
+        while (connection.written < total) {
+            std::array<iovec, 2> parts{};
+            usize count = 0;
+
+            if (connection.written < connection.head.size()) {
+                parts[count++] = {connection.head.data() + connection.written, connection.head.size() - connection.written};
+
+                if (body_size > 0) {
+                    parts[count++] = {const_cast<char *>(connection.body->data()), body_size};
+                }
+            } else {
+                usize body_written = connection.written - connection.head.size();
+
+                parts[count++] = {const_cast<char *>(connection.body->data()) + body_written, body_size - body_written};
+            }
+
+            msghdr message{};
+            message.msg_iov = parts.data();
+            message.msg_iovlen = count;
+
+            ssize_t sent = sendmsg(fd, &message, MSG_NOSIGNAL);
+
+            if (sent < 0) {
+                if (errno == EINTR) {
+                    continue;
+                }
+
+                if (errno == EAGAIN) {
+                    watch(fd, EPOLLOUT);
+
+                    return;
+                }
+
+                close(fd);
+
+                return;
+            }
+
+            connection.written += static_cast<usize>(sent);
+        }
+
+        if (!connection.keep_alive) {
+            close(fd);
+
+            return;
+        }
+
+        connection.head.clear();
+        connection.body = nullptr;
+        connection.written = 0;
+        connection.busy = false;
+
+        watch(fd, EPOLLIN | EPOLLRDHUP);
+
+        dispatch(fd);
+    }
+
+    // Responses of the workers, connections closed meanwhile are skipped.
+    void complete() noexcept
+    {
+        u64 count = 0;
+
+        [[maybe_unused]] ssize_t result = ::read(server.wake_fd, &count, sizeof(count));
+
+        std::vector<Response> responses;
+
+        {
+            std::lock_guard lock(server.queue_mutex);
+
+            responses.swap(server.responses);
+        }
+
+        for (Response &response : responses) {
+            auto it = connections.find(response.fd);
+
+            if (it == connections.end() || it->second.id != response.connection) {
+                continue;
+            }
+
+            it->second.head = std::move(response.head);
+            it->second.body = std::move(response.body);
+            it->second.written = 0;
+            it->second.keep_alive = response.keep_alive;
+
+            write(response.fd);
+        }
+    }
+
+    Server &server;
+    int epoll_fd = -1;
+    int listen_fd = -1;
+    int signal_fd = -1;
+    u64 last_id = 0;
+    std::unordered_map<int, Connection> connections;
+};
+
+static bool
+Serve_Listen(u16 port, int &listen_fd, std::string &error) noexcept
+{
+    listen_fd = socket(AF_INET, SOCK_STREAM | SOCK_NONBLOCK | SOCK_CLOEXEC, 0);
+
+    if (listen_fd < 0) {
+        error = fmt::format("Error creating socket: {}.", std::strerror(errno));
+
+        return false;
+    }
+
+    int one = 1;
+
+    setsockopt(listen_fd, SOL_SOCKET, SO_REUSEADDR, &one, sizeof(one));
+
+    sockaddr_in address{};
+    address.sin_family = AF_INET;
+    address.sin_port = htons(port);
+    address.sin_addr.s_addr = htonl(INADDR_LOOPBACK);
+
+    if (bind(listen_fd, reinterpret_cast<sockaddr *>(&address), sizeof(address)) != 0 || listen(listen_fd, SOMAXCONN) != 0) {
+        error = fmt::format("Error listening on 127.0.0.1:{}: {}.", port, std::strerror(errno));
+
+        return false;
+    }
+
+    return true;
+}
+
+static bool
+Serve_Add(int epoll_fd, int fd) noexcept
+{
+    epoll_event event{};
+    event.events = EPOLLIN;
+    event.data.fd = fd;
+
+    return epoll_ctl(epoll_fd, EPOLL_CTL_ADD, fd, &event) == 0;
+}
+
+bool
+serve(const BHF::File &file, const ServeOptions &options, std::string &error) noexcept
+{
+    Server server(file, options);
+
+    const BHF::File::IndexContainer &index = file.index();
+
+    // Everything a page shows besides its own records: titles, link and
+    // browse targets that exist, the index page.
+    server.global_hash = manifestGlobalHash(file, kETagSeed);
+    server.upper_case_keys = (file.fileHeader().options & BHF::OF_CaseSense) == 0;
+    server.index_sorted = std::is_sorted(index.begin(), index.end(), [](const BHF::File::IndexType &a, const BHF::File::IndexType &b) {
+        return a.index < b.index;
+    });
+    server.titles.resize(file.context().size());
+    server.cache.limit = options.cache_size;
+
+    for (const BHF::File::IndexType &entry : index) {
+        if (entry.context >= 0 && static_cast<usize>(entry.context) < server.titles.size() && server.titles[static_cast<usize>(entry.context)].empty()) {
+            server.titles[static_cast<usize>(entry.context)] = entry.index;
+        }
+    }
+
+    Loop loop(server);
+
+    // Blocked before the workers start so only the signalfd sees them.
+    sigset_t signals;
+    sigemptyset(&signals);
+    sigaddset(&signals, SIGINT);
+    sigaddset(&signals, SIGTERM);
+
+    pthread_sigmask(SIG_BLOCK, &signals, nullptr);
+
+    loop.epoll_fd = epoll_create1(EPOLL_CLOEXEC);
+    loop.signal_fd = signalfd(-1, &signals, SFD_NONBLOCK | SFD_CLOEXEC);
+    server.wake_fd = eventfd(0, EFD_NONBLOCK | EFD_CLOEXEC);
+
+    bool result = loop.epoll_fd >= 0 && loop.signal_fd >= 0 && server.wake_fd >= 0;
+
+    if (!result) {
+        error = fmt::format("Error creating the event loop: {}.", std::strerror(errno));
+    }
+
+    result = result && Serve_Listen(options.port, loop.listen_fd, error);
+
+    if (result && !(Serve_Add(loop.epoll_fd, loop.listen_fd) && Serve_Add(loop.epoll_fd, loop.signal_fd) && Serve_Add(loop.epoll_fd, server.wake_fd))) {
+        error = fmt::format("Error creating the event loop: {}.", std::strerror(errno));
+        result = false;
+    }
+
+    std::vector<std::thread> workers;
+
+    if (result) {
+        for (unsigned i = 0; i < (options.jobs > 0 ? options.jobs : 1); ++i) {
+            workers.emplace_back(Serve_Worker, std::ref(server));
+        }
+
+        fmt::print("Serving {} on http://127.0.0.1:{}/\n", file.signature(), options.port);
+        std::fflush(stdout);
+    }
+
+    bool running = result;
+
+    std::array<epoll_event, kMaxEvents> events;
+
+    while (running) {
+        int count = epoll_wait(loop.epoll_fd, events.data(), kMaxEvents, -1);
+
+        if (count < 0 && errno != EINTR) {
+            break;
+        }
+
+        for (int i = 0; i < count; ++i) {
+            int fd = events[static_cast<usize>(i)].data.fd;
+            u32 flags = events[static_cast<usize>(i)].events;
+
+            if (fd == loop.signal_fd) {
+                running = false;
+            } else if (fd == loop.listen_fd) {
+                loop.accept();
+            } else if (fd == server.wake_fd) {
+                loop.complete();
+            } else if (loop.connections.count(fd) == 0) {
+                continue;
+            } else if (flags & (EPOLLERR | EPOLLHUP)) {
+                loop.close(fd);
+            } else if (flags & EPOLLOUT) {
+                loop.write(fd);
+            } else if (flags & EPOLLIN) {
+                loop.read(fd);
+            } else if (flags & EPOLLRDHUP) {
+                loop.close(fd);
+            }
+        }
+    }
+
+    {
+        std::lock_guard lock(server.queue_mutex);
+
+        server.stopping = true;
+    }
+
+    server.queue_ready.notify_all();
+
+    for (std::thread &worker : workers) {
+        worker.join();
+    }
+
+    while (!loop.connections.empty()) {
+        loop.close(loop.connections.begin()->first);
+    }
+
+    for (int fd : {loop.listen_fd, loop.signal_fd, server.wake_fd, loop.epoll_fd}) {
+        if (fd >= 0) {
+            ::close(fd);
+        }
+    }
+
+    pthread_sigmask(SIG_UNBLOCK, &signals, nullptr);
+
+    return result;
+}
+
+} // namespace CLI
+
+#endif // __linux__
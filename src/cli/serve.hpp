@@ -0,0 +1,32 @@
+// SPDX-License-Identifier: MIT
+// Copyright (c) 2022 Gustavo Ribeiro Croscato
+
+#ifndef BHFCONVERTER_SRC_CLI_SERVE_HPP
+#define BHFCONVERTER_SRC_CLI_SERVE_HPP 1
+
+#include "bhf/file.hpp"
+
+namespace CLI {
+
+struct ServeOptions {
+    u16 port = 8437;
+    unsigned jobs = 1;
+
+    // Bytes of rendered topic pages kept in memory.
+    usize cache_size = 64 * 1024 * 1024;
+};
+
+// Serves the help file over HTTP/1.1 on 127.0.0.1 until SIGINT or SIGTERM:
+//
+//   /                  the main index topic
+//   /topic/<context>   a topic, keywords link to the other topics
+//   /index?prefix=     index keys starting with prefix
+//   /search?q=         topics containing every word of q
+//
+// One thread runs the connections, `jobs` threads answer the requests.
+// Returns false and fills `error` when the server can't start.
+bool serve(const BHF::File &file, const ServeOptions &options, std::string &error) noexcept;
+
+} // namespace CLI
+
+#endif // BHFCONVERTER_SRC_CLI_SERVE_HPP
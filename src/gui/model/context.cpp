@@ -7,9 +7,15 @@ namespace GUI {
 namespace Model {
 
 struct ContextData {
-    BHF::File::ContextContainer container;
+    const BHF::File::ContextContainer *container = nullptr;
 };
 
+static int
+Context_Size(const ContextData &data) noexcept
+{
+    return data.container ? static_cast<int>(data.container->size()) : 0;
+}
+
 Context::Context(QObject *parent) noexcept
     : QAbstractTableModel{parent}
     , d{std::make_unique<ContextData>()}
@@ -35,9 +41,11 @@ Context::headerData(int section, Qt::Orientation orientation, int role) const
 int
 Context::rowCount(const QModelIndex &parent) const
 {
-    Q_UNUSED(parent);
+    if (parent.isValid()) {
+        return 0;
+    }
 
-    return static_cast<int>(d->container.size());
+    return Context_Size(*d);
 }
 
 int
@@ -51,7 +59,7 @@ Context::columnCount(const QModelIndex &parent) const
 QVariant
 Context::data(const QModelIndex &index, int role) const
 {
-    if (index.isValid()) {
+    if (index.isValid() && index.row() < Context_Size(*d)) {
         int row = index.row();
         int col = index.column();
 
@@ -60,7 +68,7 @@ Context::data(const QModelIndex &index, int role) const
                 if (col == 0) {
                     return row;
                 } else if (col == 1) {
-                    return QVariant::fromValue<BHF::File::ContextType>(d->container.at(static_cast<BHF::File::ContextContainer::size_type>(row)));
+                    return QVariant::fromValue<BHF::File::ContextType>((*d->container)[static_cast<BHF::File::ContextContainer::size_type>(row)]);
                 }
             }
         }
@@ -69,7 +77,8 @@ Context::data(const QModelIndex &index, int role) const
     return {};
 }
 
-void Context::update(const BHF::File::ContextContainer &container) noexcept
+void
+Context::update(const BHF::File::ContextContainer *container) noexcept
 {
     beginResetModel();
     d->container = container;
@@ -23,8 +23,10 @@ public:
     virtual int rowCount(const QModelIndex &parent) const override;
     virtual int columnCount(const QModelIndex &parent) const override;
     virtual QVariant data(const QModelIndex &index, int role) const override;
-
-    void update(const BHF::File::ContextContainer &container) noexcept;
+    // Shows `container` without copying it, it must outlive the model or be
+    // replaced first. nullptr empties the model. Every row is there from the
+    // start, ContextFilter sorts and searches all of them.
+    void update(const BHF::File::ContextContainer *container) noexcept;
 
 private:
     std::unique_ptr<ContextData> d;
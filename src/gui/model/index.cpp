@@ -1,15 +1,35 @@
 // SPDX-License-Identifier: MIT
 // Copyright (c) 2022 Gustavo Ribeiro Croscato
 
+#include <algorithm>
+#include <charconv>
+#include <numeric>
+
 #include "index.hpp"
 
 namespace GUI {
 namespace Model {
 
+// Rows added by each IndexFilter::fetchMore(), the view asks for more as
+// it scrolls.
+static constexpr int kFetchRows = 1024;
+
+// Keys converted to QString kept around, about a few screens of rows.
+static constexpr int kCachedKeys = 512;
+
 struct IndexData {
-    BHF::File::IndexContainer container;
+    const BHF::File::IndexContainer *container = nullptr;
+
+    // Row to key, filled as rows are painted.
+    mutable QCache<int, QString> keys{kCachedKeys};
 };
 
+static int
+Index_Size(const IndexData &data) noexcept
+{
+    return data.container ? static_cast<int>(data.container->size()) : 0;
+}
+
 Index::Index(QObject *parent) noexcept
     : QAbstractTableModel{parent}
       , d{std::make_unique<IndexData>()}
@@ -36,9 +56,11 @@ Index::headerData(int section, Qt::Orientation orientation, int role) const
 int
 Index::rowCount(const QModelIndex &parent) const
 {
-    Q_UNUSED(parent);
+    if (parent.isValid()) {
+        return 0;
+    }
 
-    return static_cast<int>(d->container.size());
+    return Index_Size(*d);
 }
 
 int
@@ -52,16 +74,24 @@ Index::columnCount(const QModelIndex &parent) const
 QVariant
 Index::data(const QModelIndex &index, int role) const
 {
-    if (index.isValid()) {
+    if (index.isValid() && index.row() < Index_Size(*d)) {
         int row = index.row();
         int col = index.column();
 
         switch (role) {
             case Qt::DisplayRole: {
-                BHF::File::IndexType data = d->container.at(static_cast<BHF::File::IndexContainer::size_type>(row));
+                const BHF::File::IndexType &data = (*d->container)[static_cast<BHF::File::IndexContainer::size_type>(row)];
 
                 if (col == 0) {
-                    return QString::fromUtf8(data.index.c_str(), static_cast<qsizetype>(data.index.size()));
+                    if (const QString *key = d->keys.object(row)) {
+                        return *key;
+                    }
+
+                    QString key = QString::fromUtf8(data.index.data(), static_cast<qsizetype>(data.index.size()));
+
+                    d->keys.insert(row, new QString(key));
+
+                    return key;
                 } else if (col == 1) {
                     return QVariant::fromValue<decltype(data.context)>(data.context);
                 }
@@ -73,16 +103,402 @@ Index::data(const QModelIndex &index, int role) const
 }
 
 void
-Index::update(const BHF::File::IndexContainer &container) noexcept
+Index::update(const BHF::File::IndexContainer *container) noexcept
 {
     beginResetModel();
     d->container = container;
+    d->keys.clear();
     endResetModel();
 }
 
+const BHF::File::IndexContainer *
+Index::container() const noexcept
+{
+    return d->container;
+}
+
+struct IndexFilterData {
+    Index *source = nullptr;
+
+    // Source rows in key order, letters folded to upper case, and the way
+    // back, both empty when the index is already in that order.
+    std::vector<int> order;
+    std::vector<int> position;
+
+    // Column searched: keys by prefix range, context numbers by a scan.
+    int column = 0;
+
+    // As typed and as searched.
+    QString query;
+    std::string prefix;
+
+    // Key column: range of the prefix in key order. Context column: matching
+    // positions in key order, the range indexes them. The first `loaded`
+    // rows are shown.
+    std::vector<int> matches;
+    int first = 0;
+    int last = 0;
+    int loaded = 0;
+};
+
+static char
+IndexFilter_Fold(char c) noexcept
+{
+    return (c >= 'a' && c <= 'z') ? static_cast<char>(c - 'a' + 'A') : c;
+}
+
+// As std::string_view::compare(), ASCII letters compared without case like
+// the wildcard search this filter replaces. Files without BHF::OF_CaseSense
+// have their keys in upper case already.
+static int
+IndexFilter_Compare(std::string_view a, std::string_view b) noexcept
+{
+    usize count = std::min(a.size(), b.size());
+
+    for (usize i = 0; i < count; ++i) {
+        u8 x = static_cast<u8>(IndexFilter_Fold(a[i]));
+        u8 y = static_cast<u8>(IndexFilter_Fold(b[i]));
+
+        if (x != y) {
+            return x < y ? -1 : 1;
+        }
+    }
+
+    return a.size() == b.size() ? 0 : (a.size() < b.size() ? -1 : 1);
+}
+
+static int
+IndexFilter_Row(const IndexFilterData &data, int position) noexcept
+{
+    return data.order.empty() ? position : data.order[static_cast<usize>(position)];
+}
+
+static int
+IndexFilter_Position(const IndexFilterData &data, int row) noexcept
+{
+    return data.position.empty() ? row : data.position[static_cast<usize>(row)];
+}
+
+// Position in key order of a row of the proxy.
+static int
+IndexFilter_Shown(const IndexFilterData &data, int row) noexcept
+{
+    return data.column == 0 ? data.first + row : data.matches[static_cast<usize>(row)];
+}
+
+static const BHF::File::IndexType &
+IndexFilter_Entry(const IndexFilterData &data, int position) noexcept
+{
+    return (*data.source->container())[static_cast<usize>(IndexFilter_Row(data, position))];
+}
+
+// First position of [first, last) where `predicate` is false, it must be
+// true for a leading part of the range and false after.
+template<typename Predicate>
+static int
+IndexFilter_PartitionPoint(int first, int last, Predicate &&predicate) noexcept
+{
+    while (first < last) {
+        int middle = first + (last - first) / 2;
+
+        if (predicate(middle)) {
+            first = middle + 1;
+        } else {
+            last = middle;
+        }
+    }
+
+    return first;
+}
+
+// Range of [from, to) whose keys start with the prefix.
+static void
+IndexFilter_Range(const IndexFilterData &data, int from, int to, int &first, int &last) noexcept
+{
+    std::string_view prefix = data.prefix;
+
+    first = IndexFilter_PartitionPoint(from, to, [&](int position) {
+        return IndexFilter_Compare(IndexFilter_Entry(data, position).index, prefix) < 0;
+    });
+
+    last = IndexFilter_PartitionPoint(first, to, [&](int position) {
+        return IndexFilter_Compare(std::string_view(IndexFilter_Entry(data, position).index).substr(0, prefix.size()), prefix) <= 0;
+    });
+}
+
+// Searches the whole index again, called inside a model reset.
+static void
+IndexFilter_Search(IndexFilterData &data) noexcept
+{
+    const BHF::File::IndexContainer *container = data.source ? data.source->container() : nullptr;
+
+    int size = container ? static_cast<int>(container->size()) : 0;
+
+    data.matches.clear();
+
+    if (data.column == 0) {
+        IndexFilter_Range(data, 0, size, data.first, data.last);
+    } else {
+        // Context numbers have no order to search, every row is checked.
+        for (int position = 0; position < size; ++position) {
+            std::array<char, 16> buffer{};
+
+            auto [end, error] = std::to_chars(buffer.data(), buffer.data() + buffer.size(), IndexFilter_Entry(data, position).context);
+
+            Q_UNUSED(error);
+
+            if (std::string_view(buffer.data(), static_cast<usize>(end - buffer.data())).substr(0, data.prefix.size()) == data.prefix) {
+                data.matches.push_back(position);
+            }
+        }
+
+        data.first = 0;
+        data.last = static_cast<int>(data.matches.size());
+    }
+
+    data.loaded = std::min(kFetchRows, data.last - data.first);
+}
+
 IndexFilter::IndexFilter(QObject *parent) noexcept
-    : QSortFilterProxyModel(parent)
+    : QAbstractProxyModel(parent)
+    , d{std::make_unique<IndexFilterData>()}
 {}
 
+IndexFilter::~IndexFilter() noexcept = default;
+
+void
+IndexFilter::setSourceModel(QAbstractItemModel *model)
+{
+    if (d->source) {
+        disconnect(d->source, nullptr, this, nullptr);
+    }
+
+    beginResetModel();
+
+    QAbstractProxyModel::setSourceModel(model);
+
+    d->source = qobject_cast<Index *>(model);
+
+    if (d->source) {
+        connect(d->source, &QAbstractItemModel::modelAboutToBeReset, this, [this]() -> void {
+            beginResetModel();
+        });
+
+        connect(d->source, &QAbstractItemModel::modelReset, this, [this]() -> void {
+            rebuild();
+            endResetModel();
+        });
+    }
+
+    rebuild();
+
+    endResetModel();
+}
+
+QModelIndex
+IndexFilter::mapToSource(const QModelIndex &proxy) const
+{
+    if (!d->source || !proxy.isValid() || proxy.row() >= d->loaded) {
+        return {};
+    }
+
+    return d->source->index(IndexFilter_Row(*d, IndexFilter_Shown(*d, proxy.row())), proxy.column(), {});
+}
+
+QModelIndex
+IndexFilter::mapFromSource(const QModelIndex &source) const
+{
+    if (!source.isValid()) {
+        return {};
+    }
+
+    int position = IndexFilter_Position(*d, source.row());
+    int row = position - d->first;
+
+    if (d->column != 0) {
+        auto found = std::lower_bound(d->matches.begin(), d->matches.end(), position);
+
+        row = found != d->matches.end() && *found == position ? static_cast<int>(found - d->matches.begin()) : -1;
+    }
+
+    if (row < 0 || row >= d->loaded) {
+        return {};
+    }
+
+    return index(row, source.column(), {});
+}
+
+// Columns are the ones of the source, QAbstractProxyModel finds them through
+// the first row and has none to go by while nothing matches.
+QVariant
+IndexFilter::headerData(int section, Qt::Orientation orientation, int role) const
+{
+    if (orientation == Qt::Horizontal && d->source) {
+        return d->source->headerData(section, orientation, role);
+    }
+
+    return QAbstractProxyModel::headerData(section, orientation, role);
+}
+
+QModelIndex
+IndexFilter::index(int row, int column, const QModelIndex &parent) const
+{
+    return hasIndex(row, column, parent) ? createIndex(row, column) : QModelIndex();
+}
+
+QModelIndex
+IndexFilter::parent(const QModelIndex &child) const
+{
+    Q_UNUSED(child);
+
+    return {};
+}
+
+int
+IndexFilter::rowCount(const QModelIndex &parent) const
+{
+    if (parent.isValid()) {
+        return 0;
+    }
+
+    return d->loaded;
+}
+
+int
+IndexFilter::columnCount(const QModelIndex &parent) const
+{
+    if (parent.isValid() || !d->source) {
+        return 0;
+    }
+
+    return d->source->columnCount({});
+}
+
+bool
+IndexFilter::canFetchMore(const QModelIndex &parent) const
+{
+    return !parent.isValid() && d->loaded < d->last - d->first;
+}
+
+void
+IndexFilter::fetchMore(const QModelIndex &parent)
+{
+    if (!canFetchMore(parent)) {
+        return;
+    }
+
+    int count = std::min(kFetchRows, d->last - d->first - d->loaded);
+
+    beginInsertRows({}, d->loaded, d->loaded + count - 1);
+    d->loaded += count;
+    endInsertRows();
+}
+
+void
+IndexFilter::setFilterColumn(int column) noexcept
+{
+    if (column == d->column) {
+        return;
+    }
+
+    beginResetModel();
+    d->column = column;
+    IndexFilter_Search(*d);
+    endResetModel();
+}
+
+void
+IndexFilter::setPrefix(const QString &prefix) noexcept
+{
+    d->query = prefix;
+
+    std::string value = prefix.toStdString();
+
+    bool narrowing = d->column == 0 && value.size() >= d->prefix.size() && IndexFilter_Compare(std::string_view(value).substr(0, d->prefix.size()), d->prefix) == 0;
+
+    d->prefix = std::move(value);
+
+    if (!d->source || !d->source->container()) {
+        return;
+    }
+
+    // A longer prefix is found inside the current range, anything else is
+    // searched again from the whole index.
+    if (!narrowing) {
+        beginResetModel();
+        IndexFilter_Search(*d);
+        endResetModel();
+
+        return;
+    }
+
+    int first = 0;
+    int last = 0;
+
+    IndexFilter_Range(*d, d->first, d->last, first, last);
+
+    // Rows before and after the new range leave, the rest stay in place for
+    // the view.
+    int front = std::min(first - d->first, d->loaded);
+
+    if (front > 0) {
+        beginRemoveRows({}, 0, front - 1);
+        d->first += front;
+        d->loaded -= front;
+        endRemoveRows();
+    }
+
+    d->first = first;
+
+    int kept = std::min(d->loaded, last - first);
+
+    if (kept < d->loaded) {
+        beginRemoveRows({}, kept, d->loaded - 1);
+        d->loaded = kept;
+        endRemoveRows();
+    }
+
+    d->last = last;
+
+    if (d->loaded < kFetchRows) {
+        fetchMore({});
+    }
+}
+
+// Called inside a model reset, with the source pointing to its new rows.
+void
+IndexFilter::rebuild() noexcept
+{
+    d->order.clear();
+    d->position.clear();
+
+    const BHF::File::IndexContainer *container = d->source ? d->source->container() : nullptr;
+
+    int size = container ? static_cast<int>(container->size()) : 0;
+
+    auto less = [](const BHF::File::IndexType &a, const BHF::File::IndexType &b) -> bool {
+        return IndexFilter_Compare(a.index, b.index) < 0;
+    };
+
+    // Upper case keys come sorted by the help compiler, mixed case ones are
+    // sorted with case and need the permutation.
+    if (container && !std::is_sorted(container->begin(), container->end(), less)) {
+        d->order.resize(static_cast<usize>(size));
+        d->position.resize(static_cast<usize>(size));
+
+        std::iota(d->order.begin(), d->order.end(), 0);
+
+        std::stable_sort(d->order.begin(), d->order.end(), [container, &less](int a, int b) {
+            return less((*container)[static_cast<usize>(a)], (*container)[static_cast<usize>(b)]);
+        });
+
+        for (int i = 0; i < size; ++i) {
+            d->position[static_cast<usize>(d->order[static_cast<usize>(i)])] = i;
+        }
+    }
+
+    IndexFilter_Search(*d);
+}
+
 } // namespace Model
 } // namespace GUI
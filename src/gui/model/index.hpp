@@ -24,15 +24,52 @@ public:
     virtual int columnCount(const QModelIndex &parent) const override;
     virtual QVariant data(const QModelIndex &index, int role) const override;
 
-    void update(const BHF::File::IndexContainer &container) noexcept;
+    // Shows `container` without copying it, it must outlive the model or be
+    // replaced first. nullptr empties the model.
+    void update(const BHF::File::IndexContainer *container) noexcept;
+
+    const BHF::File::IndexContainer *container() const noexcept;
 
 private:
     std::unique_ptr<IndexData> d;
 };
 
-class IndexFilter : public QSortFilterProxyModel {
+struct IndexFilterData;
+
+// Rows of an Index whose key starts with a prefix, without regard to case.
+// In key order those rows are a single range, found by binary search, and
+// typing one more character only narrows it. The context column can be
+// searched instead, by a scan. Rows are handed to the view a batch at a
+// time through fetchMore().
+class IndexFilter : public QAbstractProxyModel
+{
+    Q_OBJECT
+
 public:
     explicit IndexFilter(QObject *parent = nullptr) noexcept;
+    ~IndexFilter() noexcept;
+
+    // Must be an Index.
+    virtual void setSourceModel(QAbstractItemModel *model) override;
+
+    virtual QModelIndex mapToSource(const QModelIndex &proxy) const override;
+    virtual QModelIndex mapFromSource(const QModelIndex &source) const override;
+    virtual QVariant headerData(int section, Qt::Orientation orientation, int role) const override;
+    virtual QModelIndex index(int row, int column, const QModelIndex &parent) const override;
+    virtual QModelIndex parent(const QModelIndex &child) const override;
+    virtual int rowCount(const QModelIndex &parent) const override;
+    virtual int columnCount(const QModelIndex &parent) const override;
+    virtual bool canFetchMore(const QModelIndex &parent) const override;
+    virtual void fetchMore(const QModelIndex &parent) override;
+
+    // 0 searches the keys, 1 the context numbers.
+    void setFilterColumn(int column) noexcept;
+    void setPrefix(const QString &prefix) noexcept;
+
+private:
+    void rebuild() noexcept;
+
+    std::unique_ptr<IndexFilterData> d;
 };
 
 } // namespace Model
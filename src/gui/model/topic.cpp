@@ -0,0 +1,136 @@
+// SPDX-License-Identifier: MIT
+// Copyright (c) 2022 Gustavo Ribeiro Croscato
+
+#include "bhf/format.hpp"
+#include "topic.hpp"
+
+namespace GUI {
+namespace Model {
+
+// Receives the structure of the topic from BHF::formatText().
+struct TopicEmitter {
+    void begin() noexcept
+    {
+        beginLine();
+    }
+
+    void end() noexcept
+    {
+        endLine();
+    }
+
+    void text(std::string_view run) noexcept
+    {
+        int begin = static_cast<int>(document.text.size());
+        int length = static_cast<int>(run.size());
+
+        // Straight from CP437 into the QString, one code unit a character.
+        document.text.resize(begin + length);
+
+        BHF::convertUTF16(run, reinterpret_cast<char16_t *>(document.text.data()) + begin);
+
+        TopicDocument::Line &line = document.lines.back();
+
+        line.length += length;
+
+        if (static_cast<int>(document.runs.size()) > line.run) {
+            TopicDocument::Run &last = document.runs.back();
+
+            if (last.type == type && last.context == context && last.begin + last.length == begin) {
+                last.length += length;
+
+                return;
+            }
+        }
+
+        document.runs.push_back({begin, length, type, context});
+    }
+
+    void newLine() noexcept
+    {
+        endLine();
+        beginLine();
+    }
+
+    void keywordBegin(BHF::File::ContextType target) noexcept
+    {
+        type = TopicDocument::Keyword;
+        context = target;
+    }
+
+    void keywordEnd() noexcept
+    {
+        type = in_code ? TopicDocument::Code : TopicDocument::Text;
+        context = -1;
+    }
+
+    void codeBegin() noexcept
+    {
+        in_code = true;
+
+        if (type == TopicDocument::Text) {
+            type = TopicDocument::Code;
+        }
+    }
+
+    void codeEnd() noexcept
+    {
+        in_code = false;
+
+        if (type == TopicDocument::Code) {
+            type = TopicDocument::Text;
+        }
+    }
+
+    void beginLine() noexcept
+    {
+        document.lines.push_back({static_cast<int>(document.text.size()), 0, static_cast<int>(document.runs.size())});
+    }
+
+    void endLine() noexcept
+    {
+        document.columns = std::max(document.columns, document.lines.back().length);
+    }
+
+    TopicDocument &document;
+    TopicDocument::RunType type = TopicDocument::Text;
+    BHF::File::ContextType context = -1;
+    bool in_code = false;
+};
+
+int
+TopicDocument::runBegin(int line) const noexcept
+{
+    return lines[static_cast<usize>(line)].run;
+}
+
+int
+TopicDocument::runEnd(int line) const noexcept
+{
+    return static_cast<usize>(line) + 1 < lines.size() ? lines[static_cast<usize>(line) + 1].run : static_cast<int>(runs.size());
+}
+
+usize
+TopicDocument::memory() const noexcept
+{
+    return sizeof(*this) + static_cast<usize>(text.capacity()) * sizeof(QChar) + runs.capacity() * sizeof(Run) + lines.capacity() * sizeof(Line);
+}
+
+std::shared_ptr<const TopicDocument>
+TopicDocument::build(const BHF::File &file, BHF::File::ContextType offset) noexcept
+{
+    std::shared_ptr<TopicDocument> result = std::make_shared<TopicDocument>();
+
+    std::string text = file.text(offset, BHF::File::Raw);
+
+    result->text.reserve(static_cast<qsizetype>(text.size()));
+
+    TopicEmitter emitter{*result};
+
+    BHF::formatText(text, file.keywords(offset), emitter);
+
+    return result;
+}
+
+} // namespace Model
+} // namespace GUI
@@ -0,0 +1,64 @@
+// SPDX-License-Identifier: MIT
+// Copyright (c) 2022 Gustavo Ribeiro Croscato
+
+#ifndef BHFCONVERTER_SRC_GUI_MODEL_TOPIC_HPP
+#define BHFCONVERTER_SRC_GUI_MODEL_TOPIC_HPP 1
+
+#include "bhf/file.hpp"
+
+namespace GUI {
+namespace Model {
+
+// A topic as UI::TopicView paints it: a grid of characters, one per cell,
+// line by line, and the runs of plain text, keywords and code over it.
+// Built on any thread, then shared read only.
+struct TopicDocument {
+    enum RunType : u8 {
+          Text
+        , Keyword
+        , Code
+    };
+
+    // Part of a line, runs never cross lines.
+    struct Run {
+        // Position in `text`.
+        int begin;
+        int length;
+        RunType type;
+
+        // Context number a Keyword links to.
+        BHF::File::ContextType context;
+    };
+
+    struct Line {
+        // Position in `text`.
+        int begin;
+        int length;
+
+        // First run of the line, they go on up to the first run of the next
+        // one.
+        int run;
+    };
+
+    // Every line one after the other, without line breaks.
+    QString text;
+    std::vector<Run> runs;
+    std::vector<Line> lines;
+
+    // Length of the longest line.
+    int columns = 0;
+
+    // Runs of `line` are [runBegin(line), runEnd(line)).
+    int runBegin(int line) const noexcept;
+    int runEnd(int line) const noexcept;
+
+    // Bytes held, to weigh it in a cache.
+    usize memory() const noexcept;
+
+    static std::shared_ptr<const TopicDocument> build(const BHF::File &file, BHF::File::ContextType offset) noexcept;
+};
+
+} // namespace Model
+} // namespace GUI
+
+#endif // BHFCONVERTER_SRC_GUI_MODEL_TOPIC_HPP
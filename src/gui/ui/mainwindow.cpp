@@ -1,16 +1,60 @@
 // SPDX-License-Identifier: MIT
 // Copyright (c) 2022 Gustavo Ribeiro Croscato
 
+#include <atomic>
+#include <deque>
+#include <thread>
+
 #include "bhf/file.hpp"
 #include "model/context.hpp"
 #include "model/index.hpp"
+#include "model/topic.hpp"
 #include "mainwindow.hpp"
+#include "topicview.hpp"
 
 namespace GUI {
 namespace UI {
 
+// Help file opened at startup, when there is one.
+static constexpr const char *kDefaultFile = "data/tchelp.tch";
+
+// Files are read this much at a time, between progress updates.
+static constexpr qint64 kReadChunk = 1024 * 1024;
+
+// Share of the progress bar for reading, parsing takes the rest.
+static constexpr int kReadProgress = 90;
+
+// Decoded topics kept, in KiB.
+static constexpr int kRenderedKiB = 16 * 1024;
+
+// Link targets of a topic rendered ahead of a click.
+static constexpr int kPrefetchTopics = 16;
+
+// Topics kept for back and forward.
+static constexpr usize kHistorySize = 256;
+
+// The topic asked for runs before any prefetch.
+static constexpr int kRenderPriority = 1;
+static constexpr int kPrefetchPriority = 0;
+
+using TopicDocumentPointer = std::shared_ptr<const Model::TopicDocument>;
+
+// A visited topic and where it was scrolled to when left.
+struct HistoryEntry {
+    BHF::File::ContextType offset;
+    QPoint scroll;
+};
+
 struct MainWindowData {
-    BHF::File help_file;
+    // Replaced as a whole when another file is opened, workers keep the one
+    // they started with.
+    std::shared_ptr<const BHF::File> help_file = std::make_shared<BHF::File>();
+
+    // Opens a file off the GUI thread, one at a time behind a modal
+    // progress dialog.
+    std::thread loader;
+    std::atomic<bool> loader_cancel = false;
+    QProgressDialog *progress = nullptr;
 
     QLabel *stamp = nullptr;
     QLabel *signature = nullptr;
@@ -23,12 +67,31 @@ struct MainWindowData {
     QTableView *tab_index = nullptr;
     QLineEdit *edit_context = nullptr;
     QLineEdit *edit_index = nullptr;
-    QTextBrowser *text = nullptr;
+    TopicView *text = nullptr;
 
     Model::Context *model_context = nullptr;
     Model::ContextFilter *proxy_context = nullptr;
     Model::Index *model_index = nullptr;
     Model::IndexFilter *proxy_index = nullptr;
+
+    // Topics are decoded on `pool`, a result is shown only when no other
+    // topic was opened since its generation.
+    QThreadPool pool;
+    u64 generation = 0;
+
+    // Offset to document, of topics shown and prefetched.
+    QCache<BHF::File::ContextType, TopicDocumentPointer> rendered{kRenderedKiB};
+    QSet<BHF::File::ContextType> prefetching;
+
+    // Visited topics, the current one at history_position. `shown` is the
+    // offset in the view, -1 while it waits for its topic.
+    std::deque<HistoryEntry> history;
+    usize history_position = 0;
+    BHF::File::ContextType shown = -1;
+
+    QAction *go_back = nullptr;
+    QAction *go_forward = nullptr;
+    QAction *go_home = nullptr;
 };
 
 static QString
@@ -45,6 +108,61 @@ versionFormatToStr(BHF::Version::Format format)
     return QObject::tr("Unknown");
 }
 
+// Safe on any thread, File decodes without changing itself.
+static TopicDocumentPointer
+renderTopic(const BHF::File &file, BHF::File::ContextType offset)
+{
+    return Model::TopicDocument::build(file, offset);
+}
+
+// Reads `path` a chunk at a time, calling progress(percent) when the
+// percentage changes. False on errors and when `cancel` is set.
+template<typename Progress>
+static bool
+readHelpFile(const QString &path, std::vector<u8> &buffer, const std::atomic<bool> &cancel, Progress &&progress, QString &error)
+{
+    QFile file(path);
+
+    if (!file.open(QIODevice::ReadOnly)) {
+        error = QObject::tr("Can't open file '%1': %2.").arg(path, file.errorString());
+
+        return false;
+    }
+
+    qint64 size = file.size();
+
+    buffer.resize(static_cast<usize>(size));
+
+    qint64 done = 0;
+    int percent = -1;
+
+    while (done < size) {
+        if (cancel) {
+            return false;
+        }
+
+        qint64 count = file.read(reinterpret_cast<char *>(buffer.data()) + done, std::min(kReadChunk, size - done));
+
+        if (count <= 0) {
+            error = QObject::tr("Error reading file '%1': %2.").arg(path, file.errorString());
+
+            return false;
+        }
+
+        done += count;
+
+        int current = static_cast<int>(done * 100 / size);
+
+        if (current != percent) {
+            percent = current;
+
+            progress(percent);
+        }
+    }
+
+    return true;
+}
+
 static QString
 compressionTypeToStr(BHF::Compression::Type type)
 {
@@ -72,16 +190,42 @@ MainWindow::MainWindow(QWidget *parent) noexcept
     setupMenus();
     setupUI();
 
-    d->help_file.open("data/tchelp.tch");
-
     refreshBHFInformation();
+
+    // Once the event loop runs, so the window shows up first.
+    if (QFile::exists(kDefaultFile)) {
+        QMetaObject::invokeMethod(this, [this]() -> void {
+            openFile(kDefaultFile);
+        }, Qt::QueuedConnection);
+    }
 }
 
-MainWindow::~MainWindow() noexcept = default;
+MainWindow::~MainWindow() noexcept
+{
+    // Workers read help_file and post back to this window.
+    d->loader_cancel = true;
+
+    if (d->loader.joinable()) {
+        d->loader.join();
+    }
+
+    d->pool.clear();
+    d->pool.waitForDone();
+
+    // The models point into help_file, which goes away before them.
+    d->model_context->update(nullptr);
+    d->model_index->update(nullptr);
+}
 
 void
 MainWindow::fileOpen() noexcept
-{}
+{
+    QString path = QFileDialog::getOpenFileName(this, tr("Open help file"), {}, tr("Help files (*.tch *.tph *.hlp);;All files (*)"));
+
+    if (!path.isEmpty()) {
+        openFile(path);
+    }
+}
 
 void
 MainWindow::fileQuit() noexcept
@@ -108,28 +252,24 @@ MainWindow::activatedIndex(const QModelIndex &index) noexcept
 
     int key = d->model_index->data(key_index, Qt::DisplayRole).toInt();
 
-    QModelIndex context_index = d->model_context->index(key, 1);
-
-    int context = d->model_context->data(context_index, Qt::DisplayRole).toInt();
-
-    openContext(context);
+    openContextNumber(key);
 }
 
 void
 MainWindow::refreshBHFInformation() noexcept
 {
-    d->stamp->setText(tr("<b>Stamp</b>: %1").arg(d->help_file.stamp().c_str()));
+    d->stamp->setText(tr("<b>Stamp</b>: %1").arg(d->help_file->stamp().c_str()));
 
-    d->signature->setText(tr("<b>Signature</b>: %1").arg(QString::fromStdString(d->help_file.signature())));
+    d->signature->setText(tr("<b>Signature</b>: %1").arg(QString::fromStdString(d->help_file->signature())));
 
-    auto version = d->help_file.version();
+    auto version = d->help_file->version();
 
     d->version->setText(tr("<b>Version</b>: %1 (%2)")
         .arg(versionFormatToStr(version.format))
         .arg(version.text)
     );
 
-    auto file_header = d->help_file.fileHeader();
+    auto file_header = d->help_file->fileHeader();
 
     d->file_header->setText(tr("<b>File header</b>: options: %1, main index: %2, largest record: %3, size: %4x%5, left margin: %6")
        .arg(file_header.options)
@@ -140,7 +280,7 @@ MainWindow::refreshBHFInformation() noexcept
        .arg(file_header.left_margin)
     );
 
-    auto compression = d->help_file.compression();
+    auto compression = d->help_file->compression();
     QByteArray table(reinterpret_cast<const char *>(compression.table), 14);
 
     d->compression->setText(tr("<b>Compression</b>: %1 [%2]")
@@ -148,19 +288,309 @@ MainWindow::refreshBHFInformation() noexcept
         .arg(table.toHex(':'))
     );
 
-    d->model_context->update(d->help_file.context());
-    d->model_index->update(d->help_file.index());
+    d->rendered.clear();
+
+    d->model_context->update(&d->help_file->context());
+    d->model_index->update(&d->help_file->index());
 
     d->tab_context->resizeColumnsToContents();
     d->tab_index->resizeColumnsToContents();
 }
 
+// Reads and parses on `loader`, the progress dialog cancels it and
+// finishOpen() takes the result on the GUI thread.
+void
+MainWindow::openFile(const QString &path) noexcept
+{
+    if (d->loader.joinable()) {
+        return;
+    }
+
+    d->loader_cancel = false;
+
+    d->progress = new QProgressDialog(tr("Reading %1...").arg(path), tr("Cancel"), 0, 100, this);
+    d->progress->setWindowModality(Qt::WindowModal);
+    d->progress->setMinimumDuration(250);
+    d->progress->setAutoClose(false);
+    d->progress->setAutoReset(false);
+
+    connect(d->progress, &QProgressDialog::canceled, this, [this]() -> void {
+        d->loader_cancel = true;
+    });
+
+    d->loader = std::thread([this, path]() -> void {
+        auto progress = [this](int percent, const QString &label) -> void {
+            QMetaObject::invokeMethod(this, [this, percent, label]() -> void {
+                if (d->progress) {
+                    d->progress->setLabelText(label);
+                    d->progress->setValue(percent);
+                }
+            }, Qt::QueuedConnection);
+        };
+
+        std::shared_ptr<BHF::File> file = std::make_shared<BHF::File>();
+        std::vector<u8> buffer;
+        QString error;
+
+        QString reading = tr("Reading %1...").arg(path);
+
+        bool opened = readHelpFile(path, buffer, d->loader_cancel, [&](int percent) {
+            progress(percent * kReadProgress / 100, reading);
+        }, error);
+
+        if (opened && !d->loader_cancel) {
+            progress(kReadProgress, tr("Reading the context table and the index..."));
+
+            opened = file->open(std::move(buffer));
+
+            if (!opened) {
+                error = QString::fromStdString(file->lastError());
+            }
+        }
+
+        QMetaObject::invokeMethod(this, [this, path, file, opened, error]() -> void {
+            finishOpen(path, opened ? file : nullptr, error);
+        }, Qt::QueuedConnection);
+    });
+}
+
+// `file` is null when opening failed or was cancelled, `error` is empty in
+// the latter case.
+void
+MainWindow::finishOpen(const QString &path, std::shared_ptr<const BHF::File> file, const QString &error) noexcept
+{
+    // Its last act was posting this.
+    d->loader.join();
+
+    bool cancelled = d->loader_cancel;
+
+    d->progress->deleteLater();
+    d->progress = nullptr;
+
+    if (cancelled) {
+        return;
+    }
+
+    if (!file) {
+        QMessageBox::warning(this, tr("Open help file"), error);
+
+        return;
+    }
+
+    // Renders of the old file still running are dropped when they finish.
+    ++d->generation;
+
+    d->pool.clear();
+    d->prefetching.clear();
+
+    d->help_file = std::move(file);
+
+    d->history.clear();
+    d->history_position = 0;
+    d->shown = -1;
+
+    d->text->setDocument(nullptr);
+
+    setWindowFilePath(path);
+
+    refreshBHFInformation();
+    updateNavigation();
+
+    goHome();
+}
+
+// Goes to `context` as a new step of the history, dropping the steps
+// forward of the current one.
 void
 MainWindow::openContext(int context) noexcept
 {
-    std::string text = d->help_file.text(context, BHF::File::HTML);
+    saveScrollPosition();
+
+    if (!d->history.empty() && d->history[d->history_position].offset == context) {
+        loadContext(context, d->history[d->history_position].scroll);
+
+        return;
+    }
+
+    if (!d->history.empty()) {
+        d->history.erase(d->history.begin() + static_cast<isize>(d->history_position) + 1, d->history.end());
+    }
+
+    d->history.push_back({context, {0, 0}});
+
+    if (d->history.size() > kHistorySize) {
+        d->history.pop_front();
+    }
+
+    d->history_position = d->history.size() - 1;
+
+    loadContext(context, {0, 0});
+    updateNavigation();
+}
+
+void
+MainWindow::goBack() noexcept
+{
+    if (d->history_position == 0) {
+        return;
+    }
+
+    saveScrollPosition();
+
+    const HistoryEntry &entry = d->history[--d->history_position];
+
+    loadContext(entry.offset, entry.scroll);
+    updateNavigation();
+}
+
+void
+MainWindow::goForward() noexcept
+{
+    if (d->history_position + 1 >= d->history.size()) {
+        return;
+    }
+
+    saveScrollPosition();
+
+    const HistoryEntry &entry = d->history[++d->history_position];
+
+    loadContext(entry.offset, entry.scroll);
+    updateNavigation();
+}
+
+void
+MainWindow::goHome() noexcept
+{
+    openContextNumber(d->help_file->fileHeader().main_index);
+}
+
+// Into the current step, unless its topic is still on the way.
+void
+MainWindow::saveScrollPosition() noexcept
+{
+    if (!d->history.empty() && d->history[d->history_position].offset == d->shown) {
+        d->history[d->history_position].scroll = d->text->scrollPosition();
+    }
+}
+
+void
+MainWindow::updateNavigation() noexcept
+{
+    d->go_back->setEnabled(d->history_position > 0);
+    d->go_forward->setEnabled(d->history_position + 1 < d->history.size());
+    d->go_home->setEnabled(!d->help_file->context().empty());
+}
+
+// Shows `context` scrolled to `scroll`, from the cache or once decoded.
+void
+MainWindow::loadContext(int context, const QPoint &scroll) noexcept
+{
+    u64 generation = ++d->generation;
+
+    d->shown = -1;
+
+    // What was queued for the previous topic is not needed anymore.
+    d->pool.clear();
+    d->prefetching.clear();
+
+    if (const TopicDocumentPointer *document = d->rendered.object(context)) {
+        showTopic(context, *document, scroll);
+
+        return;
+    }
+
+    d->pool.start([this, file = d->help_file, context, scroll, generation]() -> void {
+        TopicDocumentPointer document = renderTopic(*file, context);
+
+        QMetaObject::invokeMethod(this, [this, file, context, scroll, generation, document]() -> void {
+            if (file != d->help_file) {
+                return;
+            }
+
+            cacheTopic(context, document);
+
+            if (generation == d->generation) {
+                showTopic(context, document, scroll);
+            }
+        }, Qt::QueuedConnection);
+    }, kRenderPriority);
+}
+
+void
+MainWindow::showTopic(int context, const TopicDocumentPointer &document, const QPoint &scroll) noexcept
+{
+    d->text->setDocument(document);
+    d->text->setScrollPosition(scroll);
+
+    d->shown = context;
+
+    prefetchLinks(context);
+}
+
+void
+MainWindow::cacheTopic(int context, const TopicDocumentPointer &document) noexcept
+{
+    int cost = static_cast<int>(document->memory() / 1024) + 1;
 
-    d->text->setHtml(QString::fromStdString(text));
+    d->rendered.insert(context, new TopicDocumentPointer(document), cost);
+}
+
+// Renders the keyword targets of `context` in the background, so following
+// a link usually finds its topic in the cache.
+void
+MainWindow::prefetchLinks(int context) noexcept
+{
+    const BHF::File::ContextContainer &contexts = d->help_file->context();
+    BHF::File::KeywordType keywords = d->help_file->keywords(context);
+
+    int queued = 0;
+
+    for (BHF::File::ContextType link : keywords.contexts) {
+        if (queued == kPrefetchTopics) {
+            break;
+        }
+
+        if (link < 0 || static_cast<usize>(link) >= contexts.size()) {
+            continue;
+        }
+
+        BHF::File::ContextType offset = contexts[static_cast<usize>(link)];
+
+        if (d->rendered.contains(offset) || d->prefetching.contains(offset)) {
+            continue;
+        }
+
+        d->prefetching.insert(offset);
+
+        ++queued;
+
+        d->pool.start([this, file = d->help_file, offset]() -> void {
+            TopicDocumentPointer document = renderTopic(*file, offset);
+
+            QMetaObject::invokeMethod(this, [this, file, offset, document]() -> void {
+                if (file != d->help_file) {
+                    return;
+                }
+
+                d->prefetching.remove(offset);
+
+                cacheTopic(offset, document);
+            }, Qt::QueuedConnection);
+        }, kPrefetchPriority);
+    }
+}
+
+// The context model may not have fetched the row yet, the file has them all.
+void
+MainWindow::openContextNumber(int context) noexcept
+{
+    const BHF::File::ContextContainer &contexts = d->help_file->context();
+
+    if (context < 0 || static_cast<usize>(context) >= contexts.size()) {
+        return;
+    }
+
+    openContext(contexts[static_cast<usize>(context)]);
 }
 
 void
@@ -183,6 +613,31 @@ MainWindow::setupMenus() noexcept
 
     connect(file_open, &QAction::triggered, this, &MainWindow::fileOpen);
     connect(file_quit, &QAction::triggered, this, &MainWindow::fileQuit);
+
+    // Go
+    QMenu *go = new QMenu(tr("&Go"), this);
+
+    d->go_back = go->addAction(style()->standardIcon(QStyle::SP_ArrowBack), tr("&Back"));
+    d->go_back->setShortcut(QKeySequence::Back);
+
+    d->go_forward = go->addAction(style()->standardIcon(QStyle::SP_ArrowForward), tr("&Forward"));
+    d->go_forward->setShortcut(QKeySequence::Forward);
+
+    d->go_home = go->addAction(style()->standardIcon(QStyle::SP_DirHomeIcon), tr("&Home"));
+    d->go_home->setShortcut(tr("Alt+Home"));
+
+    menu_bar->addMenu(go);
+
+    QToolBar *navigation = addToolBar(tr("Navigation"));
+    navigation->addAction(d->go_back);
+    navigation->addAction(d->go_forward);
+    navigation->addAction(d->go_home);
+
+    connect(d->go_back, &QAction::triggered, this, &MainWindow::goBack);
+    connect(d->go_forward, &QAction::triggered, this, &MainWindow::goForward);
+    connect(d->go_home, &QAction::triggered, this, &MainWindow::goHome);
+
+    updateNavigation();
 }
 
 void
@@ -238,10 +693,12 @@ MainWindow::setupUI() noexcept
         d->proxy_context->setFilterKeyColumn(index);
     };
 
+    // The index stays in key order, its header only picks the column the
+    // search looks at.
     auto sort_index = [this](int index, Qt::SortOrder order) -> void {
         Q_UNUSED(order);
 
-        d->proxy_index->setFilterKeyColumn(index);
+        d->proxy_index->setFilterColumn(index);
     };
 
     connect(d->tab_context->horizontalHeader(), &QHeaderView::sortIndicatorChanged, sort_context);
@@ -255,7 +712,7 @@ MainWindow::setupUI() noexcept
     };
 
     auto search_index = [this](const QString &search)->void {
-       d->proxy_index->setFilterRegularExpression(QRegularExpression::fromWildcard(search + "*"));
+        d->proxy_index->setPrefix(search);
     };
 
     connect(d->edit_context, &QLineEdit::textChanged, search_context);
@@ -268,8 +725,9 @@ MainWindow::setupUI() noexcept
 
     d->tab_index->setModel(d->proxy_index);
     d->tab_index->setSelectionBehavior(QAbstractItemView::SelectRows);
-    d->tab_index->setSortingEnabled(true);
-    d->tab_index->sortByColumn(0, Qt::AscendingOrder);
+    d->tab_index->horizontalHeader()->setSectionsClickable(true);
+    d->tab_index->horizontalHeader()->setSortIndicatorShown(true);
+    d->tab_index->horizontalHeader()->setSortIndicator(0, Qt::AscendingOrder);
 
     QVBoxLayout *layout_context = new QVBoxLayout;
     layout_context->addWidget(d->edit_context);
@@ -295,22 +753,15 @@ MainWindow::setupUI() noexcept
     d->tab_context->verticalHeader()->setVisible(false);
     d->tab_index->verticalHeader()->setVisible(false);
 
-    d->text = new QTextBrowser;
+    d->text = new TopicView;
     d->text->setFont(font_fixed);
-    d->text->setOpenLinks(false);
     d->text->setSizePolicy(QSizePolicy::MinimumExpanding, QSizePolicy::MinimumExpanding);
 
-    auto link_context = [this](const QUrl &url)->void {
-        BHF::File::ContextType context = url.path().toInt();
-
-        QModelIndex context_index = d->model_context->index(context, 1);
-
-        BHF::File::ContextType offset = d->model_context->data(context_index, Qt::DisplayRole).toInt();
-
-        openContext(offset);
+    auto link_context = [this](int context)->void {
+        openContextNumber(context);
     };
 
-    connect(d->text, &QTextBrowser::anchorClicked, link_context);
+    connect(d->text, &TopicView::linkActivated, link_context);
 
     main_layout->addWidget(d->tab);
     main_layout->addWidget(d->text);
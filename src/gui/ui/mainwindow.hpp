@@ -6,6 +6,16 @@
 
 class QModelIndex;
 
+namespace BHF {
+class File;
+} // namespace BHF
+
+namespace GUI {
+namespace Model {
+struct TopicDocument;
+} // namespace Model
+} // namespace GUI
+
 namespace GUI {
 namespace UI {
 
@@ -26,9 +36,22 @@ private slots:
     void activatedContext(const QModelIndex &index) noexcept;
     void activatedIndex(const QModelIndex &index) noexcept;
 
+    void goBack() noexcept;
+    void goForward() noexcept;
+    void goHome() noexcept;
+
 private:
+    void openFile(const QString &path) noexcept;
+    void finishOpen(const QString &path, std::shared_ptr<const BHF::File> file, const QString &error) noexcept;
     void refreshBHFInformation() noexcept;
     void openContext(int context) noexcept;
+    void openContextNumber(int context) noexcept;
+    void loadContext(int context, const QPoint &scroll) noexcept;
+    void saveScrollPosition() noexcept;
+    void updateNavigation() noexcept;
+    void showTopic(int context, const std::shared_ptr<const Model::TopicDocument> &document, const QPoint &scroll) noexcept;
+    void cacheTopic(int context, const std::shared_ptr<const Model::TopicDocument> &document) noexcept;
+    void prefetchLinks(int context) noexcept;
     void setupMenus() noexcept;
     void setupUI() noexcept;
 
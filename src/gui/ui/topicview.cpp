@@ -0,0 +1,452 @@
+// SPDX-License-Identifier: MIT
+// Copyright (c) 2022 Gustavo Ribeiro Croscato
+
+#include "topicview.hpp"
+
+namespace GUI {
+namespace UI {
+
+using Model::TopicDocument;
+
+// A place between two cells, `column` goes up to the line length.
+struct TopicPosition {
+    int line;
+    int column;
+
+    bool operator==(const TopicPosition &other) const noexcept
+    {
+        return line == other.line && column == other.column;
+    }
+
+    bool operator<(const TopicPosition &other) const noexcept
+    {
+        return line != other.line ? line < other.line : column < other.column;
+    }
+};
+
+struct TopicViewData {
+    std::shared_ptr<const TopicDocument> document;
+
+    // Glyph metrics of the font, every character takes one cell.
+    QFont font_code;
+    QFont font_keyword;
+    int cell_width = 1;
+    int cell_height = 1;
+    int ascent = 0;
+
+    // Selection between anchor and cursor, empty when they are equal.
+    TopicPosition anchor{0, 0};
+    TopicPosition cursor{0, 0};
+    bool selecting = false;
+
+    // Run of the keyword under the mouse press, -1 for none.
+    int pressed_link = -1;
+};
+
+static int
+TopicView_Clamp(int value, int low, int high) noexcept
+{
+    return std::max(low, std::min(value, high));
+}
+
+// Nearest place between cells to `point`, inside the document.
+static TopicPosition
+TopicView_PositionAt(const TopicView &view, const TopicViewData &data, const QPoint &point) noexcept
+{
+    const TopicDocument &document = *data.document;
+
+    if (document.lines.empty()) {
+        return {0, 0};
+    }
+
+    int line = view.verticalScrollBar()->value() + point.y() / data.cell_height;
+
+    if (point.y() < 0) {
+        line = view.verticalScrollBar()->value() - 1;
+    }
+
+    line = TopicView_Clamp(line, 0, static_cast<int>(document.lines.size()) - 1);
+
+    int column = view.horizontalScrollBar()->value() + (point.x() + data.cell_width / 2) / data.cell_width;
+
+    return {line, TopicView_Clamp(column, 0, document.lines[static_cast<usize>(line)].length)};
+}
+
+// Run of the keyword in the cell under `point`, -1 when there is none.
+static int
+TopicView_LinkAt(const TopicView &view, const TopicViewData &data, const QPoint &point) noexcept
+{
+    if (!data.document || point.x() < 0 || point.y() < 0) {
+        return -1;
+    }
+
+    const TopicDocument &document = *data.document;
+
+    int line = view.verticalScrollBar()->value() + point.y() / data.cell_height;
+    int column = view.horizontalScrollBar()->value() + point.x() / data.cell_width;
+
+    if (line >= static_cast<int>(document.lines.size())) {
+        return -1;
+    }
+
+    int position = document.lines[static_cast<usize>(line)].begin + column;
+
+    for (int r = document.runBegin(line); r < document.runEnd(line); ++r) {
+        const TopicDocument::Run &run = document.runs[static_cast<usize>(r)];
+
+        if (run.type == TopicDocument::Keyword && run.context >= 0 && run.begin <= position && position < run.begin + run.length) {
+            return r;
+        }
+    }
+
+    return -1;
+}
+
+TopicView::TopicView(QWidget *parent) noexcept
+    : QAbstractScrollArea(parent)
+    , d{std::make_unique<TopicViewData>()}
+{
+    viewport()->setMouseTracking(true);
+    viewport()->setCursor(Qt::IBeamCursor);
+
+    setFocusPolicy(Qt::StrongFocus);
+
+    updateMetrics();
+}
+
+TopicView::~TopicView() noexcept = default;
+
+void
+TopicView::setDocument(std::shared_ptr<const TopicDocument> document) noexcept
+{
+    d->document = std::move(document);
+    d->anchor = d->cursor = {0, 0};
+    d->selecting = false;
+    d->pressed_link = -1;
+
+    verticalScrollBar()->setValue(0);
+    horizontalScrollBar()->setValue(0);
+
+    updateScrollBars();
+
+    viewport()->update();
+}
+
+const std::shared_ptr<const TopicDocument> &
+TopicView::document() const noexcept
+{
+    return d->document;
+}
+
+QString
+TopicView::selectedText() const noexcept
+{
+    if (!d->document || d->anchor == d->cursor) {
+        return {};
+    }
+
+    const TopicDocument &document = *d->document;
+
+    TopicPosition first = std::min(d->anchor, d->cursor);
+    TopicPosition last = std::max(d->anchor, d->cursor);
+
+    QString result;
+
+    for (int i = first.line; i <= last.line; ++i) {
+        const TopicDocument::Line &line = document.lines[static_cast<usize>(i)];
+
+        int begin = i == first.line ? first.column : 0;
+        int end = i == last.line ? last.column : line.length;
+
+        result += QStringView(document.text).mid(line.begin + begin, end - begin);
+
+        if (i != last.line) {
+            result += QLatin1Char('\n');
+        }
+    }
+
+    return result;
+}
+
+QPoint
+TopicView::scrollPosition() const noexcept
+{
+    return {horizontalScrollBar()->value(), verticalScrollBar()->value()};
+}
+
+void
+TopicView::setScrollPosition(const QPoint &position) noexcept
+{
+    horizontalScrollBar()->setValue(position.x());
+    verticalScrollBar()->setValue(position.y());
+}
+
+// Cells of the visible area, from the scroll bars in lines and columns.
+void
+TopicView::paintEvent(QPaintEvent *event)
+{
+    QPainter painter(viewport());
+
+    painter.fillRect(event->rect(), palette().base());
+
+    if (!d->document) {
+        return;
+    }
+
+    const TopicDocument &document = *d->document;
+
+    int first_line = verticalScrollBar()->value();
+    int first_column = horizontalScrollBar()->value();
+
+    int line_count = static_cast<int>(document.lines.size());
+    int last_line = std::min(line_count, first_line + viewport()->height() / d->cell_height + 2);
+    int visible_columns = viewport()->width() / d->cell_width + 2;
+
+    TopicPosition selection_first = std::min(d->anchor, d->cursor);
+    TopicPosition selection_last = std::max(d->anchor, d->cursor);
+
+    QColor color_text = palette().color(QPalette::Text);
+    QColor color_link = palette().color(QPalette::Link);
+
+    for (int i = first_line; i < last_line; ++i) {
+        const TopicDocument::Line &line = document.lines[static_cast<usize>(i)];
+
+        int y = (i - first_line) * d->cell_height;
+
+        if (selection_first < selection_last && selection_first.line <= i && i <= selection_last.line) {
+            int begin = i == selection_first.line ? selection_first.column : 0;
+
+            // A selected line break shows as one more cell.
+            int end = i == selection_last.line ? selection_last.column : line.length + 1;
+
+            painter.fillRect((begin - first_column) * d->cell_width, y, (end - begin) * d->cell_width, d->cell_height, palette().highlight());
+        }
+
+        int visible_begin = line.begin + first_column;
+        int visible_end = line.begin + std::min(line.length, first_column + visible_columns);
+
+        for (int r = document.runBegin(i); r < document.runEnd(i); ++r) {
+            const TopicDocument::Run &run = document.runs[static_cast<usize>(r)];
+
+            int begin = std::max(run.begin, visible_begin);
+            int end = std::min(run.begin + run.length, visible_end);
+
+            if (begin >= end) {
+                continue;
+            }
+
+            switch (run.type) {
+                case TopicDocument::Text:
+                    painter.setFont(font());
+                    painter.setPen(color_text);
+                    break;
+
+                case TopicDocument::Keyword:
+                    painter.setFont(d->font_keyword);
+                    painter.setPen(color_link);
+                    break;
+
+                case TopicDocument::Code:
+                    painter.setFont(d->font_code);
+                    painter.setPen(color_text);
+                    break;
+            }
+
+            int x = (begin - line.begin - first_column) * d->cell_width;
+
+            painter.drawText(QPoint(x, y + d->ascent), QString::fromRawData(document.text.constData() + begin, end - begin));
+        }
+    }
+}
+
+void
+TopicView::resizeEvent(QResizeEvent *event)
+{
+    QAbstractScrollArea::resizeEvent(event);
+
+    updateScrollBars();
+}
+
+void
+TopicView::changeEvent(QEvent *event)
+{
+    QAbstractScrollArea::changeEvent(event);
+
+    if (event->type() == QEvent::FontChange) {
+        updateMetrics();
+        updateScrollBars();
+
+        viewport()->update();
+    }
+}
+
+void
+TopicView::mousePressEvent(QMouseEvent *event)
+{
+    if (event->button() != Qt::LeftButton || !d->document) {
+        QAbstractScrollArea::mousePressEvent(event);
+
+        return;
+    }
+
+    QPoint point = event->position().toPoint();
+
+    d->pressed_link = TopicView_LinkAt(*this, *d, point);
+    d->anchor = d->cursor = TopicView_PositionAt(*this, *d, point);
+    d->selecting = true;
+
+    viewport()->update();
+}
+
+void
+TopicView::mouseMoveEvent(QMouseEvent *event)
+{
+    if (!d->document) {
+        return;
+    }
+
+    QPoint point = event->position().toPoint();
+
+    if (d->selecting) {
+        d->cursor = TopicView_PositionAt(*this, *d, point);
+
+        if (d->pressed_link >= 0 && TopicView_LinkAt(*this, *d, point) != d->pressed_link) {
+            d->pressed_link = -1;
+        }
+
+        viewport()->update();
+
+        return;
+    }
+
+    viewport()->setCursor(TopicView_LinkAt(*this, *d, point) >= 0 ? Qt::PointingHandCursor : Qt::IBeamCursor);
+}
+
+void
+TopicView::mouseReleaseEvent(QMouseEvent *event)
+{
+    if (event->button() != Qt::LeftButton || !d->selecting) {
+        QAbstractScrollArea::mouseReleaseEvent(event);
+
+        return;
+    }
+
+    d->selecting = false;
+
+    // A click, not a drag, on the keyword it started on.
+    if (d->pressed_link >= 0 && d->anchor == d->cursor) {
+        int context = d->document->runs[static_cast<usize>(d->pressed_link)].context;
+
+        d->pressed_link = -1;
+
+        emit linkActivated(context);
+
+        return;
+    }
+
+    d->pressed_link = -1;
+
+    if (QGuiApplication::clipboard()->supportsSelection()) {
+        QGuiApplication::clipboard()->setText(selectedText(), QClipboard::Selection);
+    }
+}
+
+// Selects the word under the mouse.
+void
+TopicView::mouseDoubleClickEvent(QMouseEvent *event)
+{
+    if (event->button() != Qt::LeftButton || !d->document) {
+        QAbstractScrollArea::mouseDoubleClickEvent(event);
+
+        return;
+    }
+
+    TopicPosition position = TopicView_PositionAt(*this, *d, event->position().toPoint());
+
+    const TopicDocument::Line &line = d->document->lines[static_cast<usize>(position.line)];
+    const QChar *text = d->document->text.constData() + line.begin;
+
+    auto is_word = [text](int column) -> bool {
+        return text[column].isLetterOrNumber() || text[column] == QLatin1Char('_');
+    };
+
+    int begin = std::min(position.column, line.length);
+    int end = begin;
+
+    while (begin > 0 && is_word(begin - 1)) {
+        --begin;
+    }
+
+    while (end < line.length && is_word(end)) {
+        ++end;
+    }
+
+    d->anchor = {position.line, begin};
+    d->cursor = {position.line, end};
+    d->selecting = false;
+    d->pressed_link = -1;
+
+    viewport()->update();
+}
+
+void
+TopicView::keyPressEvent(QKeyEvent *event)
+{
+    if (event->matches(QKeySequence::Copy)) {
+        QString text = selectedText();
+
+        if (!text.isEmpty()) {
+            QGuiApplication::clipboard()->setText(text);
+        }
+
+        return;
+    }
+
+    if (event->matches(QKeySequence::SelectAll) && d->document && !d->document->lines.empty()) {
+        int last = static_cast<int>(d->document->lines.size()) - 1;
+
+        d->anchor = {0, 0};
+        d->cursor = {last, d->document->lines.back().length};
+
+        viewport()->update();
+
+        return;
+    }
+
+    QAbstractScrollArea::keyPressEvent(event);
+}
+
+void
+TopicView::updateMetrics() noexcept
+{
+    QFontMetrics metrics(font());
+
+    d->cell_width = std::max(1, metrics.horizontalAdvance(QLatin1Char('M')));
+    d->cell_height = std::max(1, metrics.height());
+    d->ascent = metrics.ascent();
+
+    d->font_code = font();
+    d->font_code.setBold(true);
+
+    d->font_keyword = font();
+    d->font_keyword.setUnderline(true);
+}
+
+void
+TopicView::updateScrollBars() noexcept
+{
+    int lines = d->document ? static_cast<int>(d->document->lines.size()) : 0;
+    int columns = d->document ? d->document->columns : 0;
+
+    int visible_lines = std::max(1, viewport()->height() / d->cell_height);
+    int visible_columns = std::max(1, viewport()->width() / d->cell_width);
+
+    verticalScrollBar()->setRange(0, std::max(0, lines - visible_lines));
+    verticalScrollBar()->setPageStep(visible_lines);
+
+    horizontalScrollBar()->setRange(0, std::max(0, columns + 1 - visible_columns));
+    horizontalScrollBar()->setPageStep(visible_columns);
+}
+
+} // namespace UI
+} // namespace GUI
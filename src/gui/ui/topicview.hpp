@@ -0,0 +1,59 @@
+// SPDX-License-Identifier: MIT
+// Copyright (c) 2022 Gustavo Ribeiro Croscato
+
+#ifndef BHFCONVERTER_SRC_GUI_UI_TOPICVIEW_HPP
+#define BHFCONVERTER_SRC_GUI_UI_TOPICVIEW_HPP 1
+
+#include "model/topic.hpp"
+
+namespace GUI {
+namespace UI {
+
+struct TopicViewData;
+
+// Paints a Model::TopicDocument straight from its runs in a fixed width
+// grid, only the visible cells, with keyword links and text selection.
+// Scrolls by lines and columns.
+class TopicView : public QAbstractScrollArea
+{
+    Q_OBJECT
+
+public:
+    explicit TopicView(QWidget *parent = nullptr) noexcept;
+    ~TopicView() noexcept;
+
+    // nullptr clears the view.
+    void setDocument(std::shared_ptr<const Model::TopicDocument> document) noexcept;
+    const std::shared_ptr<const Model::TopicDocument> &document() const noexcept;
+
+    QString selectedText() const noexcept;
+
+    // First column and line in view, setDocument() starts at the top.
+    QPoint scrollPosition() const noexcept;
+    void setScrollPosition(const QPoint &position) noexcept;
+
+signals:
+    // Context number of the keyword clicked.
+    void linkActivated(int context);
+
+protected:
+    virtual void paintEvent(QPaintEvent *event) override;
+    virtual void resizeEvent(QResizeEvent *event) override;
+    virtual void changeEvent(QEvent *event) override;
+    virtual void mousePressEvent(QMouseEvent *event) override;
+    virtual void mouseMoveEvent(QMouseEvent *event) override;
+    virtual void mouseReleaseEvent(QMouseEvent *event) override;
+    virtual void mouseDoubleClickEvent(QMouseEvent *event) override;
+    virtual void keyPressEvent(QKeyEvent *event) override;
+
+private:
+    void updateMetrics() noexcept;
+    void updateScrollBars() noexcept;
+
+    std::unique_ptr<TopicViewData> d;
+};
+
+} // namespace UI
+} // namespace GUI
+
+#endif // BHFCONVERTER_SRC_GUI_UI_TOPICVIEW_HPP
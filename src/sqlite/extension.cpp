@@ -0,0 +1,638 @@
+// SPDX-License-Identifier: MIT
+// Copyright (c) 2022 Gustavo Ribeiro Croscato
+
+// Loadable SQLite extension exposing a help file as virtual tables:
+//
+//   .load ./bhf
+//   CREATE VIRTUAL TABLE temp.help_text USING bhf_text('tchelp.tch');
+//   SELECT text FROM help_text WHERE context = 42;
+//
+// bhf_context(context, offset)
+// bhf_index(key, context)
+// bhf_text(context, text, html, raw)
+// bhf_keyword(context, up, down, position, target)
+//
+// Rows are decoded only when a column asks for them, `context = ?` becomes
+// a direct lookup and key comparisons/prefix patterns on bhf_index become a
+// binary search over the sorted index.
+
+#include <algorithm>
+#include <map>
+#include <mutex>
+
+#include <sqlite3ext.h>
+
+#include "bhf/file.hpp"
+
+#pragma GCC diagnostic push
+#pragma GCC diagnostic ignored "-Wzero-as-null-pointer-constant"
+
+SQLITE_EXTENSION_INIT1
+
+#pragma GCC diagnostic pop
+
+namespace SQLite {
+
+enum class Kind {
+      Context
+    , Index
+    , Text
+    , Keyword
+};
+
+// Constraint codes stored 4 bits per argument in idxNum.
+enum Operation : int {
+      OpNone
+    , OpContextEq
+    , OpKeyEq
+    , OpKeyGt
+    , OpKeyGe
+    , OpKeyLt
+    , OpKeyLe
+    , OpKeyLike
+    , OpKeyGlob
+};
+
+static constexpr int kMaxArguments = 7;
+
+struct Table {
+    sqlite3_vtab base;
+    Kind kind;
+    std::shared_ptr<const BHF::File> file;
+    bool index_sorted;
+};
+
+struct Cursor {
+    sqlite3_vtab_cursor base;
+    Table *table;
+
+    usize row;
+    usize end;
+    i64 context_filter;
+
+    // bhf_keyword, rows of the current context
+    BHF::File::KeywordType keywords;
+    usize position;
+
+    // bhf_text, last decoded column of the current row
+    int cached_column;
+    std::string cached;
+};
+
+// Every table over the same path shares one decoded file.
+static std::shared_ptr<const BHF::File>
+Extension_OpenFile(const std::string &path, std::string &error)
+{
+    static std::mutex mutex;
+    static std::map<std::string, std::weak_ptr<const BHF::File>> files;
+
+    std::lock_guard lock(mutex);
+
+    std::shared_ptr<const BHF::File> result = files[path].lock();
+
+    if (!result) {
+        auto file = std::make_shared<BHF::File>();
+
+        if (!file->open(path)) {
+            error = file->lastError();
+
+            return nullptr;
+        }
+
+        result = file;
+        files[path] = result;
+    }
+
+    return result;
+}
+
+static std::string
+Extension_Unquote(std::string_view argument)
+{
+    if (argument.size() >= 2 && (argument.front() == '\'' || argument.front() == '"') && argument.back() == argument.front()) {
+        argument = argument.substr(1, argument.size() - 2);
+    }
+
+    return std::string(argument);
+}
+
+static const char *
+Extension_Schema(Kind kind)
+{
+    switch (kind) {
+        case Kind::Context : return "CREATE TABLE x(context INTEGER, offset INTEGER)";
+        case Kind::Index   : return "CREATE TABLE x(key TEXT, context INTEGER)";
+        case Kind::Text    : return "CREATE TABLE x(context INTEGER, text TEXT, html TEXT, raw BLOB)";
+        case Kind::Keyword : return "CREATE TABLE x(context INTEGER, up INTEGER, down INTEGER, position INTEGER, target INTEGER)";
+    }
+
+    return nullptr;
+}
+
+static int
+Extension_ContextColumn(Kind kind)
+{
+    return kind == Kind::Index ? 1 : 0;
+}
+
+static int
+Extension_Connect(sqlite3 *db, void *aux, int argc, const char *const *argv, sqlite3_vtab **vtab, char **error_message)
+{
+    const Kind kind = *static_cast<const Kind *>(aux);
+
+    if (argc < 4) {
+        *error_message = sqlite3_mprintf("%s: the help file path is required", argv[0]);
+
+        return SQLITE_ERROR;
+    }
+
+    std::string error;
+    std::shared_ptr<const BHF::File> file = Extension_OpenFile(Extension_Unquote(argv[3]), error);
+
+    if (!file) {
+        *error_message = sqlite3_mprintf("%s: %s", argv[0], error.c_str());
+
+        return SQLITE_ERROR;
+    }
+
+    int status = sqlite3_declare_vtab(db, Extension_Schema(kind));
+
+    if (status != SQLITE_OK) {
+        return status;
+    }
+
+    const BHF::File::IndexContainer &index = file->index();
+
+    auto *table = new Table{{}, kind, file, false};
+
+    table->index_sorted = std::is_sorted(index.begin(), index.end(), [](const BHF::File::IndexType &a, const BHF::File::IndexType &b) {
+        return a.index < b.index;
+    });
+
+    *vtab = &table->base;
+
+    return SQLITE_OK;
+}
+
+static int
+Extension_Disconnect(sqlite3_vtab *vtab)
+{
+    delete reinterpret_cast<Table *>(vtab);
+
+    return SQLITE_OK;
+}
+
+static int
+Extension_BestIndex(sqlite3_vtab *vtab, sqlite3_index_info *info)
+{
+    const Table *table = reinterpret_cast<const Table *>(vtab);
+    const int context_column = Extension_ContextColumn(table->kind);
+    const bool key_search = table->kind == Kind::Index && table->index_sorted;
+
+    int idx_num = 0;
+    int arguments = 0;
+    bool has_context = false;
+    bool has_key = false;
+
+    for (int i = 0; i < info->nConstraint && arguments < kMaxArguments; ++i) {
+        const auto &constraint = info->aConstraint[i];
+
+        if (!constraint.usable) {
+            continue;
+        }
+
+        int operation = OpNone;
+        bool omit = false;
+
+        // Key constraints are not omitted: the range found by the binary
+        // search is a superset and SQLite checks the exact condition.
+        if (constraint.iColumn == context_column && constraint.op == SQLITE_INDEX_CONSTRAINT_EQ) {
+            operation = OpContextEq;
+            omit = table->kind != Kind::Index;
+            has_context = true;
+        } else if (key_search && constraint.iColumn == 0) {
+            switch (constraint.op) {
+                case SQLITE_INDEX_CONSTRAINT_EQ   : operation = OpKeyEq; break;
+                case SQLITE_INDEX_CONSTRAINT_GT   : operation = OpKeyGt; break;
+                case SQLITE_INDEX_CONSTRAINT_GE   : operation = OpKeyGe; break;
+                case SQLITE_INDEX_CONSTRAINT_LT   : operation = OpKeyLt; break;
+                case SQLITE_INDEX_CONSTRAINT_LE   : operation = OpKeyLe; break;
+                case SQLITE_INDEX_CONSTRAINT_LIKE : operation = OpKeyLike; break;
+                case SQLITE_INDEX_CONSTRAINT_GLOB : operation = OpKeyGlob; break;
+            }
+
+            has_key = has_key || operation != OpNone;
+        }
+
+        if (operation == OpNone) {
+            continue;
+        }
+
+        info->aConstraintUsage[i].argvIndex = ++arguments;
+        info->aConstraintUsage[i].omit = omit;
+
+        idx_num |= operation << (4 * (arguments - 1));
+    }
+
+    info->idxNum = idx_num;
+
+    if (has_context && table->kind != Kind::Index) {
+        info->estimatedCost = 1.0;
+        info->estimatedRows = table->kind == Kind::Keyword ? 10 : 1;
+        info->idxFlags = table->kind == Kind::Keyword ? 0 : SQLITE_INDEX_SCAN_UNIQUE;
+    } else if (has_key) {
+        info->estimatedCost = 10.0;
+        info->estimatedRows = 10;
+    } else {
+        const BHF::File &file = *table->file;
+        usize rows = table->kind == Kind::Index ? file.index().size() : file.context().size();
+
+        // Decoding is what costs, a scan over text is far more expensive.
+        double weight = (table->kind == Kind::Text || table->kind == Kind::Keyword) ? 100.0 : 1.0;
+
+        info->estimatedCost = static_cast<double>(rows) * weight;
+        info->estimatedRows = static_cast<sqlite3_int64>(rows);
+    }
+
+    // Rows are produced in key order for bhf_index and context order otherwise.
+    if (info->nOrderBy == 1 && !info->aOrderBy[0].desc) {
+        int order_column = table->kind == Kind::Index ? 0 : context_column;
+
+        info->orderByConsumed = info->aOrderBy[0].iColumn == order_column;
+    }
+
+    return SQLITE_OK;
+}
+
+static int
+Extension_Open(sqlite3_vtab *vtab, sqlite3_vtab_cursor **cursor)
+{
+    auto *result = new Cursor{{}, reinterpret_cast<Table *>(vtab), 0, 0, -1, {0, 0, {}}, 0, -1, {}};
+
+    *cursor = &result->base;
+
+    return SQLITE_OK;
+}
+
+static int
+Extension_Close(sqlite3_vtab_cursor *cursor)
+{
+    delete reinterpret_cast<Cursor *>(cursor);
+
+    return SQLITE_OK;
+}
+
+// Index keys sharing the literal part of a LIKE/GLOB pattern. Only plain
+// characters are used, anything that could be a wildcard or escape stops it.
+static std::string
+Extension_PatternPrefix(const char *pattern, bool upper)
+{
+    std::string result;
+
+    for (const char *c = pattern; c && *c; ++c) {
+        bool plain = (*c >= 'a' && *c <= 'z') || (*c >= 'A' && *c <= 'Z') || (*c >= '0' && *c <= '9') || *c == ' ';
+
+        if (!plain) {
+            break;
+        }
+
+        result += (upper && *c >= 'a' && *c <= 'z') ? static_cast<char>(*c - 'a' + 'A') : *c;
+    }
+
+    return result;
+}
+
+static bool
+Extension_ValidContext(const Cursor *cursor, usize row)
+{
+    return cursor->table->file->context()[row] >= 0;
+}
+
+// Positions the cursor on the first row at or after `row` that has data.
+static void
+Extension_Seek(Cursor *cursor, usize row)
+{
+    cursor->row = row;
+    cursor->position = 0;
+    cursor->cached_column = -1;
+
+    const Kind kind = cursor->table->kind;
+
+    if (kind == Kind::Text || kind == Kind::Keyword) {
+        while (cursor->row < cursor->end && !Extension_ValidContext(cursor, cursor->row)) {
+            ++cursor->row;
+        }
+    } else if (kind == Kind::Index && cursor->context_filter >= 0) {
+        const BHF::File::IndexContainer &index = cursor->table->file->index();
+
+        while (cursor->row < cursor->end && index[cursor->row].context != cursor->context_filter) {
+            ++cursor->row;
+        }
+    }
+
+    if (kind == Kind::Keyword && cursor->row < cursor->end) {
+        const BHF::File &file = *cursor->table->file;
+
+        cursor->keywords = file.keywords(file.context()[cursor->row]);
+    }
+}
+
+static int
+Extension_Filter(sqlite3_vtab_cursor *base, int idx_num, const char *idx_str, int argc, sqlite3_value **argv)
+{
+    UNUSED(idx_str);
+
+    Cursor *cursor = reinterpret_cast<Cursor *>(base);
+    const BHF::File &file = *cursor->table->file;
+    const BHF::File::IndexContainer &index = file.index();
+    const bool upper = (file.fileHeader().options & BHF::OF_CaseSense) == 0;
+
+    usize begin = 0;
+    usize end = cursor->table->kind == Kind::Index ? index.size() : file.context().size();
+
+    cursor->context_filter = -1;
+
+    auto key_less = [](const BHF::File::IndexType &entry, const std::string &key) { return entry.index < key; };
+    auto key_less_equal = [](const BHF::File::IndexType &entry, const std::string &key) { return entry.index <= key; };
+
+    auto lower_bound = [&](const std::string &key) -> usize {
+        return static_cast<usize>(std::partition_point(index.begin(), index.end(), [&](const auto &entry) { return key_less(entry, key); }) - index.begin());
+    };
+
+    auto upper_bound = [&](const std::string &key) -> usize {
+        return static_cast<usize>(std::partition_point(index.begin(), index.end(), [&](const auto &entry) { return key_less_equal(entry, key); }) - index.begin());
+    };
+
+    for (int i = 0; i < argc && i < kMaxArguments; ++i) {
+        int operation = (idx_num >> (4 * i)) & 0x0f;
+        sqlite3_value *value = argv[i];
+
+        if (operation == OpContextEq) {
+            sqlite3_int64 context = sqlite3_value_int64(value);
+
+            if (sqlite3_value_numeric_type(value) != SQLITE_INTEGER || context < 0) {
+                end = begin;
+
+                continue;
+            }
+
+            if (cursor->table->kind == Kind::Index) {
+                cursor->context_filter = context;
+            } else {
+                begin = std::max(begin, static_cast<usize>(context));
+                end = std::min(end, static_cast<usize>(context) + 1);
+            }
+
+            continue;
+        }
+
+        if (sqlite3_value_type(value) == SQLITE_NULL) {
+            end = begin;
+
+            continue;
+        }
+
+        // Numbers sort before any text, leave those comparisons to SQLite.
+        if (sqlite3_value_type(value) != SQLITE_TEXT) {
+            continue;
+        }
+
+        const char *text = reinterpret_cast<const char *>(sqlite3_value_text(value));
+
+        std::string key = text;
+
+        switch (operation) {
+            case OpKeyEq: {
+                begin = std::max(begin, lower_bound(key));
+                end = std::min(end, upper_bound(key));
+            } break;
+
+            case OpKeyGt: begin = std::max(begin, upper_bound(key)); break;
+            case OpKeyGe: begin = std::max(begin, lower_bound(key)); break;
+            case OpKeyLt: end = std::min(end, lower_bound(key)); break;
+            case OpKeyLe: end = std::min(end, upper_bound(key)); break;
+
+            case OpKeyLike:
+            case OpKeyGlob: {
+                // LIKE ignores case, only narrow it when keys are all uppercase.
+                if (operation == OpKeyLike && !upper) {
+                    break;
+                }
+
+                std::string prefix = Extension_PatternPrefix(text, operation == OpKeyLike);
+
+                if (prefix.empty()) {
+                    break;
+                }
+
+                usize first = lower_bound(prefix);
+                auto last = std::partition_point(index.begin() + static_cast<isize>(first), index.end(), [&prefix](const auto &entry) {
+                    return entry.index.compare(0, prefix.size(), prefix) == 0;
+                });
+
+                begin = std::max(begin, first);
+                end = std::min(end, static_cast<usize>(last - index.begin()));
+            } break;
+        }
+    }
+
+    cursor->end = std::max(begin, end);
+
+    Extension_Seek(cursor, begin);
+
+    return SQLITE_OK;
+}
+
+static int
+Extension_Next(sqlite3_vtab_cursor *base)
+{
+    Cursor *cursor = reinterpret_cast<Cursor *>(base);
+
+    if (cursor->table->kind == Kind::Keyword && cursor->position + 1 < cursor->keywords.contexts.size()) {
+        ++cursor->position;
+
+        return SQLITE_OK;
+    }
+
+    Extension_Seek(cursor, cursor->row + 1);
+
+    return SQLITE_OK;
+}
+
+static int
+Extension_Eof(sqlite3_vtab_cursor *base)
+{
+    const Cursor *cursor = reinterpret_cast<const Cursor *>(base);
+
+    return cursor->row >= cursor->end;
+}
+
+// SQLITE_STATIC only for text the File owns, SQLite may keep the pointer
+// past the next row (min/max, sorting) or the next column.
+static void
+Extension_ResultText(sqlite3_context *context, const std::string &text, bool blob, sqlite3_destructor_type destructor)
+{
+    if (blob) {
+        sqlite3_result_blob(context, text.data(), static_cast<int>(text.size()), destructor);
+    } else {
+        sqlite3_result_text(context, text.data(), static_cast<int>(text.size()), destructor);
+    }
+}
+
+static int
+Extension_Column(sqlite3_vtab_cursor *base, sqlite3_context *context, int column)
+{
+    Cursor *cursor = reinterpret_cast<Cursor *>(base);
+    const BHF::File &file = *cursor->table->file;
+
+    switch (cursor->table->kind) {
+        case Kind::Context: {
+            if (column == 0) {
+                sqlite3_result_int64(context, static_cast<sqlite3_int64>(cursor->row));
+            } else {
+                sqlite3_result_int64(context, file.context()[cursor->row]);
+            }
+        } break;
+
+        case Kind::Index: {
+            const BHF::File::IndexType &entry = file.index()[cursor->row];
+
+            if (column == 0) {
+                Extension_ResultText(context, entry.index, false, SQLITE_STATIC);
+            } else {
+                sqlite3_result_int64(context, entry.context);
+            }
+        } break;
+
+        case Kind::Text: {
+            if (column == 0) {
+                sqlite3_result_int64(context, static_cast<sqlite3_int64>(cursor->row));
+
+                break;
+            }
+
+            if (cursor->cached_column != column) {
+                BHF::File::TextFormat format = column == 1 ? BHF::File::PlainText : (column == 2 ? BHF::File::HTML : BHF::File::Raw);
+
+                cursor->cached = file.text(file.context()[cursor->row], format);
+                cursor->cached_column = column;
+            }
+
+            Extension_ResultText(context, cursor->cached, column == 3, SQLITE_TRANSIENT);
+        } break;
+
+        case Kind::Keyword: {
+            const BHF::File::KeywordType &keywords = cursor->keywords;
+
+            switch (column) {
+                case 0: sqlite3_result_int64(context, static_cast<sqlite3_int64>(cursor->row)); break;
+                case 1: sqlite3_result_int64(context, keywords.up); break;
+                case 2: sqlite3_result_int64(context, keywords.down); break;
+
+                case 3:
+                case 4: {
+                    if (keywords.contexts.empty()) {
+                        sqlite3_result_null(context);
+                    } else if (column == 3) {
+                        sqlite3_result_int64(context, static_cast<sqlite3_int64>(cursor->position));
+                    } else {
+                        sqlite3_result_int64(context, keywords.contexts[cursor->position]);
+                    }
+                } break;
+            }
+        } break;
+    }
+
+    return SQLITE_OK;
+}
+
+static int
+Extension_Rowid(sqlite3_vtab_cursor *base, sqlite3_int64 *rowid)
+{
+    const Cursor *cursor = reinterpret_cast<const Cursor *>(base);
+
+    *rowid = static_cast<sqlite3_int64>(cursor->row);
+
+    if (cursor->table->kind == Kind::Keyword) {
+        *rowid = (*rowid << 16) | static_cast<sqlite3_int64>(cursor->position);
+    }
+
+    return SQLITE_OK;
+}
+
+static constexpr Kind kContext = Kind::Context;
+static constexpr Kind kIndex = Kind::Index;
+static constexpr Kind kText = Kind::Text;
+static constexpr Kind kKeyword = Kind::Keyword;
+
+static sqlite3_module kModule = {
+      0                     // iVersion
+    , Extension_Connect     // xCreate
+    , Extension_Connect     // xConnect
+    , Extension_BestIndex   // xBestIndex
+    , Extension_Disconnect  // xDisconnect
+    , Extension_Disconnect  // xDestroy
+    , Extension_Open        // xOpen
+    , Extension_Close       // xClose
+    , Extension_Filter      // xFilter
+    , Extension_Next        // xNext
+    , Extension_Eof         // xEof
+    , Extension_Column      // xColumn
+    , Extension_Rowid       // xRowid
+    , nullptr               // xUpdate
+    , nullptr               // xBegin
+    , nullptr               // xSync
+    , nullptr               // xCommit
+    , nullptr               // xRollback
+    , nullptr               // xFindFunction
+    , nullptr               // xRename
+    , nullptr               // xSavepoint
+    , nullptr               // xRelease
+    , nullptr               // xRollbackTo
+    , nullptr               // xShadowName
+};
+
+static int
+Extension_Register(sqlite3 *db)
+{
+    struct {
+        const char *name;
+        const Kind *kind;
+    } modules[] = {
+          {"bhf_context", &kContext}
+        , {"bhf_index", &kIndex}
+        , {"bhf_text", &kText}
+        , {"bhf_keyword", &kKeyword}
+    };
+
+    for (const auto &module : modules) {
+        int status = sqlite3_create_module(db, module.name, &kModule, const_cast<Kind *>(module.kind));
+
+        if (status != SQLITE_OK) {
+            return status;
+        }
+    }
+
+    return SQLITE_OK;
+}
+
+} // namespace SQLite
+
+extern "C" {
+
+#if defined(_WIN32)
+__declspec(dllexport)
+#else
+__attribute__((visibility("default")))
+#endif
+int
+sqlite3_bhf_init(sqlite3 *db, char **error_message, const sqlite3_api_routines *api)
+{
+    UNUSED(error_message);
+
+    SQLITE_EXTENSION_INIT2(api);
+
+    return SQLite::Extension_Register(db);
+}
+
+} // extern "C"
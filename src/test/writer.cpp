@@ -0,0 +1,221 @@
+// SPDX-License-Identifier: MIT
+// Copyright (c) 2022 Gustavo Ribeiro Croscato
+
+#include "bhf/decoder.hpp"
+#include "bhf/writer.hpp"
+
+// Writes a small help file with BHF::Writer and reads it back. The topics
+// hold runs of newlines, keyword marks and spaces, which the Writer stores
+// as CharCount; File::text() must reflow them like the same characters
+// stored one by one.
+
+using namespace std::literals;
+
+using NibbleCodec = BHF::Codec<BHF::Compression::Nibble>;
+
+static usize failures = 0;
+
+static void
+Test_Check(bool condition, std::string_view what) noexcept
+{
+    if (!condition) {
+        fmt::print(stderr, "FAILED: {}\n", what);
+
+        ++failures;
+    }
+}
+
+// Text record of `text` with every character on its own, no CharCount.
+static std::vector<u8>
+Test_Spell(std::string_view text, const BHF::Compression &compression) noexcept
+{
+    std::vector<u8> result;
+    bool high = false;
+
+    auto put = [&result, &high](u8 nibble) -> void {
+        if (high) {
+            result.back() = static_cast<u8>(result.back() | (nibble << 4));
+        } else {
+            result.push_back(nibble);
+        }
+
+        high = !high;
+    };
+
+    for (char c : text) {
+        u8 value = static_cast<u8>(c);
+        const u8 *table = compression.table;
+        const u8 *slot = std::find(table, table + sizeof(compression.table), value);
+
+        if (slot != table + sizeof(compression.table)) {
+            put(static_cast<u8>(slot - table));
+        } else {
+            put(BHF::ControlCode::CharRaw);
+            put(value & 0x0f);
+            put(static_cast<u8>(value >> 4));
+        }
+    }
+
+    // A CharCount without a character adds nothing, unlike the NUL of
+    // the usual padding.
+    if (high) {
+        put(BHF::ControlCode::CharCount);
+    }
+
+    return result;
+}
+
+int
+main()
+{
+    BHF::Writer writer;
+
+    writer.stamp() = "TURBO PASCAL HelpFile.";
+    writer.signature() = "test";
+    writer.version() = {BHF::Version::BP7, 1};
+    writer.fileHeader() = {0, 1, 0, 25, 40, 1};
+
+    // Lines wider than the window with runs of spaces around the wrap,
+    // adjacent keywords (a run of KeywordMark), runs of newlines longer
+    // than one CharCount and source code.
+    writer.topics() = {
+        {
+            "Title\0\0\0"
+            "A line much wider than the help window, with  several   spaces and a \2keyword    here\2 too.\0\0"
+            "\2One\2\2Two\2\0"
+            "                    indented\0"
+            "\5code\0\0    block\5\0"s,
+            {0, 1, {2, 1, 2}}
+        },
+        {
+            "word word word word word word word                              tail\0"
+            "\0\0\0\0\0\0\0\0\0\0\0\0\0\0\0\0\0\0\0\0"
+            "after the blank lines\0"s,
+            {0, 0, {}}
+        },
+        {"Hi\0"s, {0, 0, {}}},
+    };
+
+    writer.context() = {-1, 0, 1, 0, 2};
+    writer.index() = {{1, "Title"}, {2, "Words"}, {3, "Alias"}};
+    writer.indexTags() = {{0, "tag"}};
+
+    std::vector<u8> buffer;
+
+    if (!writer.write(buffer)) {
+        fmt::print(stderr, "write: {}\n", writer.lastError());
+
+        return EXIT_FAILURE;
+    }
+
+    BHF::File file;
+
+    if (!file.open(std::move(buffer))) {
+        fmt::print(stderr, "open: {}\n", file.lastError());
+
+        return EXIT_FAILURE;
+    }
+
+    Test_Check(file.compression().table[0] == 0, "table entry 0 is NUL");
+
+    // [Text] runs reflow like single characters.
+    const BHF::File::ContextContainer &context = file.context();
+    usize spelled_size = 0;
+
+    for (usize c = 1; c < context.size(); ++c) {
+        const BHF::Writer::Topic &topic = writer.topics()[static_cast<usize>(writer.context()[c])];
+
+        // Characters as stored, an odd record ends with the padding NUL.
+        std::string_view records = file.topicData(context[c]);
+        BHF::ByteStream stream(reinterpret_cast<const u8 *>(records.data()), records.size());
+        BHF::RecordHeader record = stream.read<BHF::RecordHeader>();
+        std::string stored;
+
+        NibbleCodec::expand(stream.skip(record.length), record.length, file.compression(), stored);
+
+        // Only a topic without a run to change needs the padding.
+        bool repeats = std::adjacent_find(topic.text.begin(), topic.text.end()) != topic.text.end();
+
+        Test_Check(stored == topic.text || (!repeats && stored == topic.text + '\0'), fmt::format("stored text of context {}", c));
+
+        std::vector<u8> spelled = Test_Spell(stored, file.compression());
+        std::string expected;
+
+        NibbleCodec::uncompress(spelled.data(), spelled.size(), file.fileHeader(), file.compression(), expected);
+
+        Test_Check(file.text(context[c], BHF::File::Raw) == expected, fmt::format("raw text of context {}", c));
+        Test_Check(file.keywords(context[c]).contexts == topic.keywords.contexts, fmt::format("keywords of context {}", c));
+
+        spelled_size += c != 3 ? spelled.size() : 0;
+    }
+
+    Test_Check(writer.statistics().compressed_size < spelled_size, "runs stored as CharCount");
+
+    Test_Check(file.text(context[1]) ==
+        "Title \n"
+        "\n"
+        "\n"
+        "A line much wider than the help\n"
+        "window, with  several   spaces and a keyword    here too. \n"
+        "\n"
+        "OneTwo \n"
+        "                    indented\n"
+        "code \n"
+        "\n"
+        "    block\n", "plain text of context 1");
+
+    Test_Check(context[3] == context[1] && file.isAlias(3), "alias context");
+
+    // [Load] gives back what was written.
+    BHF::Writer loaded;
+
+    Test_Check(loaded.load(file), "load");
+    Test_Check(loaded.topics().size() == writer.topics().size(), "topic count");
+
+    for (usize t = 0; t < loaded.topics().size() && t < writer.topics().size(); ++t) {
+        const std::string &text = writer.topics()[t].text;
+
+        bool repeats = std::adjacent_find(text.begin(), text.end()) != text.end();
+
+        Test_Check(loaded.topics()[t].text == text || (!repeats && loaded.topics()[t].text == text + '\0'), fmt::format("text of topic {}", t));
+        Test_Check(loaded.topics()[t].keywords.up == writer.topics()[t].keywords.up
+            && loaded.topics()[t].keywords.down == writer.topics()[t].keywords.down, fmt::format("keyword links of topic {}", t));
+    }
+
+    Test_Check(loaded.context() == writer.context(), "contexts");
+    Test_Check(loaded.index().size() == writer.index().size(), "index");
+
+    for (usize i = 0; i < loaded.index().size() && i < writer.index().size(); ++i) {
+        Test_Check(loaded.index()[i].index == writer.index()[i].index
+            && loaded.index()[i].context == writer.index()[i].context, fmt::format("index key {}", i));
+    }
+
+    Test_Check(loaded.indexTags().size() == 1 && loaded.indexTags()[0].tag == "tag", "index tags");
+
+    // [Rewrite] the padding NUL becomes text and the topics read the same.
+    BHF::File rewritten;
+
+    Test_Check(loaded.write(buffer) && rewritten.open(std::move(buffer)), "rewrite");
+
+    for (usize c = 1; c < context.size() && c < rewritten.context().size(); ++c) {
+        Test_Check(rewritten.text(rewritten.context()[c], BHF::File::Raw) == file.text(context[c], BHF::File::Raw), fmt::format("rewritten text of context {}", c));
+    }
+
+    // [Damaged] a Keyword record counting more links than it holds.
+    std::string damaged(file.topicData(context[1]));
+    BHF::ByteStream damaged_stream(reinterpret_cast<const u8 *>(damaged.data()), damaged.size());
+    usize keyword = sizeof(BHF::RecordHeader) + damaged_stream.read<BHF::RecordHeader>().length;
+
+    damaged[keyword + sizeof(BHF::RecordHeader) + 4] = '\x7f';
+
+    BHF::File::KeywordType keywords{0, 0, {}};
+    std::string text;
+    std::string scratch;
+
+    Test_Check(!file.topicKeywords(damaged, keywords) && keywords.contexts.empty(), "damaged keywords");
+    Test_Check(!file.formatTopic(damaged, BHF::File::HTML, text, scratch) && text.empty(), "damaged HTML text");
+    Test_Check(file.formatTopic(damaged, BHF::File::Raw, text, scratch) && !text.empty(), "raw text of damaged keywords");
+    Test_Check(!file.formatTopic(damaged.substr(0, keyword - 1), BHF::File::Raw, text, scratch), "truncated text");
+
+    return failures == 0 ? EXIT_SUCCESS : EXIT_FAILURE;
+}
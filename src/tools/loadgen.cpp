@@ -0,0 +1,319 @@
+// SPDX-License-Identifier: MIT
+// Copyright (c) 2022 Gustavo Ribeiro Croscato
+
+// Load generator for `bhfconverter_cli serve`. Every connection is a thread
+// sending keep-alive requests one after the other, at the end it prints the
+// request rate and the latency distribution:
+//
+//   bhfconverter_loadgen --connections 32 --duration 10 --range 1200 '/topic/{}'
+//
+// "{}" in a path is replaced by a random number in [0, range) on every
+// request.
+
+#include <algorithm>
+#include <atomic>
+#include <cerrno>
+#include <chrono>
+#include <cstring>
+#include <random>
+#include <thread>
+
+#include <arpa/inet.h>
+#include <netinet/in.h>
+#include <netinet/tcp.h>
+#include <sys/socket.h>
+#include <unistd.h>
+
+#include "arguments.hpp"
+
+using Clock = std::chrono::steady_clock;
+
+struct LoadStatistics {
+    std::vector<u32> latencies;
+    usize errors = 0;
+    usize not_modified = 0;
+    usize not_found = 0;
+};
+
+static int
+LoadGen_Usage()
+{
+    fmt::print(
+        "usage: bhfconverter_loadgen [options] <path>...\n"
+        "\n"
+        "options:\n"
+        "  --port <port>                     server port, 8437 by default\n"
+        "  --connections <count>             concurrent connections, 16 by default\n"
+        "  --duration <seconds>              length of the run, 10 by default\n"
+        "  --range <count>                   \"{{}}\" in a path becomes a number below count\n"
+        "  --etag                            revalidate with If-None-Match\n"
+    );
+
+    return 1;
+}
+
+static int
+LoadGen_Connect(u16 port) noexcept
+{
+    int fd = socket(AF_INET, SOCK_STREAM | SOCK_CLOEXEC, 0);
+
+    if (fd < 0) {
+        return -1;
+    }
+
+    int one = 1;
+
+    setsockopt(fd, IPPROTO_TCP, TCP_NODELAY, &one, sizeof(one));
+
+    sockaddr_in address{};
+    address.sin_family = AF_INET;
+    address.sin_port = htons(port);
+    address.sin_addr.s_addr = htonl(INADDR_LOOPBACK);
+
+    if (connect(fd, reinterpret_cast<sockaddr *>(&address), sizeof(address)) != 0) {
+        close(fd);
+
+        return -1;
+    }
+
+    return fd;
+}
+
+// Value of a response header, the name in lower case.
+static std::string_view
+LoadGen_Header(std::string_view head, std::string_view name) noexcept
+{
+    std::string_view::size_type start = head.find("\r\n");
+
+    while (start != std::string_view::npos) {
+        start += 2;
+
+        std::string_view::size_type end = head.find("\r\n", start);
+        std::string_view line = head.substr(start, end == std::string_view::npos ? std::string_view::npos : end - start);
+
+        bool match = line.size() > name.size() && line[name.size()] == ':';
+
+        for (usize i = 0; match && i < name.size(); ++i) {
+            char c = line[i];
+
+            match = ((c >= 'A' && c <= 'Z') ? static_cast<char>(c - 'A' + 'a') : c) == name[i];
+        }
+
+        if (match) {
+            std::string_view value = line.substr(name.size() + 1);
+
+            while (!value.empty() && value.front() == ' ') {
+                value.remove_prefix(1);
+            }
+
+            return value;
+        }
+
+        start = end;
+    }
+
+    return {};
+}
+
+// Reads one whole response, returns its status or 0 on error.
+static int
+LoadGen_ReadResponse(int fd, std::string &buffer, std::string &etag) noexcept
+{
+    std::array<char, 65536> chunk;
+
+    std::string::size_type head_end = std::string::npos;
+
+    while ((head_end = buffer.find("\r\n\r\n")) == std::string::npos) {
+        ssize_t count = recv(fd, chunk.data(), chunk.size(), 0);
+
+        if (count <= 0) {
+            return 0;
+        }
+
+        buffer.append(chunk.data(), static_cast<usize>(count));
+    }
+
+    std::string_view head(buffer.data(), head_end);
+
+    if (head.size() < 12 || head.substr(0, 5) != "HTTP/") {
+        return 0;
+    }
+
+    int status = std::atoi(std::string(head.substr(9, 3)).c_str());
+    usize length = std::strtoul(std::string(LoadGen_Header(head, "content-length")).c_str(), nullptr, 10);
+
+    etag = LoadGen_Header(head, "etag");
+
+    usize total = head_end + 4 + (status == 304 ? 0 : length);
+
+    while (buffer.size() < total) {
+        ssize_t count = recv(fd, chunk.data(), chunk.size(), 0);
+
+        if (count <= 0) {
+            return 0;
+        }
+
+        buffer.append(chunk.data(), static_cast<usize>(count));
+    }
+
+    buffer.erase(0, total);
+
+    return status;
+}
+
+static void
+LoadGen_Connection(unsigned id, u16 port, const std::vector<std::string_view> &paths, u32 range, bool use_etag, Clock::time_point end, LoadStatistics &statistics) noexcept
+{
+    std::mt19937 random(id + 1);
+    std::uniform_int_distribution<u32> number(0, range > 0 ? range - 1 : 0);
+
+    std::vector<std::string> etags(use_etag ? static_cast<usize>(range) * paths.size() : 0);
+
+    int fd = -1;
+    std::string buffer;
+    std::string request;
+    std::string etag;
+
+    while (Clock::now() < end) {
+        if (fd < 0) {
+            fd = LoadGen_Connect(port);
+            buffer.clear();
+
+            if (fd < 0) {
+                ++statistics.errors;
+
+                std::this_thread::sleep_for(std::chrono::milliseconds(10));
+
+                continue;
+            }
+        }
+
+        usize path = random() % paths.size();
+        u32 value = number(random);
+
+        std::string target(paths[path]);
+        std::string::size_type placeholder = target.find("{}");
+
+        if (placeholder != std::string::npos) {
+            target.replace(placeholder, 2, std::to_string(value));
+        }
+
+        std::string *cached = use_etag ? &etags[path * range + value] : nullptr;
+
+        request = fmt::format("GET {} HTTP/1.1\r\nHost: 127.0.0.1\r\n", target);
+
+        if (cached && !cached->empty()) {
+            request += fmt::format("If-None-Match: {}\r\n", *cached);
+        }
+
+        request += "\r\n";
+
+        Clock::time_point start = Clock::now();
+
+        int status = 0;
+
+        if (send(fd, request.data(), request.size(), MSG_NOSIGNAL) == static_cast<ssize_t>(request.size())) {
+            status = LoadGen_ReadResponse(fd, buffer, etag);
+        }
+
+        if (status == 0) {
+            ++statistics.errors;
+
+            close(fd);
+            fd = -1;
+
+            continue;
+        }
+
+        auto elapsed = std::chrono::duration_cast<std::chrono::microseconds>(Clock::now() - start);
+
+        statistics.latencies.push_back(static_cast<u32>(elapsed.count()));
+
+        if (status == 304) {
+            ++statistics.not_modified;
+        } else if (status == 404) {
+            ++statistics.not_found;
+        } else if (cached && status == 200) {
+            *cached = etag;
+        }
+    }
+
+    if (fd >= 0) {
+        close(fd);
+    }
+}
+
+int
+main(int argc, char *argv[])
+{
+    CLI::Arguments arguments;
+
+    bool parsed = arguments.parse(argc - 1, argv + 1, {
+          {"--port", true}
+        , {"--connections", true}
+        , {"--duration", true}
+        , {"--range", true}
+        , {"--etag", false}
+    });
+
+    if (!parsed) {
+        fmt::print(stderr, "{}\n", arguments.lastError());
+
+        return LoadGen_Usage();
+    }
+
+    if (arguments.positional().empty()) {
+        return LoadGen_Usage();
+    }
+
+    u16 port = static_cast<u16>(std::strtoul(std::string(arguments.value("--port", "8437")).c_str(), nullptr, 10));
+    unsigned connections = static_cast<unsigned>(std::strtoul(std::string(arguments.value("--connections", "16")).c_str(), nullptr, 10));
+    double duration = std::strtod(std::string(arguments.value("--duration", "10")).c_str(), nullptr);
+    u32 range = static_cast<u32>(std::strtoul(std::string(arguments.value("--range", "1")).c_str(), nullptr, 10));
+
+    connections = std::max(connections, 1u);
+
+    Clock::time_point start = Clock::now();
+    Clock::time_point end = start + std::chrono::milliseconds(static_cast<i64>(duration * 1000.0));
+
+    std::vector<LoadStatistics> statistics(connections);
+    std::vector<std::thread> threads;
+
+    for (unsigned i = 0; i < connections; ++i) {
+        threads.emplace_back(LoadGen_Connection, i, port, std::cref(arguments.positional()), range, arguments.has("--etag"), end, std::ref(statistics[i]));
+    }
+
+    for (std::thread &thread : threads) {
+        thread.join();
+    }
+
+    double seconds = std::chrono::duration<double>(Clock::now() - start).count();
+
+    LoadStatistics total;
+
+    for (LoadStatistics &connection : statistics) {
+        total.latencies.insert(total.latencies.end(), connection.latencies.begin(), connection.latencies.end());
+        total.errors += connection.errors;
+        total.not_modified += connection.not_modified;
+        total.not_found += connection.not_found;
+    }
+
+    std::sort(total.latencies.begin(), total.latencies.end());
+
+    auto percentile = [&total](double fraction) -> double {
+        if (total.latencies.empty()) {
+            return 0.0;
+        }
+
+        usize position = static_cast<usize>(fraction * static_cast<double>(total.latencies.size() - 1));
+
+        return total.latencies[position] / 1000.0;
+    };
+
+    fmt::print("requests......: {} in {:.2f}s, {:.0f} req/s\n", total.latencies.size(), seconds, static_cast<double>(total.latencies.size()) / seconds);
+    fmt::print("responses.....: {} not modified, {} not found, {} errors\n", total.not_modified, total.not_found, total.errors);
+    fmt::print("latency (ms)..: p50 {:.3f}  p90 {:.3f}  p99 {:.3f}  p99.9 {:.3f}  max {:.3f}\n",
+        percentile(0.50), percentile(0.90), percentile(0.99), percentile(0.999), percentile(1.0));
+
+    return total.errors > 0 ? 1 : 0;
+}